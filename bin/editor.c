@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <SDL.h>
 
@@ -9,218 +10,344 @@
 #include "defs.h"
 #include "map.h"
 #include "color.h"
+#include "spatial.h"
 
 
 #define SNAP_DISTANCE 8
+#define CELL_SIZE 32        // Spatial index cell size
+#define IDLE_SLEEP 5        // ms to sleep when there's nothing to redraw
+#define JOURNAL_COMPACT 4096    // Edits journaled before writing a snapshot
 
 //------------------------------------------------------------------------------
-// WallNodes
+// Globals
 //------------------------------------------------------------------------------
 
-typedef struct WallNode {
-    Wall *wall;
+Buffer *buffer;
+
+Map level;              // Walls...
+int capacity;           // ... and room for them
+SpatialIndex grid;      // Where the walls are
+
+int *found;             // Results of FindWalls()
+int numfound;
+
+Vector loose;   // The start point of a Wall under construction.
+int loosef;
 
-    struct WallNode *next, *prev;
-} WallNode;
+int hover = -1; // Wall under the mouse, highlighted.
+Vector mouse;   // Mouse position when the screen was last updated.
 
+int moving = -1;    // Wall being dragged, and where it was grabbed
+Vector grab;
 
-typedef struct {
-    WallNode *first;
-} WallList;
+Edit *history;      // Edits made, the first done of them not undone
+int numhistory, done;
+int historycap;
 
+Edit *pending;      // Edits not saved yet
+int numpending;
+int pendingcap;
+int synced;         // Whether the level on disk plus pending is the level
 
-// Create a WallNode from a Wall.
-WallNode *CreateWallNode(Wall *wall, WallNode *next, WallNode *prev) {
-    WallNode *node = malloc(sizeof(WallNode));
 
-    node->wall = wall;
-    node->next = next;
-    node->prev = prev;
 
-    return node;
+//------------------------------------------------------------------------------
+// Editor
+//------------------------------------------------------------------------------
+
+void Init() {
+    S_Init("Editor", 640, 480);
+    buffer = B_CreateBuffer(640, 480, NULL);
+    B_TrackDirty(buffer);
+
+    SP_Init(&grid, CELL_SIZE);
 }
 
 
 
-// Add a Wall to a WallList.
-//
-// Returns a pointer to the WallNode used to store the Wall.
-WallNode *UnshiftWallNode(WallList *list, Wall *wall) {
-    WallNode *node = CreateWallNode(wall, list->first, NULL);
+// Marks the area covered by s as needing a redraw.
+void MarkSegment(Segment s) {
+    B_MarkDirty(buffer, (Box){
+            .top = MIN(s.start.y, s.end.y) - 1,
+            .bottom = MAX(s.start.y, s.end.y) + 1,
+            .left = MIN(s.start.x, s.end.x) - 1,
+            .right = MAX(s.start.x, s.end.x) + 1,
+            });
+}
+
+
 
-    if (list->first) {
-        list->first->prev = node;
+// Adds a wall to the level. Returns its index.
+int AddWall(Segment seg) {
+    if (level.numwalls == capacity) {
+        capacity = MAX(64, capacity * 2);
+        level.walls = realloc(level.walls, sizeof(Wall) * capacity);
     }
 
-    list->first = node;
+    int i = level.numwalls++;
+    level.walls[i] = (Wall){ .seg = seg };
+    SP_InsertSegment(&grid, i, seg);
+
+    MarkSegment(seg);
 
-    return node;
+    return i;
 }
 
 
 
-// Delete a WallNode from a WallList.
-//
-// Returns a pointer to the stored Wall.
-Wall *DeleteWallNode(WallList *list, WallNode *n) {
-    Wall *wall = n->wall;
+// Deletes wall i, moving the last wall to its place.
+void DeleteWall(int i) {
+    MarkSegment(level.walls[i].seg);
+    SP_Remove(&grid, i);
 
-    if (n->prev) {
-        n->prev->next = n->next;
+    int last = --level.numwalls;
+    if (i != last) {
+        level.walls[i] = level.walls[last];
+        SP_Remove(&grid, last);
+        SP_InsertSegment(&grid, i, level.walls[i].seg);
     }
 
-    if (n->next) {
-        n->next->prev = n->prev;
+    if (hover == i) {
+        hover = -1;
+    } else if (hover == last) {
+        hover = i;
     }
 
-    if (list->first == n) {
-        list->first = n->next;
+    if (moving == i) {
+        moving = -1;
+    } else if (moving == last) {
+        moving = i;
     }
+}
+
 
-    free(n);
 
-    return wall;
+// Moves wall i to seg.
+void MoveWall(int i, Segment seg) {
+    MarkSegment(level.walls[i].seg);
+    level.walls[i].seg = seg;
+    SP_InsertSegment(&grid, i, seg);
+    MarkSegment(seg);
 }
 
 
 
-// Search for a WallNode containing Wall and returns it if found.
-// NULL otherwise.
-WallNode *GetWallNode(WallList *list, Wall *wall) {
-    WallNode *wn = list->first;
+// Clears the level. This can't be undone.
+void ClearWalls() {
+    level.numwalls = 0;
+    SP_Clear(&grid);
+    hover = -1;
+    moving = -1;
+    B_MarkAllDirty(buffer);
+
+    numhistory = done = 0;
+    numpending = 0;
+    synced = 0;
+}
+
 
-    while (wn) {
-        if (wn->wall == wall) return wn;
 
-        wn = wn->next;
+// Finds the walls whose bounding box overlaps box, and leaves them in found.
+// Returns how many there are.
+int FindWalls(Box box) {
+    int n = SP_Query(&grid, box, found, numfound);
+
+    if (n > numfound) {
+        numfound = n;
+        found = realloc(found, sizeof(int) * numfound);
+        n = SP_Query(&grid, box, found, numfound);
     }
 
-    return NULL;
+    return n;
 }
 
 
-// Free all Wall and WallNodes in list.
-void ClearWallList(WallList *list) {
-    while (list->first) {
-        Wall *w = DeleteWallNode(list, list->first);
-        free(w);
+
+// Returns the index of the wall closest to the mouse, -1 if none is within
+// SNAP_DISTANCE.
+int GetWallNearMouse() {
+    Vector pos = S_GetMousePos(buffer);
+    Box near = {
+        pos.y - SNAP_DISTANCE, pos.y + SNAP_DISTANCE,
+        pos.x - SNAP_DISTANCE, pos.x + SNAP_DISTANCE
+    };
+
+    int nearest = -1;
+    double distance = SNAP_DISTANCE;
+
+    int n = FindWalls(near);
+    for (int i = 0; i < n; i++) {
+        double d = G_SegmentPointDistance(level.walls[found[i]].seg, pos);
+        if (d < distance) {
+            nearest = found[i];
+            distance = d;
+        }
     }
+
+    return nearest;
 }
 
 
 
-//------------------------------------------------------------------------------
-// Globals
-//------------------------------------------------------------------------------
+// Returns the index of a wall placed exactly at seg, -1 if there's none.
+int FindWall(Segment seg) {
+    int n = FindWalls(SP_SegmentBox(seg));
+    for (int i = 0; i < n; i++) {
+        if (SEGEQ(level.walls[found[i]].seg, seg)) return found[i];
+    }
 
-Buffer *buffer;
+    return -1;
+}
 
-WallList level;
 
-Vector loose;  // The start point of a Wall under construction.
-int loosef;
 
+// Makes the change e to the level, and remembers it for the next save.
+void Apply(Edit e) {
+    int i = e.type == EDIT_ADD ? -1 : FindWall(e.seg);
 
+    switch (e.type) {
+        case EDIT_ADD:
+            AddWall(e.seg);
+            break;
 
-//------------------------------------------------------------------------------
-// Editor
-//------------------------------------------------------------------------------
+        case EDIT_DELETE:
+            if (i >= 0) DeleteWall(i);
+            break;
 
-void Init() {
-    S_Init("Editor", 640, 480);
-    buffer = B_CreateBuffer(640, 480);
+        case EDIT_MOVE:
+            if (i >= 0) MoveWall(i, e.to);
+            break;
+    }
+
+    if (numpending == pendingcap) {
+        pendingcap = MAX(64, pendingcap * 2);
+        pending = realloc(pending, sizeof(Edit) * pendingcap);
+    }
+    pending[numpending++] = e;
 }
 
 
 
-void AddWall(Segment seg) {
-    Wall *wall = malloc(sizeof(Wall));
-    wall->seg = seg;
+// Applies e as a new command, dropping the commands that could be redone.
+void Do(Edit e) {
+    Apply(e);
 
-    UnshiftWallNode(&level, wall);
+    if (done == historycap) {
+        historycap = MAX(64, historycap * 2);
+        history = realloc(history, sizeof(Edit) * historycap);
+    }
+    history[done++] = e;
+    numhistory = done;
 }
 
 
 
-void DeleteWall(Wall *wall) {
-    WallNode *wn = GetWallNode(&level, wall);
-
-    if (wn) {
-        DeleteWallNode(&level, wn);
-        free(wall);
+void Undo() {
+    if (done > 0) {
+        Apply(M_InverseEdit(history[--done]));
     }
 }
 
 
 
-Wall *GetWallNearMouse() {
-    Vector pos = S_GetMousePos(buffer);
-
-    for (WallNode *wn = level.first; wn; wn = wn->next) {
-        if (G_SegmentPointDistance(wn->wall->seg, pos) < SNAP_DISTANCE) {
-            return wn->wall;
-        }
+void Redo() {
+    if (done < numhistory) {
+        Apply(history[done++]);
     }
-
-    return NULL;
 }
 
 
 
+// Saves the edits since the last save to the journal of the level, or the
+// whole level when it would be too long to replay or it doesn't match the
+// level on disk.
 void SaveLevel(const char *path) {
-    FILE *f = fopen(path, "w");
-
-    for (WallNode *wn = level.first; wn; wn = wn->next) {
-        fprintf(f, "%f %f %f %f\n",
-                wn->wall->seg.start.x,
-                wn->wall->seg.start.y,
-                wn->wall->seg.end.x,
-                wn->wall->seg.end.y);
+    if (!synced || M_JournalLength(path) + numpending > JOURNAL_COMPACT) {
+        M_Save(&level, path);
+    } else if (numpending > 0 && !M_AppendJournal(path, pending, numpending)) {
+        M_Save(&level, path);
     }
 
-    fclose(f);
+    numpending = 0;
+    synced = 1;
 }
 
 void LoadLevel(const char *path) {
-    ClearWallList(&level);
+    ClearWalls();
 
-    FILE *f = fopen(path, "r");
+    // A new level, if there's nothing to load yet.
+    Map *m = M_Load(path, NULL);
+    if (!m) return;
 
-    Segment seg;
-    while (fscanf(f, "%lf %lf %lf %lf",
-                &seg.start.x, &seg.start.y, &seg.end.x, &seg.end.y) != EOF ) {
-        AddWall(seg);
+    for (int i = 0; i < m->numwalls; i++) {
+        AddWall(m->walls[i].seg);
     }
+    M_Delete(m);
 
-    fclose(f);
+    synced = 1;
 }
 
 
 
 void Quit() {
-    ClearWallList(&level);
+    free(level.walls);
+    free(history);
+    free(pending);
+    SP_Free(&grid);
     S_Quit();
     exit(1);
 }
 
 
 
-void Draw() {
-    B_ClearBuffer(buffer, BLACK);
-
-    for (WallNode *wn = level.first; wn; wn = wn->next) {
-        uint32_t color;
-        if (G_SegmentPointDistance(wn->wall->seg, S_GetMousePos(buffer)) < SNAP_DISTANCE) {
-            color = RED;
-        } else {
-            color = WHITE;
-        }
+// Marks as dirty whatever changed because of the mouse moving.
+void Update() {
+    Vector pos = S_GetMousePos(buffer);
 
-        D_DrawSegment(buffer, wn->wall->seg, color);
+    if (loosef && !VEQ(pos, mouse)) {
+        MarkSegment((Segment){ loose, mouse });
+        MarkSegment((Segment){ loose, pos });
     }
+    mouse = pos;
 
-    if (loosef) {
-        D_DrawSegment(buffer, (Segment){ loose, S_GetMousePos(buffer) }, WHITE);
+    int w = GetWallNearMouse();
+    if (w != hover) {
+        if (hover >= 0) MarkSegment(level.walls[hover].seg);
+        if (w >= 0) MarkSegment(level.walls[w].seg);
+        hover = w;
+    }
+}
+
+
+
+// Redraws the dirty areas of the buffer only.
+void Draw() {
+    if (buffer->dirty->count == 0) {
+        S_Sleep(IDLE_SLEEP);
+        return;
+    }
+
+    // Drawing marks the same areas again, work on a copy.
+    DirtyList dirty = *buffer->dirty;
+
+    for (int i = 0; i < dirty.count; i++) {
+        Box r = dirty.rects[i];
+
+        Buffer area = B_View(buffer, r.left, r.top,
+                r.right - r.left + 1, r.bottom - r.top + 1);
+        B_ClearBuffer(&area, BLACK);
+
+        // Clipping the segments themselves would move their pixels, and
+        // leave seams where areas meet.
+        int n = FindWalls(r);
+        for (int j = 0; j < n; j++) {
+            D_DrawSegmentIn(buffer, level.walls[found[j]].seg, r,
+                    found[j] == hover ? RED : WHITE);
+        }
+
+        if (loosef) {
+            D_DrawSegmentIn(buffer, (Segment){ loose, mouse }, r, WHITE);
+        }
     }
 
     S_Blit(buffer);
@@ -231,13 +358,14 @@ void Draw() {
 void HandleLeftClick() {
     Vector pos = S_GetMousePos(buffer);
 
-    Wall *wall = GetWallNearMouse();
-    if (wall) {
-        pos = G_NearestPointOnSegment(wall->seg, pos);
+    int wall = GetWallNearMouse();
+    if (wall >= 0) {
+        pos = G_NearestPointOnSegment(level.walls[wall].seg, pos);
     }
 
     if (loosef) {
-        AddWall((Segment){ loose, pos });
+        MarkSegment((Segment){ loose, mouse });
+        Do((Edit){ .type = EDIT_ADD, .seg = { loose, pos } });
         loosef = 0;
     } else {
         loose = pos;
@@ -249,16 +377,43 @@ void HandleLeftClick() {
 
 void HandleRightClick() {
     if (loosef) {
+        MarkSegment((Segment){ loose, mouse });
         loosef = 0;
     }
 
-    Wall *wall = GetWallNearMouse();
-    if (wall) {
-        DeleteWall(wall);
+    int wall = GetWallNearMouse();
+    if (wall >= 0) {
+        Do((Edit){ .type = EDIT_DELETE, .seg = level.walls[wall].seg });
     }
 }
 
 
+
+// Middle button drags the wall near the mouse.
+void HandleMiddleClick() {
+    moving = GetWallNearMouse();
+    grab = S_GetMousePos(buffer);
+}
+
+void HandleMiddleRelease() {
+    if (moving < 0) return;
+
+    Vector pos = S_GetMousePos(buffer);
+    Vector d = { pos.x - grab.x, pos.y - grab.y };
+
+    if (d.x || d.y) {
+        Segment from = level.walls[moving].seg;
+        Segment to = {
+            { from.start.x + d.x, from.start.y + d.y },
+            { from.end.x + d.x, from.end.y + d.y },
+        };
+        Do((Edit){ .type = EDIT_MOVE, .seg = from, .to = to });
+    }
+
+    moving = -1;
+}
+
+
 void Input() {
     SDL_Event ev;
     while (SDL_PollEvent(&ev)) {
@@ -280,9 +435,17 @@ void Input() {
                         break;
 
                     case 'c':
-                        ClearWallList(&level);
+                        ClearWalls();
                         puts("Cleared.");
                         break;
+
+                    case 'u':
+                        Undo();
+                        break;
+
+                    case 'r':
+                        Redo();
+                        break;
                 }
                 break;
 
@@ -295,6 +458,16 @@ void Input() {
                     case SDL_BUTTON_RIGHT:
                         HandleRightClick();
                         break;
+
+                    case SDL_BUTTON_MIDDLE:
+                        HandleMiddleClick();
+                        break;
+                }
+                break;
+
+            case SDL_MOUSEBUTTONUP:
+                if (ev.button.button == SDL_BUTTON_MIDDLE) {
+                    HandleMiddleRelease();
                 }
                 break;
         }
@@ -306,6 +479,7 @@ int main() {
 
     while (1) {
         Input();
+        Update();
         Draw();
     }
 
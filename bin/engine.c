@@ -6,44 +6,89 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "arena.h"
 #include "buffer.h"
 #include "collision.h"
+#include "config.h"
 #include "color.h"
 #include "dbg.h"
 #include "defs.h"
 #include "draw.h"
 #include "geometry.h"
+#include "jobs.h"
 #include "map.h"
+#include "metrics.h"
+#include "nav.h"
+#include "net.h"
+#include "player.h"
+#include "profile.h"
+#include "render.h"
+#include "replay.h"
+#include "rle.h"
 #include "sprites.h"
+#include "stats.h"
 #include "system.h"
+#include "text.h"
+#include "watch.h"
+#include "world.h"
 
 //------------------------------------------------------------------------------
-// Constants
+// Settings
+//
+// Read from CONFIG at startup, if it exists. These are the defaults.
 //------------------------------------------------------------------------------
 
+#define CONFIG "engine.cfg"
+
 // Video
-#define WIDTH 640
-#define HEIGHT 400
-#define FOV DEG2RAD(75)                         // Horizontal Field of View
-#define NEAR 1                                  // Near clip plane distance
-#define FAR 300                                 // Far clip plane distance
-#define VIEW ((WIDTH / 2.0) / (tan(FOV / 2.0))) // Viewplane distance
-#define WALLHEIGHT 64
-#define POVHEIGHT (WALLHEIGHT / 2)  // Must be half the wall height.
-const Vector SCREEN_CENTER = { WIDTH/2, HEIGHT/2 };
-const Box SCREEN_BOX = { 0, HEIGHT-1, 0, WIDTH-1 };
+int maxwidth = 640;         // Resolution when drawing at full quality
+int maxheight = 400;
+double fov = 75;            // Horizontal Field of View, in degrees
+double near = 1;            // Near clip plane distance
+double far = 300;           // Far clip plane distance
+int wallheight = 64;
+
+// Engine
+int tickrate = 60;          // Ticks per second
+
+// Game, set to p_defaultmovement and p_defaultradius before reading CONFIG
+Movement movement;
+double radius;              // Player radius
+
+
+// Reads CONFIG with the players' settings table, binding the video settings
+// to the variables above.
+int LoadSettings() {
+    CfVar settings[P_NUMSETTINGS];
+    int numsettings = P_SettingsTable(settings, &movement, &radius, &tickrate);
+
+    Cf_Bind(settings, numsettings, "width", &maxwidth);
+    Cf_Bind(settings, numsettings, "height", &maxheight);
+    Cf_Bind(settings, numsettings, "fov", &fov);
+    Cf_Bind(settings, numsettings, "near", &near);
+    Cf_Bind(settings, numsettings, "far", &far);
+    Cf_Bind(settings, numsettings, "wallheight", &wallheight);
+
+    return Cf_Load(CONFIG, settings, numsettings);
+}
+
+
+
+//------------------------------------------------------------------------------
+// Constants
+//------------------------------------------------------------------------------
 
 // Engine
-#define TICKRATE 60
-#define TICKTIME (1000 / TICKRATE) // milliseconds
+#define SLOWFRAMES 10       // Frames over budget before lowering the quality
+#define FASTFRAMES 120      // Frames well under budget before raising it
 
 // Game
-#define SPEED 6             // Max movement speed
-#define ACCEL 1.5           // Movement acceleration
-#define FRICTION 0.2        // Friction
-#define VANG 0.1            // Turning speed
-#define SENSITIVITY 0.002   // Mouse sensitivity
-#define RADIUS 8            // Player radius
+#define NAVCELL 4           // Navigation grid cell size
+#define WORLDRADIUS 2       // Tiles kept loaded around the player in worlds
+
+// Memory
+#define LEVELBLOCK (4 << 20)    // Level arena growth, in bytes
+#define FRAMEBLOCK (64 << 10)   // Frame arena growth, in bytes
 
 
 
@@ -53,68 +98,182 @@ const Box SCREEN_BOX = { 0, HEIGHT-1, 0, WIDTH-1 };
 
 Mobile player;
 
+Arena level;    // Everything loaded with the current map
+Arena frame;    // Scratch memory, freed every frame
+
 Map *map;       // Current map
-Buffer *buffer; // Video buffer
+NavGrid *nav;   // Navigation grid of the current map, NULL for worlds
+World *world;   // Streamed world the map comes from, if any
+Buffer *framebuffer; // Video buffer, at the maximum resolution...
+Buffer screen;       // ... and the part of it drawn at the current one
+Buffer *buffer;      // Where everything is drawn: &screen
+
+// Render quality, lowered and raised to keep the draw time within budget.
+typedef struct Quality {
+    double scale;       // Of the resolution
+    int interlaced;     // Draw every other column only
+} Quality;
+
+// From best to fastest.
+const Quality qualities[] = {
+    { 1.00, 0 },
+    { 0.75, 0 },
+    { 1.00, 1 },
+    { 0.75, 1 },
+    { 0.50, 0 },
+    { 0.50, 1 },
+};
+#define NUMQUALITIES (sizeof(qualities) / sizeof(qualities[0]))
+
+int quality = 0;        // Current one, in qualities
+int slowframes;         // Consecutive frames over budget...
+int fastframes;         // ... and well under it
+
+Vector screen_center;
+Box screen_box;
 
 // Textures
-Buffer *walltex;
-Buffer *flortex;
-Buffer *ceiltex;
+Renderer renderer;  // First person view, and its textures
+int ticktime;       // Milliseconds per tick
 
 SpriteSheet ascii;
 SpriteSheet pistol;
 
+TextCache text;
+
+// Replays
+Replay recording;   // Where the ticks played are saved, if f is set
+Replay playback;    // Where the ticks come from instead of the input, if f is set
+int headless;       // No window, and ticks as fast as possible
+
+NetClient *client;  // Server the game is played on, if any
+
+// Telemetry, served with --metrics
+Metrics metrics;
+Metric *tickcount;      // Ticks run
+Metric *ticktimes;      // Time taken by every tick, draw and blit, in ms
+Metric *drawtimes;
+Metric *blittimes;
+Metric *loadcount;      // Files loaded by the job pool
+Metric *qualitylevel;   // Index of the current quality
+Metric *levelmemory;    // Bytes used by the arenas
+Metric *framememory;
+
+const char *profilepath;    // Where to write the profile, with --profile
+
+// Loading
+
+// Map and assets of a level, loaded in parallel.
+enum {
+    LOAD_MAP,
+    LOAD_ASCII,
+    LOAD_FLOOR,
+    LOAD_WALL,
+    LOAD_CEIL,
+    LOAD_PISTOL,
+    LOADJOBS
+};
+
+JobPool jobs;
+Job loading[LOADJOBS];  // Map and assets of the level being loaded
+
+// Hot reloading
+typedef struct Reload {
+    int pending;        // The file changed since the last reload started
+    int running;        // job is reloading it
+    Job job;
+} Reload;
+
+FileWatch watch;
+int watched[MAXWATCHED];    // What each watched file is: LOAD_*
+Reload reloads[LOADJOBS];
+char levelpath[256];
+
 // Flags
 int fullscreenf = 0;  // Fullscreen
 int mapf = 1;         // Automap
 
 // Performance Graph
 
-// Stores the time it took to process a tick, draw the full buffer
-// and blit it in milliseconds.
-typedef struct PerfInfo {
-    uint32_t ticktime;
-    uint32_t drawtime;
-    uint32_t blittime;
-} PerfInfo;
+// What the graph shows of every frame: the time it took to process a tick,
+// draw the full buffer and blit it, in milliseconds.
+enum {
+    PERF_TICK,
+    PERF_DRAW,
+    PERF_BLIT,
+};
 
-// Ring buffer that stores the last PerfInfo's
-#define INFOBUFLEN 100
-PerfInfo infobuf[INFOBUFLEN];
-int infohead = 0;
+#define GRAPHLEN 100    // Frames in the graph
+MtRing perf;            // The latest frames
 
-// Look-Up Tables
-double ray_angle_lut[WIDTH];
+// Work done by the last frame, with -DSTATS
+#define STATSWIDTH 20   // Characters in a line of the overlay
+Stats laststats;
 
 
 //------------------------------------------------------------------------------
 // Engine code
 //------------------------------------------------------------------------------
 
-void PushInfo(PerfInfo info) {
-    infobuf[infohead++] = info;
-
-    if (infohead > INFOBUFLEN - 1) {
-        infohead = 0;
+// Creates the metrics, and serves them on port unless it's 0.
+void InitMetrics(int port) {
+    Mt_Init(&metrics);
+
+    tickcount = Mt_Counter(&metrics, "engine_ticks_total", "Ticks run");
+    ticktimes = Mt_Histogram(&metrics, "engine_tick_seconds",
+            "Time to process a tick", 0.001);
+    drawtimes = Mt_Histogram(&metrics, "engine_draw_seconds",
+            "Time to draw a frame", 0.001);
+    blittimes = Mt_Histogram(&metrics, "engine_blit_seconds",
+            "Time to blit a frame", 0.001);
+    loadcount = Mt_Counter(&metrics, "engine_loads_total",
+            "Maps, textures and sprite sheets loaded");
+    qualitylevel = Mt_Gauge(&metrics, "engine_quality",
+            "Render quality, 0 being the best", 1);
+    levelmemory = Mt_Gauge(&metrics, "engine_level_arena_bytes",
+            "Memory used by the level", 1);
+    framememory = Mt_Gauge(&metrics, "engine_frame_arena_bytes",
+            "Memory used by the last frame", 1);
+
+    if (port && Mt_Serve(&metrics, port)) {
+        log_info("Serving metrics on port %d", port);
     }
 }
 
 
-void DrawOneInfo(PerfInfo info, int x) {
+// Adds the timings of a frame to the graph and the metrics.
+void RecordFrame(const uint32_t info[MTFIELDS]) {
+    Mt_Push(&perf, info);
+
+    Mt_Add(tickcount, 1);
+    Mt_Observe(ticktimes, info[PERF_TICK]);
+    Mt_Observe(drawtimes, info[PERF_DRAW]);
+    if (!headless) Mt_Observe(blittimes, info[PERF_BLIT]);
+
+    Mt_Set(qualitylevel, quality);
+    Mt_Set(levelmemory, level.used);
+    Mt_Set(framememory, frame.used);
+
+    laststats = ST_EndFrame();
+}
+
+
+// Bars taller than the graph are cut at its top.
+void DrawOneInfo(const uint32_t info[MTFIELDS], int x) {
     int y = 20;
-    for (int j = 0; j < info.ticktime; j++) {
+    for (int j = 0; j < info[PERF_TICK] && y >= 0; j++) {
         B_SetPixel(buffer, x, y--, BLUE);
     }
 
-    for (int j = 0; j < info.drawtime; j++) {
+    for (int j = 0; j < info[PERF_DRAW] && y >= 0; j++) {
         B_SetPixel(buffer, x, y--, GREEN);
     }
 
-    for (int j = 0; j < info.blittime; j++) {
+    for (int j = 0; j < info[PERF_BLIT] && y >= 0; j++) {
         B_SetPixel(buffer, x, y--, YELLOW);
     }
 
-    B_SetPixel(buffer, x, 20 - TICKTIME, RED);
+    B_SetPixel(buffer, x, MAX(0, 20 - ticktime), RED);
 }
 
 
@@ -126,57 +285,513 @@ void DrawOneInfo(PerfInfo info, int x) {
 // Yellow:  Time to blit the buffer to the screen.
 // Red:     Maximum time per Tick available.
 void DrawPerfGraph() {
-    int x = WIDTH - 10;
+    // Frames not played yet show as empty.
+    uint32_t (*latest)[MTFIELDS] = A_Alloc(&frame, sizeof(*latest) * GRAPHLEN);
+    if (!latest) return;
+    memset(latest, 0, sizeof(*latest) * GRAPHLEN);
+    Mt_Latest(&perf, latest, GRAPHLEN);
+
+    int x = buffer->width - 10;
+    for (int i = 0; i < GRAPHLEN; i++, x--) {
+        DrawOneInfo(latest[i], x);
+    }
+}
+
 
-    for (int i = infohead - 1; i >= 0; i--, x--) {
-        DrawOneInfo(infobuf[i], x);
+// Draws the work done by the last frame under the performance graph: see
+// stats.h.
+void DrawStats() {
+    uint64_t *n = laststats.counts;
+    int x = buffer->width - 10 - STATSWIDTH * GLYPHWIDTH;
+
+    T_Draw(&text, buffer, x, 25, "Ray tests    %7lu", (unsigned long)n[ST_WALLTESTS]);
+    T_Draw(&text, buffer, x, 35, "Ray hits     %7lu", (unsigned long)n[ST_WALLHITS]);
+    T_Draw(&text, buffer, x, 45, "Pixels %7lu x%.2f", (unsigned long)n[ST_PIXELS],
+            (double)n[ST_PIXELS] / (buffer->width * buffer->height));
+    T_Draw(&text, buffer, x, 55, "Texels       %7lu", (unsigned long)n[ST_TEXELS]);
+    T_Draw(&text, buffer, x, 65, "Move tests   %7lu",
+            (unsigned long)n[ST_COLLISIONTESTS]);
+}
+
+
+// Draws the memory used by the arenas, in KiB.
+void DrawMemory() {
+    T_Draw(&text, buffer, 10, 10, "Level: %zu (peak %zu)",
+            level.used >> 10, level.highwater >> 10);
+    T_Draw(&text, buffer, 10, 20, "Frame: %zu (peak %zu)",
+            frame.used >> 10, frame.highwater >> 10);
+}
+
+
+// Draws the current render resolution.
+void DrawResolution() {
+    T_Draw(&text, buffer, 10, 30, "Res: %dx%d%s",
+            buffer->width, buffer->height,
+            qualities[quality].interlaced ? " interlaced" : "");
+}
+
+
+// Draws at the resolution and columns given by quality q from now on.
+void SetQuality(int q) {
+    quality = q;
+
+    int width = maxwidth * qualities[q].scale;
+    int height = maxheight * qualities[q].scale;
+    height &= ~1;   // The view is split in two halves.
+
+    screen = B_View(framebuffer, 0, 0, width, height);
+    buffer = &screen;
+
+    renderer.interlaced = qualities[q].interlaced;
+    screen_center = (Vector){ width / 2, height / 2 };
+    screen_box = (Box){ 0, height - 1, 0, width - 1 };
+}
+
+
+// Lowers the quality after a few frames over budget, and raises it after
+// many well under it.
+void AdjustQuality(uint32_t drawtime) {
+    // Leave time for the tick and the blit.
+    uint32_t budget = ticktime * 3 / 4;
+
+    if (drawtime > budget) {
+        slowframes++;
+        fastframes = 0;
+    } else if (drawtime < budget / 2) {
+        fastframes++;
+        slowframes = 0;
+    } else {
+        slowframes = fastframes = 0;
     }
 
-    for (int i = INFOBUFLEN - 1; i >= infohead; i--, x--) {
-        DrawOneInfo(infobuf[i], x);
+    if (slowframes >= SLOWFRAMES && quality < NUMQUALITIES - 1) {
+        SetQuality(quality + 1);
+        slowframes = 0;
+    } else if (fastframes >= FASTFRAMES && quality > 0) {
+        SetQuality(quality - 1);
+        fastframes = 0;
     }
 }
 
 
-void InitLUT() {
-    for (int x = 0; x < WIDTH; x++) {
-        ray_angle_lut[x] = atan2((x + 0.5) - (WIDTH / 2), VIEW);
+void Quit() {
+    if (client) Nt_Disconnect(client);
+    RP_Close(&recording);
+    RP_Close(&playback);
+    Mt_Free(&metrics);
+    if (profilepath) {
+        Pf_Stop();
+        Pf_Write(profilepath);
     }
+    if (!headless) S_Quit();
+    exit(0);
 }
 
 
-void Init() {
-    InitLUT();
+// Returns 1 if path names a streamed world rather than a map.
+int IsWorld(const char *path) {
+    size_t len = strlen(path);
+    return len > 6 && !strcmp(path + len - 6, ".world");
+}
 
-    // Window & buffer
-    S_Init("Engine", WIDTH, HEIGHT);
-    S_GrabMouse(1);
-    buffer = B_CreateBuffer(WIDTH, HEIGHT);
+
+// Loads the map stored in path, or opens it if it's a world, along with its
+// navigation grid. Runs on the job pool.
+void *LoadMap(void *arg) {
+    const char *path = arg;
+
+    if (IsWorld(path)) {
+        // Only the tiles around the player are loaded, there's no whole map
+        // to build a navigation grid from.
+        world = W_Open(path, WORLDRADIUS, player.pos);
+        if (!world) return NULL;
+
+        map = W_GetMap(world);
+        nav = NULL;
+    } else {
+        map = M_Load(path, &level);
+        if (!map) return NULL;
+
+        // Navigation grid, built once and stored next to the map
+        char navpath[256];
+        snprintf(navpath, sizeof(navpath), "%s.nav", path);
+
+        nav = N_Load(navpath, map, radius, NAVCELL, &level);
+        if (!nav) {
+            nav = N_Build(map, radius, NAVCELL, &level);
+            N_Save(nav, navpath);
+        }
+    }
+
+    Mt_Add(loadcount, 1);
+    return map;
+}
+
+
+void *LoadTexture(void *path) {
+    Mt_Add(loadcount, 1);
+    return S_LoadImage(path, &level);
+}
+
+
+typedef struct SheetJob {
+    const char *path;
+    int rows, cols;
+} SheetJob;
+
+SheetJob sheetjobs[LOADJOBS] = {
+    [LOAD_ASCII] = { "ascii.png", 16, 16 },
+    [LOAD_PISTOL] = { "pistol.png", 2, 3 },
+};
+
+const char *texpaths[LOADJOBS] = {
+    [LOAD_FLOOR] = "floor.png",
+    [LOAD_WALL] = "wall.png",
+    [LOAD_CEIL] = "ceil.png",
+};
+
+
+// Returns the sprite sheet or texture loaded by job i.
+SpriteSheet *SheetOf(int i) {
+    return i == LOAD_ASCII ? &ascii : &pistol;
+}
+
+Buffer **TextureOf(int i) {
+    return i == LOAD_FLOOR ? &renderer.flortex :
+        i == LOAD_WALL ? &renderer.walltex : &renderer.ceiltex;
+}
+
+
+void *LoadSheet(void *arg) {
+    SheetJob *j = arg;
+
+    SpriteSheet *ss = A_Alloc(&level, sizeof(SpriteSheet));
+    *ss = SS_LoadSpriteSheet(j->path, j->rows, j->cols, &level);
+    Mt_Add(loadcount, 1);
+    return ss;
+}
+
+
+// Frees whatever was reloaded into the heap since the level was loaded.
+// Everything else goes with the level arena.
+void FreeLevel() {
+    if (world) {
+        W_Close(world);
+        world = NULL;
+    } else if (map) {
+        M_Delete(map);
+    }
+
+    if (nav) N_Delete(nav);
+
+    for (int i = 0; i < LOADJOBS; i++) {
+        if (sheetjobs[i].path && SheetOf(i)->atlas) SS_DeleteSpriteSheet(*SheetOf(i));
+        if (texpaths[i] && *TextureOf(i)) B_DeleteBuffer(*TextureOf(i));
+    }
+
+    map = NULL;
+    nav = NULL;
+}
+
+
+// Frees everything loaded with the previous map, if any, and starts loading
+// the map stored in path along with its textures on the job pool. Nothing
+// loaded can be used until FinishLoadingLevel().
+void StartLoadingLevel(const char *path) {
+    FreeLevel();
+    A_Reset(&level);
+
+    snprintf(levelpath, sizeof(levelpath), "%s", path);
+
+    // Biggest first, so the slowest one starts right away.
+    J_Submit(&jobs, &loading[LOAD_MAP], levelpath, LoadMap, levelpath);
+    J_Submit(&jobs, &loading[LOAD_ASCII], "ascii.png", LoadSheet, &sheetjobs[LOAD_ASCII]);
+    J_Submit(&jobs, &loading[LOAD_FLOOR], "floor.png", LoadTexture, "floor.png");
+    J_Submit(&jobs, &loading[LOAD_WALL], "wall.png", LoadTexture, "wall.png");
+    J_Submit(&jobs, &loading[LOAD_CEIL], "ceil.png", LoadTexture, "ceil.png");
+    J_Submit(&jobs, &loading[LOAD_PISTOL], "pistol.png", LoadSheet, &sheetjobs[LOAD_PISTOL]);
+}
+
+
+// Starts watching the files of the level for changes. Worlds are streamed
+// from a file built offline, and aren't watched.
+void Watch(const char *path, int what) {
+    int id = FW_Add(&watch, path);
+    if (id >= 0) watched[id] = what;
+}
+
+void WatchLevel() {
+    FW_Quit(&watch);
+    FW_Init(&watch);
+
+    if (!world) {
+        char journal[256 + 8];
+        snprintf(journal, sizeof(journal), "%s.journal", levelpath);
+
+        Watch(levelpath, LOAD_MAP);
+        Watch(journal, LOAD_MAP);
+    }
+
+    for (int i = 0; i < LOADJOBS; i++) {
+        if (texpaths[i]) Watch(texpaths[i], i);
+        if (sheetjobs[i].path) Watch(sheetjobs[i].path, i);
+    }
+}
+
+
+// Waits for the jobs started by StartLoadingLevel() and reports how long
+// each one took.
+void FinishLoadingLevel() {
+    double slowest = 0;
+    for (int i = 0; i < LOADJOBS; i++) {
+        J_Wait(&loading[i]);
+        log_info("Loaded %-12s in %6.1f ms (queued %5.1f ms)",
+                loading[i].name, loading[i].took, loading[i].waited);
+        slowest = MAX(slowest, loading[i].waited + loading[i].took);
+    }
+    log_info("Level loaded in %.1f ms", slowest);
+
+    check(loading[LOAD_MAP].result, "Can't load %s", loading[LOAD_MAP].name);
+    if (!loading[LOAD_MAP].result) Quit();
+
+    renderer.flortex = loading[LOAD_FLOOR].result;
+    renderer.walltex = loading[LOAD_WALL].result;
+    renderer.ceiltex = loading[LOAD_CEIL].result;
+    ascii = *(SpriteSheet *)loading[LOAD_ASCII].result;
+    pistol = *(SpriteSheet *)loading[LOAD_PISTOL].result;
+
+    T_Free(&text);
+    T_Init(&text, ascii, &frame);
+
+    WatchLevel();
+}
+
+
+// Frees everything loaded with the previous map, if any, and loads the map
+// stored in path along with its textures.
+void LoadLevel(const char *path) {
+    StartLoadingLevel(path);
+    FinishLoadingLevel();
+}
+
+
+// A map reloaded, and what changed from the current one.
+typedef struct MapReload {
+    Map *map;
+    int *from;      // Wall of the current map each wall matches, -1 if new
+    int diffs;      // How many walls are different
+    Box changed;    // Where they are
+    NavGrid *nav;   // Grid of the new map, NULL if nothing changed
+} MapReload;
+
+
+// Returns 1 if box is inside the area covered by nav.
+int NavCovers(NavGrid *nav, Box box) {
+    return box.left >= nav->origin.x && box.top >= nav->origin.y &&
+        box.right <= nav->origin.x + (nav->width - 1) * nav->cellsize &&
+        box.bottom <= nav->origin.y + (nav->height - 1) * nav->cellsize;
+}
+
+
+// Runs on the job pool while the current map is still in use.
+void *ReloadMap(void *path) {
+    MapReload *r = calloc(1, sizeof(MapReload));
+    check_mem(r);
+
+    // The file can be gone, or half written, by the time the job runs.
+    r->map = M_Load(path, NULL);
+    if (!r->map) {
+        free(r);
+        return NULL;
+    }
+
+    r->from = malloc(sizeof(int) * MAX(r->map->numwalls, 1));
+    check_mem(r->from);
+    r->diffs = M_Diff(map, r->map, r->from, &r->changed);
+    if (!r->diffs) return r;
+
+    // The current grid is only read here, while the main thread keeps using
+    // it: update a copy of it, unless the changes are out of it.
+    if (NavCovers(nav, r->changed)) {
+        // Cells up to radius away from the walls are blocked by them.
+        double margin = radius + NAVCELL;
+        r->nav = N_Copy(nav, NULL);
+        N_UpdateRegion(r->nav, r->map, (Box){
+                r->changed.top - margin, r->changed.bottom + margin,
+                r->changed.left - margin, r->changed.right + margin });
+    } else {
+        r->nav = N_Build(r->map, radius, NAVCELL, NULL);
+    }
+
+    char navpath[256 + 8];
+    snprintf(navpath, sizeof(navpath), "%s.nav", (char *)path);
+    N_Save(r->nav, navpath);
+
+    return r;
+}
+
+
+void *ReloadTexture(void *path) {
+    return S_LoadImage(path, NULL);
+}
+
+
+void *ReloadSheet(void *arg) {
+    SheetJob *j = arg;
+
+    SpriteSheet loaded = SS_LoadSpriteSheet(j->path, j->rows, j->cols, NULL);
+    if (!loaded.atlas) return NULL;
+
+    SpriteSheet *ss = malloc(sizeof(SpriteSheet));
+    check_mem(ss);
+    *ss = loaded;
+    return ss;
+}
+
+
+// Replaces the current map, and its navigation grid, with the ones reloaded.
+void SwapMap(MapReload *r) {
+    for (int i = 0; i < r->map->numwalls; i++) {
+        if (r->from[i] >= 0) {
+            r->map->walls[i].seen = map->walls[r->from[i]].seen;
+        }
+    }
+
+    M_Delete(map);
+    map = r->map;
+
+    if (r->nav) {
+        N_Delete(nav);
+        nav = r->nav;
+    }
+
+    log_info("Reloaded %s: %d walls changed", levelpath, r->diffs);
+
+    free(r->from);
+    free(r);
+}
+
+
+void StartReload(int i, Job *job) {
+    if (i == LOAD_MAP) {
+        J_Submit(&jobs, job, levelpath, ReloadMap, levelpath);
+    } else if (texpaths[i]) {
+        J_Submit(&jobs, job, texpaths[i], ReloadTexture, (void *)texpaths[i]);
+    } else {
+        J_Submit(&jobs, job, sheetjobs[i].path, ReloadSheet, &sheetjobs[i]);
+    }
+}
+
+
+// Puts in place what job i reloaded. Whatever couldn't be loaded, a map
+// included, leaves the old one in place.
+void SwapIn(int i, void *result) {
+    if (!result) {
+        log_err("Keeping the old %s", reloads[i].job.name);
+    } else if (i == LOAD_MAP) {
+        SwapMap(result);
+    } else if (texpaths[i]) {
+        B_DeleteBuffer(*TextureOf(i));
+        *TextureOf(i) = result;
+    } else {
+        SS_DeleteSpriteSheet(*SheetOf(i));
+        *SheetOf(i) = *(SpriteSheet *)result;
+        free(result);
+
+        if (i == LOAD_ASCII) {
+            T_Free(&text);
+            T_Init(&text, ascii, &frame);
+        }
+    }
+}
+
+
+// Starts reloading the files of the level that changed, on the job pool, and
+// puts in place the ones done reloading. Called between ticks, so nothing is
+// ever half replaced.
+void HotReload() {
+    int id;
+    while ((id = FW_Poll(&watch)) >= 0) {
+        reloads[watched[id]].pending = 1;
+    }
+
+    for (int i = 0; i < LOADJOBS; i++) {
+        Reload *r = &reloads[i];
+
+        if (r->running && J_Done(&r->job)) {
+            SwapIn(i, r->job.result);
+            log_info("Reloaded %s in %.1f ms", r->job.name, r->job.took);
+            r->running = 0;
+        }
+
+        // Changes made while reloading get another go.
+        if (r->pending && !r->running) {
+            r->pending = 0;
+            r->running = 1;
+            StartReload(i, &r->job);
+        }
+    }
+}
+
+
+void Init(const char *path) {
+    movement = p_defaultmovement;
+    radius = p_defaultradius;
+    if (LoadSettings()) {
+        log_info("Settings read from %s", CONFIG);
+    }
+
+    ticktime = 1000 / tickrate;
+    R_Init(&renderer, DEG2RAD(fov), near, far, wallheight);
+
+    A_Init(&level, LEVELBLOCK);
+    A_Init(&frame, FRAMEBLOCK);
+    A_Share(&level);
 
     // Player
     player = (Mobile){
         .pos = (Vector){25, 25},
         .vel = (Vector){0, 0},
         .forward = G_Normalize((Vector){1, 1}),
-        .radius = RADIUS,
+        .radius = radius,
     };
 
-    // Map
-    map = M_Load("level.map");
+    // Decode the assets while the window opens.
+    S_InitImages();
+    J_Init(&jobs, 0);
+    FW_Init(&watch);
+    StartLoadingLevel(path);
 
-    // Textures
-    flortex = S_LoadImage("floor.png");
-    walltex = S_LoadImage("wall.png");
-    ceiltex = S_LoadImage("ceil.png");
+    // Window & buffer
+    if (!headless) {
+        S_Init("Engine", maxwidth, maxheight);
+        S_GrabMouse(1);
+    }
+    framebuffer = B_CreateBuffer(maxwidth, maxheight, NULL);
+    SetQuality(0);
 
-    ascii = SS_LoadSpriteSheet("ascii.png", 16, 16);
-    pistol = SS_LoadSpriteSheet("pistol.png", 2, 3);
+    FinishLoadingLevel();
 }
 
 
-void Quit() {
-    S_Quit();
-    exit(0);
+// Draws the other players in the game, if it's online.
+void DrawOthers() {
+    if (!client || !client->latest) return;
+
+    for (int i = 0; i < MAXPEERS; i++) {
+        if (!client->latest->present[i] || i == client->id) continue;
+
+        Mobile *mob = &client->latest->mobs[i];
+        Vector p = G_Sum(G_Sub(mob->pos, player.pos), screen_center);
+
+        double r = mob->radius;
+        if (p.x - r < screen_box.left || p.x + r > screen_box.right ||
+                p.y - r < screen_box.top || p.y + r > screen_box.bottom) {
+            continue;
+        }
+
+        D_DrawCircle(buffer, p.x, p.y, mob->radius, RED);
+    }
 }
 
 
@@ -188,124 +803,54 @@ void DrawMap() {
         Segment s = w->seg;
 
         s = G_TranslateSegment(s, N(player.pos));
-        s = G_TranslateSegment(s, SCREEN_CENTER);
+        s = G_TranslateSegment(s, screen_center);
 
         Segment cliped;
-        if (G_ClipSegment(s, SCREEN_BOX, &cliped)) {
+        if (G_ClipSegment(s, screen_box, &cliped)) {
             D_DrawSegment(buffer, cliped, WHITE);
         }
     }
 
     Segment s1 = {
-        .start = SCREEN_CENTER,
-        .end = G_Sum(SCREEN_CENTER, G_Scale(RADIUS, G_Rotate(player.forward, FOV / 2)))
+        .start = screen_center,
+        .end = G_Sum(screen_center, G_Scale(radius, G_Rotate(player.forward, DEG2RAD(fov) / 2)))
     };
     Segment s2 = {
-        .start = SCREEN_CENTER,
-        .end = G_Sum(SCREEN_CENTER, G_Scale(RADIUS, G_Rotate(player.forward, -FOV / 2)))
+        .start = screen_center,
+        .end = G_Sum(screen_center, G_Scale(radius, G_Rotate(player.forward, -DEG2RAD(fov) / 2)))
     };
 
     D_DrawSegment(buffer, s1, GREEN);
     D_DrawSegment(buffer, s2, GREEN);
-    D_DrawCircle(buffer, SCREEN_CENTER.x, SCREEN_CENTER.y, RADIUS, GREEN);
+    D_DrawCircle(buffer, screen_center.x, screen_center.y, radius, GREEN);
+
+    DrawOthers();
 
     DrawPerfGraph();
+#ifdef STATS
+    DrawStats();
+#endif
+    DrawMemory();
+    DrawResolution();
 }
 
 
 void DrawPOV() {
-    for (int x = 0; x < WIDTH; x++) {
-        double ray_angle = ray_angle_lut[x];
-        double ray_cos = cos(ray_angle);
-        double viewcos = VIEW / ray_cos;
-        double nearcos = NEAR / ray_cos;
-
-        Line ray = {
-            .start = player.pos,
-            .dir = G_Rotate(player.forward, ray_angle)
-        };
-
-        // Iterate over all the walls and use the one that's hit
-        // closest to the player.
-        Wall *wall = NULL;
-        double distance = DBL_MAX;
-        Vector hit;
-
-        for (int i = 0; i < map->numwalls; i++) {
-            Wall *w = &map->walls[i];
-            Vector h;
-            if (G_SegmentRayIntersection(w->seg, ray, &h)) {
-                double d = G_Distance(h, player.pos);
-                if (d < distance && d > nearcos) {
-                    wall = w;
-                    distance = d;
-                    hit = h;
-                }
-            }
-        }
-
-        // Wall
-        int col_height = 0;
-        if (wall) {
-            wall->seen = 1;
-
-            col_height = viewcos * WALLHEIGHT / distance;
-            // Everything is *much* easier if col_height is even.
-            if (col_height & 1) col_height++;
-
-            int top = (buffer->height - col_height) / 2;
-
-            int texel_x = MOD((int)G_Distance(wall->seg.start, hit), walltex->width);
-            for (int i = 0; i < col_height; i++) {
-                int y = top + i;
-                if (y < 0 || y >= HEIGHT) continue;
-
-                int texel_y = WALLHEIGHT * i / col_height;
-                uint32_t c = walltex->pixels[texel_y * walltex->width + texel_x];
-                if (distance > FAR) {
-                    c = C_ScaleColor(c, FAR / distance);
-                }
-
-                B_SetPixel(buffer, x, y, c);
-            }
-        }
-
-        // Floor & ceiling
-        for (int h = (HEIGHT - col_height) / 2; h > 0; h--) {
-            double texel_distance = (POVHEIGHT * viewcos) / ((HEIGHT / 2) - h);
-            Vector texel_world_pos = G_Sum(player.pos, G_Scale(texel_distance, ray.dir));
-
-            int texel_x = MOD((int)texel_world_pos.x, flortex->width);
-            int texel_y = MOD((int)texel_world_pos.y, flortex->height);
-
-            uint32_t color = flortex->pixels[texel_y * flortex->width + texel_x];
-            if (texel_distance > FAR) {
-                color = C_ScaleColor(color, FAR / texel_distance);
-            }
-            B_SetPixel(buffer, x, HEIGHT - h, color);
-
-            texel_x = MOD((int)texel_world_pos.x, ceiltex->width);
-            texel_y = MOD((int)texel_world_pos.y, ceiltex->height);
-
-            color = ceiltex->pixels[texel_y * ceiltex->width + texel_x];
-            if (texel_distance > FAR) {
-                color = C_ScaleColor(color, FAR / texel_distance);
-            }
-            B_SetPixel(buffer, x, h - 1, color);
-        }
-    }
+    R_DrawView(&renderer, buffer, map, player.pos, player.forward);
 }
 
 
 void DrawGun() {
-    Buffer *p = SS_GetSprite(pistol, 0, 0);
-    B_BlitBuffer(buffer, p, 1.1 * SCREEN_CENTER.x, HEIGHT - p->height);
+    RLESprite *p = SS_GetCompiledSprite(pistol, 0, 0);
+    RL_Blit(buffer, p, 1.1 * screen_center.x, buffer->height - p->height);
 }
 
 
 uint32_t Draw() {
     uint32_t start = S_GetTime();
 
+    T_NewFrame(&text);
+
     DrawPOV();
     DrawGun();
 
@@ -322,62 +867,164 @@ uint32_t Draw() {
 uint32_t ProcessATick(Tick t) {
     uint32_t start = S_GetTime();
 
-    // Turning
-    if (t.turn) {
-        player.forward = G_Rotate(player.forward, t.turn * VANG);
+    if (client) {
+        // The server has the last word, we only run ahead of it.
+        Nt_SendInput(client, t);
+        Nt_ReceiveSnapshots(client);
+        Nt_Predict(client, map, &movement, &player);
+    } else {
+        P_Move(&player, map, &movement, t);
     }
 
-    if (t.relative_mouse_x) {
-        player.forward = G_Rotate(player.forward, t.relative_mouse_x * SENSITIVITY);
-    }
+    return S_GetTime() - start;
+}
 
 
-    // Acceleration
-    Vector side = G_Perpendicular(player.forward);
-    Vector a = G_SetLength(
-            G_Sum(
-                G_Scale(t.forward, player.forward),
-                G_Scale(t.strafe,  side)
-                ),
-            ACCEL
-            );
+//------------------------------------------------------------------------------
+// Replays
+//------------------------------------------------------------------------------
+
+// Starts saving the ticks to recordpath and playing them from replaypath.
+// Either can be NULL.
+void StartReplays(const char *recordpath, const char *replaypath) {
+    if (replaypath) {
+        if (!RP_StartPlaying(&playback, replaypath)) Quit();
 
-    if (t.forward || t.strafe) {
-        player.vel = G_Sum(player.vel, a);
-    } else {
-        player.vel = G_Sub(player.vel, G_Scale(FRICTION, player.vel));
+        if (playback.maphash != M_Hash(map)) {
+            log_err("%s was recorded on another map", replaypath);
+            Quit();
+        }
+        if (playback.tickrate != tickrate) {
+            log_warn("%s was recorded at %d ticks per second, playing at %d",
+                    replaypath, playback.tickrate, tickrate);
+        }
+
+        // Other settings would take the player somewhere else.
+        Movement m = playback.movement;
+        if (m.speed != movement.speed || m.accel != movement.accel ||
+                m.friction != movement.friction || m.turnspeed != movement.turnspeed ||
+                m.sensitivity != movement.sensitivity) {
+            log_warn("%s was recorded with other movement settings, using those",
+                    replaypath);
+            movement = m;
+        }
+
+        player = playback.start;
     }
 
-    if (G_Length(player.vel) > SPEED) {
-        player.vel = G_SetLength(player.vel, SPEED);
+    if (recordpath) {
+        if (!RP_StartRecording(&recording, recordpath, M_Hash(map), player,
+                    movement, tickrate)) {
+            Quit();
+        }
     }
+}
 
-    // Translation
-    player.pos = Co_Move(map, player).pos;
 
-    return S_GetTime() - start;
+// Reports where the replay left the player, to compare runs, and how long it
+// took to play.
+void FinishPlaying(uint32_t elapsed, uint64_t ticktotal, uint64_t drawtotal) {
+    int n = MAX(playback.numticks, 1);
+
+    printf("Played %d ticks in %u ms (%.1f ticks/s)\n", playback.numticks,
+            elapsed, playback.numticks * 1000.0 / MAX(elapsed, 1));
+    printf("Average tick %.3f ms, draw %.3f ms\n",
+            (double)ticktotal / n, (double)drawtotal / n);
+    printf("Final position %.6f %.6f, facing %.6f %.6f\n",
+            player.pos.x, player.pos.y, player.forward.x, player.forward.y);
 }
 
 
-int main() {
-    Init();
 
-    uint32_t last_tick = S_GetTime();
+int main(int argc, char **argv) {
+    const char *path = "level.map";
+    const char *recordpath = NULL;
+    const char *replaypath = NULL;
+    const char *server = NULL;
+    int port = NETPORT;
+    int metricsport = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+            recordpath = argv[++i];
+        } else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+            replaypath = argv[++i];
+        } else if (!strcmp(argv[i], "--headless")) {
+            headless = 1;
+        } else if (!strcmp(argv[i], "--connect") && i + 1 < argc) {
+            server = argv[++i];
+        } else if (!strcmp(argv[i], "--port") && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--metrics") && i + 1 < argc) {
+            metricsport = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--profile") && i + 1 < argc) {
+            profilepath = argv[++i];
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (headless && !replaypath) {
+        fprintf(stderr, "Usage: %s [--record file] [--replay file [--headless]] "
+                "[--connect address [--port n]] [--metrics port] [--profile file] "
+                "[map]\n",
+                argv[0]);
+        return 1;
+    }
+
+    InitMetrics(metricsport);
+    Init(path);
+    StartReplays(recordpath, replaypath);
+
+    // Loading is left out, to profile frames only.
+    if (profilepath && !Pf_Start(PFHZ)) profilepath = NULL;
+
+    if (server) {
+        client = Nt_Connect(server, port);
+        if (!client) Quit();
+    }
+
+    // Sessions that are recorded or played have to run the same simulation:
+    // no reloading, and no walls missing because they're still streaming in.
+    int exact = recording.f || playback.f;
+
+    uint64_t ticktotal = 0, drawtotal = 0;
+    uint32_t started = S_GetTime();
+    uint32_t last_tick = started;
     while (1) {
-        if (S_GetTime() - last_tick > TICKTIME) {
+        if (headless || S_GetTime() - last_tick > ticktime) {
             last_tick = S_GetTime();
+            A_Reset(&frame);
+
+            if (!exact) HotReload();
+
+            // Pick up the tiles streamed in since the last tick.
+            if (world) {
+                W_SetCenter(world, player.pos);
+                if (exact) W_Wait(world);
+                map = W_GetMap(world);
+            }
+
+            // The input is still read when playing, to be able to quit.
+            Tick t = headless ? (Tick){0} : S_GetTick();
+            if (playback.f && !RP_Play(&playback, &t)) break;
+            if (recording.f) RP_Record(&recording, t);
 
-            Tick t = S_GetTick();
+            uint32_t info[MTFIELDS] = {0};
 
-            PerfInfo info = {0};
+            info[PERF_TICK] = ProcessATick(t);
+            info[PERF_DRAW] = Draw();
+            if (!headless) info[PERF_BLIT] = S_Blit(buffer);
 
-            info.ticktime = ProcessATick(t);
-            info.drawtime = Draw();
-            info.blittime = S_Blit(buffer);
+            // Replays are drawn at a fixed quality, to compare their timings.
+            if (!playback.f) AdjustQuality(info[PERF_DRAW]);
 
-            PushInfo(info);
+            RecordFrame(info);
+            ticktotal += info[PERF_TICK];
+            drawtotal += info[PERF_DRAW];
         }
     }
 
+    FinishPlaying(S_GetTime() - started, ticktotal, drawtotal);
     Quit();
 }
@@ -0,0 +1,238 @@
+// Generates maps of any size, for stress testing.
+//
+//   mapgen [--style maze|arena|city] [--walls n] [--seed n]
+//          [--world path [--tilesize n]] map
+//
+// Writes a map with about n walls (1000 by default, within a few for arenas and
+// cities), laid out as:
+//
+//   maze   a perfect maze on a square grid, every cell reachable
+//   arena  a square room with a grid of pillars in it
+//   city   blocks of buildings of random sizes, between streets
+//
+// The same seed gives the same map. --world also writes it as a streamed
+// world. The player starts at (25, 25), which is always left clear.
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbg.h"
+#include "defs.h"
+#include "geometry.h"
+#include "map.h"
+#include "world.h"
+
+#define WALLS 1000
+#define TILESIZE 512
+
+#define MAZECELL 64         // Corridor width in mazes
+#define PILLAR 32           // Pillar side in arenas...
+#define PILLARGAP 96        // ... and distance between them
+#define STREET 48           // Street width in cities
+#define LOTS 3              // Buildings per block side
+#define LOT 80              // Building lot side
+#define MARGIN 64           // Clear space around the start position
+
+Map map;
+int capacity;
+
+uint64_t seed = 1;
+
+
+// xorshift64*, so the same seed gives the same map everywhere.
+uint32_t Random() {
+    seed ^= seed >> 12;
+    seed ^= seed << 25;
+    seed ^= seed >> 27;
+    return (seed * 2685821657736338717ULL) >> 32;
+}
+
+
+void AddWall(double x0, double y0, double x1, double y1) {
+    if (map.numwalls == capacity) {
+        capacity = capacity ? capacity * 2 : 1024;
+        map.walls = realloc(map.walls, sizeof(Wall) * capacity);
+        check_mem(map.walls);
+    }
+
+    map.walls[map.numwalls++] = (Wall){
+        .seg = { {x0, y0}, {x1, y1} },
+    };
+}
+
+
+void AddBox(double left, double top, double right, double bottom) {
+    AddWall(left, top, right, top);
+    AddWall(right, top, right, bottom);
+    AddWall(right, bottom, left, bottom);
+    AddWall(left, bottom, left, top);
+}
+
+
+
+//------------------------------------------------------------------------------
+// Styles
+//------------------------------------------------------------------------------
+
+// A perfect maze on a side x side grid has (side - 1)² + 4 walls.
+void GenMaze(int numwalls) {
+    int side = MAX(2, (int)round(sqrt(MAX(numwalls - 4, 1))) + 1);
+    int cells = side * side;
+
+    // Walls to the right and below every cell, all standing at first.
+    char *right = malloc(cells), *below = malloc(cells), *visited = calloc(cells, 1);
+    int *stack = malloc(sizeof(int) * cells);
+    check_mem(right && below && visited && stack);
+    memset(right, 1, cells);
+    memset(below, 1, cells);
+
+    // Randomized depth first search, knocking walls down along the way.
+    int top = 0;
+    stack[top++] = 0;
+    visited[0] = 1;
+
+    while (top) {
+        int c = stack[top - 1];
+        int x = c % side, y = c / side;
+
+        int next[4], numnext = 0;
+        if (x > 0 && !visited[c - 1]) next[numnext++] = c - 1;
+        if (x < side - 1 && !visited[c + 1]) next[numnext++] = c + 1;
+        if (y > 0 && !visited[c - side]) next[numnext++] = c - side;
+        if (y < side - 1 && !visited[c + side]) next[numnext++] = c + side;
+
+        if (!numnext) {
+            top--;
+            continue;
+        }
+
+        int n = next[Random() % numnext];
+        if (n == c + 1) right[c] = 0;
+        if (n == c - 1) right[n] = 0;
+        if (n == c + side) below[c] = 0;
+        if (n == c - side) below[n] = 0;
+
+        visited[n] = 1;
+        stack[top++] = n;
+    }
+
+    double size = side * MAZECELL;
+    AddBox(0, 0, size, size);
+
+    for (int c = 0; c < cells; c++) {
+        double x = (c % side) * MAZECELL, y = (c / side) * MAZECELL;
+
+        // The outer box has the last ones
+        if (right[c] && c % side < side - 1) {
+            AddWall(x + MAZECELL, y, x + MAZECELL, y + MAZECELL);
+        }
+        if (below[c] && c / side < side - 1) {
+            AddWall(x, y + MAZECELL, x + MAZECELL, y + MAZECELL);
+        }
+    }
+
+    free(right);
+    free(below);
+    free(visited);
+    free(stack);
+}
+
+
+// Four walls per pillar, in a square room.
+void GenArena(int numwalls) {
+    int pillars = MAX(1, (numwalls - 4) / 4);
+    int side = ceil(sqrt(pillars));
+    double size = MARGIN + side * PILLARGAP;
+
+    AddBox(0, 0, size, size);
+
+    for (int i = 0; i < pillars; i++) {
+        // Off the grid a little, so not everything lines up.
+        double left = MARGIN + (i % side) * PILLARGAP + Random() % (PILLARGAP - PILLAR);
+        double top = MARGIN + (i / side) * PILLARGAP + Random() % (PILLARGAP - PILLAR);
+        AddBox(left, top, left + PILLAR, top + PILLAR);
+    }
+}
+
+
+// Four walls per building, LOTS² buildings per block.
+void GenCity(int numwalls) {
+    int buildings = MAX(1, (numwalls - 4) / 4);
+    int blocks = ceil(sqrt((double)buildings / (LOTS * LOTS)));
+    double blocksize = LOTS * LOT + STREET;
+    double size = MARGIN + blocks * blocksize;
+
+    AddBox(0, 0, size, size);
+
+    for (int i = 0; i < buildings; i++) {
+        int block = i / (LOTS * LOTS), lot = i % (LOTS * LOTS);
+        double left = MARGIN + (block % blocks) * blocksize + (lot % LOTS) * LOT;
+        double top = MARGIN + (block / blocks) * blocksize + (lot / LOTS) * LOT;
+
+        // Buildings fill most of their lot, leaving alleys.
+        double w = LOT / 2 + Random() % (LOT / 2 - 4);
+        double h = LOT / 2 + Random() % (LOT / 2 - 4);
+        AddBox(left, top, left + w, top + h);
+    }
+}
+
+
+
+int main(int argc, char **argv) {
+    const char *style = "maze";
+    const char *path = NULL;
+    const char *worldpath = NULL;
+    int numwalls = WALLS;
+    double tilesize = TILESIZE;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--style") && i + 1 < argc) {
+            style = argv[++i];
+        } else if (!strcmp(argv[i], "--walls") && i + 1 < argc) {
+            numwalls = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10) * 0x9E3779B97F4A7C15ULL + 1;
+        } else if (!strcmp(argv[i], "--world") && i + 1 < argc) {
+            worldpath = argv[++i];
+        } else if (!strcmp(argv[i], "--tilesize") && i + 1 < argc) {
+            tilesize = atof(argv[++i]);
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+
+    if (!path) {
+        fprintf(stderr, "Usage: %s [--style maze|arena|city] [--walls n] "
+                "[--seed n] [--world path [--tilesize n]] map\n", argv[0]);
+        return 1;
+    }
+
+    if (!strcmp(style, "maze")) {
+        GenMaze(numwalls);
+    } else if (!strcmp(style, "arena")) {
+        GenArena(numwalls);
+    } else if (!strcmp(style, "city")) {
+        GenCity(numwalls);
+    } else {
+        fprintf(stderr, "Unknown style %s\n", style);
+        return 1;
+    }
+
+    log_info("Generated %s map with %d walls", style, map.numwalls);
+
+    M_Save(&map, path);
+
+    int ok = 1;
+    if (worldpath) {
+        ok = W_Build(&map, tilesize, worldpath);
+    }
+
+    free(map.walls);
+
+    return !ok;
+}
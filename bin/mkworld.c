@@ -0,0 +1,30 @@
+// Converts a map to a streamed world.
+//
+//   mkworld level.map level.world [tilesize]
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dbg.h"
+#include "map.h"
+#include "world.h"
+
+#define TILESIZE 512
+
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s map world [tilesize]\n", argv[0]);
+        return 1;
+    }
+
+    double tilesize = argc > 3 ? atof(argv[3]) : TILESIZE;
+
+    Map *map = M_Load(argv[1], NULL);
+    check(map, "Can't load %s", argv[1]);
+    if (!map) return 1;
+
+    int ok = W_Build(map, tilesize, argv[2]);
+    M_Delete(map);
+
+    return !ok;
+}
@@ -0,0 +1,285 @@
+// Dedicated multiplayer server.
+//
+//   server [--port n] [--bots n] [--ticks n] [--metrics port] [map]
+//
+// Runs the game for every client connected on localhost, reading the movement
+// settings from the engine's configuration so client predictions agree.
+//
+// --bots connects that many simulated clients, driven from another thread,
+// to measure the cost of a tick and the bandwidth used per client. --ticks
+// stops the server after that many ticks and prints a summary. --metrics
+// serves the tick times and bandwidth used for scraping, see metrics.h.
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dbg.h"
+#include "defs.h"
+#include "geometry.h"
+#include "map.h"
+#include "metrics.h"
+#include "net.h"
+#include "player.h"
+
+#define CONFIG "engine.cfg"
+#define BOTTURN 30      // Ticks a bot keeps pressing the same keys
+
+//------------------------------------------------------------------------------
+// Settings
+//------------------------------------------------------------------------------
+
+// Read from CONFIG, like the engine does. These are the defaults.
+int tickrate = 60;
+double radius;
+Movement movement;
+
+
+
+//------------------------------------------------------------------------------
+// Bots
+//------------------------------------------------------------------------------
+
+typedef struct Bot {
+    NetClient *client;
+    Mobile mob;         // Predicted
+    Tick tick;          // Keys being pressed
+    unsigned seed;
+} Bot;
+
+Bot *bots;
+int numbots;
+volatile int botsdone;
+pthread_t botthread;
+
+Map *map;
+double ticktime;    // ms
+
+Metrics metrics;
+Metric *tickcount;      // Ticks run
+Metric *ticktimes;      // Time taken by every tick, in us
+Metric *clientcount;    // Clients connected
+Metric *sentbytes;      // Bytes sent to and received from every client
+Metric *receivedbytes;
+Metric *botinputs;      // Inputs sent by the bots, from their thread
+
+
+// Current time in ms.
+double Now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+
+// Sleeps until time, in ms.
+void SleepUntil(double time) {
+    double left = time - Now();
+    if (left > 0) usleep(left * 1000);
+}
+
+
+// Plays every bot at the tick rate, like so many engines would.
+void *RunBots(void *arg) {
+    double next = Now();
+
+    for (int tick = 0; !botsdone; tick++) {
+        for (int i = 0; i < numbots; i++) {
+            Bot *b = &bots[i];
+
+            if (tick % BOTTURN == 0) {
+                b->tick = (Tick){
+                    .forward = rand_r(&b->seed) % 3 - 1,
+                    .strafe = rand_r(&b->seed) % 3 - 1,
+                    .turn = rand_r(&b->seed) % 3 - 1,
+                };
+            }
+
+            Nt_SendInput(b->client, b->tick);
+            Mt_Add(botinputs, 1);
+            Nt_ReceiveSnapshots(b->client);
+            Nt_Predict(b->client, map, &movement, &b->mob);
+        }
+
+        next += ticktime;
+        SleepUntil(next);
+    }
+
+    return NULL;
+}
+
+
+// Creates the metrics, and serves them on port unless it's 0.
+void InitMetrics(int port) {
+    Mt_Init(&metrics);
+
+    tickcount = Mt_Counter(&metrics, "server_ticks_total", "Ticks run");
+    ticktimes = Mt_Histogram(&metrics, "server_tick_seconds",
+            "Time to receive inputs and send snapshots", 1e-6);
+    clientcount = Mt_Gauge(&metrics, "server_clients", "Clients connected", 1);
+    sentbytes = Mt_Counter(&metrics, "server_sent_bytes_total",
+            "Bytes sent to clients");
+    receivedbytes = Mt_Counter(&metrics, "server_received_bytes_total",
+            "Bytes received from clients");
+    botinputs = Mt_Counter(&metrics, "server_bot_inputs_total",
+            "Inputs sent by simulated clients");
+
+    if (port && Mt_Serve(&metrics, port)) {
+        log_info("Serving metrics on port %d", port);
+    }
+}
+
+
+void StartBots(int n, int port) {
+    numbots = n;
+    bots = calloc(n, sizeof(Bot));
+    check_mem(bots);
+
+    for (int i = 0; i < n; i++) {
+        bots[i].client = Nt_Connect("127.0.0.1", port);
+        if (!bots[i].client) exit(1);
+        bots[i].seed = i + 1;
+    }
+
+    pthread_create(&botthread, NULL, RunBots, NULL);
+}
+
+
+void StopBots() {
+    if (!numbots) return;
+
+    botsdone = 1;
+    pthread_join(botthread, NULL);
+
+    int mispredictions = 0;
+    for (int i = 0; i < numbots; i++) {
+        mispredictions += bots[i].client->mispredictions;
+        Nt_Disconnect(bots[i].client);
+    }
+    printf("Bots: %d mispredicted snapshots\n", mispredictions);
+
+    free(bots);
+}
+
+
+
+int main(int argc, char **argv) {
+    const char *path = "level.map";
+    int port = NETPORT;
+    int nbots = 0;
+    int numticks = 0;
+    int metricsport = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--port") && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--bots") && i + 1 < argc) {
+            nbots = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--ticks") && i + 1 < argc) {
+            numticks = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--metrics") && i + 1 < argc) {
+            metricsport = atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [--port n] [--bots n] [--ticks n] "
+                    "[--metrics port] [map]\n", argv[0]);
+            return 1;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    movement = p_defaultmovement;
+    radius = p_defaultradius;
+    if (P_LoadSettings(CONFIG, &movement, &radius, &tickrate)) {
+        log_info("Settings read from %s", CONFIG);
+    }
+    ticktime = 1000.0 / tickrate;
+
+    map = M_Load(path, NULL);
+    check(map, "Can't load %s", path);
+    if (!map) return 1;
+
+    // Where the engine puts the player too
+    Mobile spawn = {
+        .pos = (Vector){25, 25},
+        .vel = (Vector){0, 0},
+        .forward = G_Normalize((Vector){1, 1}),
+        .radius = radius,
+    };
+
+    NetServer *s = Nt_Listen(port, map, &movement, spawn);
+    if (!s) return 1;
+    log_info("Serving %s on port %d", path, port);
+
+    InitMetrics(metricsport);
+    StartBots(nbots, port);
+
+    // Totals, and since the last report
+    double cost = 0, worst = 0, total = 0, totalworst = 0;
+    uint64_t sent = 0, received = 0;
+
+    double start = Now();
+    double next = start;
+    int tick;
+    for (tick = 1; !numticks || tick <= numticks; tick++) {
+        uint64_t sentbefore = s->sent, receivedbefore = s->received;
+
+        double t = Now();
+        Nt_Receive(s);
+        Nt_SendSnapshots(s);
+        t = Now() - t;
+
+        Mt_Add(tickcount, 1);
+        Mt_Observe(ticktimes, t * 1000);
+        Mt_Set(clientcount, s->numpeers);
+        Mt_Add(sentbytes, s->sent - sentbefore);
+        Mt_Add(receivedbytes, s->received - receivedbefore);
+
+        cost += t;
+        worst = MAX(worst, t);
+
+        // Once a second
+        if (tick % tickrate == 0) {
+            int n = MAX(s->numpeers, 1);
+            log_info("%3d clients, tick %6.3f ms (worst %6.3f), "
+                    "%6.2f KB/s down %6.2f KB/s up per client",
+                    s->numpeers, cost / tickrate, worst,
+                    (s->sent - sent) / 1024.0 / n,
+                    (s->received - received) / 1024.0 / n);
+
+            total += cost;
+            totalworst = MAX(totalworst, worst);
+            cost = worst = 0;
+            sent = s->sent;
+            received = s->received;
+        }
+
+        next += ticktime;
+        SleepUntil(next);
+    }
+
+    StopBots();
+
+    if (numticks) {
+        tick--;
+        total += cost;
+        totalworst = MAX(totalworst, worst);
+
+        double seconds = (Now() - start) / 1000;
+        int n = MAX(nbots, 1);
+        printf("Ran %d ticks in %.1f s\n", tick, seconds);
+        printf("Tick cost: %.3f ms average, %.3f ms worst\n", total / tick,
+                totalworst);
+        printf("Per client: %.2f KB/s down, %.2f KB/s up\n",
+                s->sent / 1024.0 / seconds / n,
+                s->received / 1024.0 / seconds / n);
+    }
+
+    Mt_Free(&metrics);
+    Nt_CloseServer(s);
+    M_Delete(map);
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+// Simulation only server, for load testing.
+//
+//   simserver [--bots n] [--ticks n] [--rate n] [--threads n] [--seed n] [map]
+//
+// Moves n bots around map, with no window or network, as fast as possible or
+// at --rate ticks per second, and reports the ticks per second reached. Runs
+// until interrupted unless --ticks is given. --threads 1 keeps everything on
+// one thread, 0 uses one per CPU. The players move as set in engine.cfg, like
+// in the engine and the server.
+//
+// Links against libsim.a only: no SDL.
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dbg.h"
+#include "defs.h"
+#include "geometry.h"
+#include "jobs.h"
+#include "map.h"
+#include "player.h"
+#include "sim.h"
+
+#define BOTS 1000
+#define MINTHINK 10         // Ticks a bot keeps its mind made up, at least...
+#define MAXTHINK 60         // ... and at most
+
+#define CONFIG "engine.cfg"
+
+// Read from CONFIG, like the engine does
+Movement movement;
+double radius;
+
+// What a bot has in mind.
+typedef struct Brain {
+    int left;           // Ticks until it thinks again
+    unsigned seed;
+} Brain;
+
+volatile sig_atomic_t done;
+
+
+// Current time in ms.
+double Now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+
+void Stop(int sig) {
+    done = 1;
+}
+
+
+// Picks the keys a bot presses: wander around, and turn away from walls when
+// stuck against them.
+Tick Think(Brain *b, Mobile *mob, Tick t) {
+    int stuck = t.forward && G_Length(mob->vel) < movement.accel / 2;
+
+    if (--b->left > 0 && !stuck) return t;
+
+    b->left = MINTHINK + rand_r(&b->seed) % (MAXTHINK - MINTHINK);
+
+    return (Tick){
+        .forward = rand_r(&b->seed) % 4 ? 1 : -1,
+        .strafe = rand_r(&b->seed) % 3 - 1,
+        .turn = stuck ? 1 : rand_r(&b->seed) % 3 - 1,
+    };
+}
+
+
+int main(int argc, char **argv) {
+    const char *path = "level.map";
+    int numbots = BOTS;
+    long numticks = 0;
+    int rate = 0;
+    int threads = 0;
+    unsigned seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--bots") && i + 1 < argc) {
+            numbots = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--ticks") && i + 1 < argc) {
+            numticks = atol(argv[++i]);
+        } else if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+            rate = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [--bots n] [--ticks n] [--rate n] "
+                    "[--threads n] [--seed n] [map]\n", argv[0]);
+            return 1;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    movement = p_defaultmovement;
+    radius = p_defaultradius;
+    if (P_LoadSettings(CONFIG, &movement, &radius, NULL)) {
+        log_info("Settings read from %s", CONFIG);
+    }
+
+    Map *map = M_Load(path, NULL);
+    check(map, "Can't load %s", path);
+    if (!map) return 1;
+
+    JobPool pool;
+    JobPool *p = NULL;
+    if (threads != 1) {
+        J_Init(&pool, threads);
+        p = &pool;
+    }
+
+    // Where the engine puts the player too
+    Mobile spawn = {
+        .pos = (Vector){25, 25},
+        .forward = G_Normalize((Vector){1, 1}),
+        .radius = radius,
+    };
+
+    Sim sim;
+    Sm_Init(&sim, map, &movement, numbots, spawn, p, NULL);
+
+    Brain *brains = calloc(numbots, sizeof(Brain));
+    check_mem(brains);
+    for (int i = 0; i < numbots; i++) {
+        brains[i].seed = seed * 7919 + i;
+    }
+
+    log_info("%d bots on %s (%d walls), %d chunks", numbots, path,
+            map->numwalls, sim.numchunks);
+
+    signal(SIGINT, Stop);
+
+    double start = Now();
+    double report = start;
+    double next = start;
+    uint64_t reported = 0;
+
+    while (!done && (!numticks || sim.steps < numticks)) {
+        for (int i = 0; i < numbots; i++) {
+            sim.ticks[i] = Think(&brains[i], &sim.mobs[i], sim.ticks[i]);
+        }
+
+        Sm_Step(&sim);
+
+        double now = Now();
+        if (now - report >= 1000) {
+            double tps = (sim.steps - reported) * 1000 / (now - report);
+            log_info("%8.0f ticks/s, %7.3f ms per tick", tps, 1000 / tps);
+            report = now;
+            reported = sim.steps;
+        }
+
+        if (rate) {
+            next += 1000.0 / rate;
+            double left = next - Now();
+            if (left > 0) usleep(left * 1000);
+        }
+    }
+
+    double elapsed = (Now() - start) / 1000;
+    printf("Ran %lu ticks of %d bots in %.2f s\n", (unsigned long)sim.steps,
+            numbots, elapsed);
+    printf("%.0f ticks/s, %.0f bot moves/s\n", sim.steps / elapsed,
+            sim.steps * numbots / elapsed);
+    printf("State hash %016lx\n", (unsigned long)Sm_Hash(&sim));
+
+    free(brains);
+    Sm_Free(&sim);
+    if (p) J_Quit(p);
+    M_Delete(map);
+
+    return 0;
+}
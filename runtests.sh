@@ -2,6 +2,6 @@
 
 set -e
 
-for t in tests/*_test; do
+for t in tests/*_test tests/*_asan; do
     ./$t
 done
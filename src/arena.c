@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "dbg.h"
+#include "defs.h"
+
+#define ALIGNMENT 16
+#define ALIGN(n) (((n) + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1))
+
+// Blocks are followed by their memory.
+#define BLOCKDATA(b) ((uint8_t *)(b) + ALIGN(sizeof(ArenaBlock)))
+
+
+static ArenaBlock *CreateBlock(size_t size) {
+    ArenaBlock *b = malloc(ALIGN(sizeof(ArenaBlock)) + size);
+    check_mem(b);
+    if (!b) return NULL;
+
+    b->next = NULL;
+    b->size = size;
+    b->used = 0;
+
+    return b;
+}
+
+
+static void FreeBlocks(ArenaBlock *b) {
+    while (b) {
+        ArenaBlock *next = b->next;
+        free(b);
+        b = next;
+    }
+}
+
+
+void A_Init(Arena *a, size_t blocksize) {
+    a->first = a->current = NULL;
+    a->blocksize = blocksize;
+    a->used = 0;
+    a->highwater = 0;
+    a->shared = 0;
+}
+
+
+void A_Share(Arena *a) {
+    if (a->shared) return;
+
+    pthread_mutex_init(&a->lock, NULL);
+    a->shared = 1;
+}
+
+
+void *A_Alloc(Arena *a, size_t size) {
+    if (!a) {
+        void *p = malloc(size);
+        check_mem(p);
+        return p;
+    }
+
+    size = ALIGN(size);
+
+    if (a->shared) pthread_mutex_lock(&a->lock);
+
+    // current is always the last block.
+    ArenaBlock *b = a->current;
+    if (!b || b->used + size > b->size) {
+        ArenaBlock *new = CreateBlock(MAX(size, a->blocksize));
+        if (!new) {
+            if (a->shared) pthread_mutex_unlock(&a->lock);
+            return NULL;
+        }
+
+        if (b) {
+            b->next = new;
+        } else {
+            a->first = new;
+        }
+        b = a->current = new;
+    }
+
+    void *p = BLOCKDATA(b) + b->used;
+    b->used += size;
+
+    a->used += size;
+    a->highwater = MAX(a->highwater, a->used);
+
+    if (a->shared) pthread_mutex_unlock(&a->lock);
+
+    return p;
+}
+
+
+void A_Reset(Arena *a) {
+    // Replace a chain of blocks with a single one big enough for all of them,
+    // so the next time around doesn't need to grow.
+    if (a->first && a->first->next) {
+        FreeBlocks(a->first);
+        a->first = CreateBlock(MAX(ALIGN(a->highwater), a->blocksize));
+    }
+
+    if (a->first) {
+        a->first->used = 0;
+    }
+
+    a->current = a->first;
+    a->used = 0;
+}
+
+
+void A_Free(Arena *a) {
+    FreeBlocks(a->first);
+
+    if (a->shared) pthread_mutex_destroy(&a->lock);
+    A_Init(a, a->blocksize);
+}
@@ -0,0 +1,46 @@
+//------------------------------------------------------------------------------
+// Arenas are linear allocators: allocating is bumping a pointer, and
+// everything allocated from an arena is freed at once.
+//------------------------------------------------------------------------------
+#ifndef _ARENA_
+#define _ARENA_
+
+#include <pthread.h>
+#include <stddef.h>
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size, used;
+} ArenaBlock;
+
+typedef struct Arena {
+    ArenaBlock *first, *current;
+    size_t blocksize;
+
+    size_t used;        // Bytes allocated since the last reset
+    size_t highwater;   // Maximum value of used
+
+    int shared;             // Whether several threads allocate from it...
+    pthread_mutex_t lock;   // ... taking turns with this
+} Arena;
+
+
+// Initializes an empty arena that grows blocksize bytes at a time.
+void A_Init(Arena *a, size_t blocksize);
+
+// Lets several threads allocate from a at once. Resetting or freeing it
+// still has to wait until they are done.
+void A_Share(Arena *a);
+
+// Returns size bytes from the arena, aligned to 16 bytes, or NULL if out of
+// memory. If a is NULL, uses malloc instead.
+void *A_Alloc(Arena *a, size_t size);
+
+// Frees everything allocated from the arena.
+// Keeps enough memory to hold the high-water mark in a single block.
+void A_Reset(Arena *a);
+
+// Frees everything allocated from the arena and its memory.
+void A_Free(Arena *a);
+
+#endif
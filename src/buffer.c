@@ -1,16 +1,28 @@
+#include <math.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <sys/mman.h>
 
+#include "arena.h"
 #include "buffer.h"
 #include "color.h"
+#include "defs.h"
+#include "pixops.h"
+#include "stats.h"
 
-Buffer *B_CreateBuffer(int width, int height) {
-    Buffer *b = malloc(sizeof(Buffer));
+Buffer *B_CreateBuffer(int width, int height, Arena *arena) {
+    Buffer *b = A_Alloc(arena, sizeof(Buffer));
 
     b->width = width;
     b->height = height;
-
-    b->pixels = malloc(sizeof(uint32_t) * width * height);
+    b->pitch = width;
+    b->parent = NULL;
+    b->arena = arena;
+    b->map = NULL;
+    b->mapsize = 0;
+    b->dirty = NULL;
+
+    b->pixels = A_Alloc(arena, sizeof(uint32_t) * width * height);
     memset(b->pixels, 0, sizeof(uint32_t) * width * height);
 
     return b;
@@ -18,28 +30,43 @@ Buffer *B_CreateBuffer(int width, int height) {
 
 
 void B_ClearBuffer(Buffer *b, uint32_t color) {
-    for (int i = 0; i < b->width * b->height; i++) {
-        b->pixels[i] = color;
-    }
-}
+    B_MarkAllDirty(b);
+    STAT(ST_PIXELS, b->width * b->height);
 
+    if (b->pitch == b->width) {
+        PX_Fill(b->pixels, color, b->width * b->height);
+        return;
+    }
 
-uint32_t B_GetPixel(Buffer *b, int x, int y) {
-    return b->pixels[y * b->width + x];
+    for (int j = 0; j < b->height; j++) {
+        PX_Fill(&b->pixels[j * b->pitch], color, b->width);
+    }
 }
 
 
-Buffer *B_GetSubBuffer(Buffer *buf, int x, int y, int width, int height) {
+Buffer B_View(Buffer *buf, int x, int y, int width, int height) {
     assert(x + width <= buf->width);
     assert(y + height <= buf->height);
 
-    Buffer *b = B_CreateBuffer(width, height);
+    return (Buffer){
+        .width = width,
+        .height = height,
+        .pitch = buf->pitch,
+        .pixels = &buf->pixels[y * buf->pitch + x],
+        .parent = buf->parent ? buf->parent : buf,
+        .arena = buf->arena,
+        .map = NULL,
+        .mapsize = 0,
+        .dirty = NULL,
+    };
+}
 
-    for (int j = 0; j < height; j++) {
-        for (int i = 0; i < width; i++) {
-            B_SetPixel(b, i, j, B_GetPixel(buf, x + i, y + j));
-        }
-    }
+
+Buffer *B_GetSubBuffer(Buffer *buf, int x, int y, int width, int height, Arena *arena) {
+    Buffer *b = A_Alloc(arena, sizeof(Buffer));
+
+    *b = B_View(buf, x, y, width, height);
+    b->arena = arena;
 
     return b;
 }
@@ -49,18 +76,101 @@ void B_BlitBuffer(Buffer *dest, Buffer *src, int x, int y) {
     assert(x + src->width <= dest->width);
     assert(y + src->height <= dest->height);
 
+    B_MarkDirty(dest, (Box){ y, y + src->height - 1, x, x + src->width - 1 });
+    STAT(ST_PIXELS, src->width * src->height);
+
     for (int j = 0; j < src->height; j++) {
-        for (int i = 0; i < src->width; i++) {
-            uint32_t src_pixel = B_GetPixel(src, i, j);
-            if (src_pixel != TRANSPARENT) {
-                B_SetPixel(dest, i + x, j + y, src_pixel);
-            }
+        PX_CopyKey(
+                &dest->pixels[(j + y) * dest->pitch + x],
+                &src->pixels[j * src->pitch],
+                src->width,
+                TRANSPARENT);
+    }
+}
+
+
+void B_TrackDirty(Buffer *b) {
+    if (!b->dirty) {
+        b->dirty = A_Alloc(b->arena, sizeof(DirtyList));
+    }
+
+    b->dirty->count = 0;
+    B_MarkAllDirty(b);
+}
+
+
+static int Overlap(Box a, Box b) {
+    return a.left <= b.right + 1 && b.left <= a.right + 1 &&
+        a.top <= b.bottom + 1 && b.top <= a.bottom + 1;
+}
+
+
+static Box Union(Box a, Box b) {
+    return (Box){
+        .top = MIN(a.top, b.top),
+        .bottom = MAX(a.bottom, b.bottom),
+        .left = MIN(a.left, b.left),
+        .right = MAX(a.right, b.right),
+    };
+}
+
+
+void B_MarkDirty(Buffer *b, Box box) {
+    DirtyList *d = b->dirty;
+    if (!d) return;
+
+    box.top = MAX(floor(box.top), 0);
+    box.left = MAX(floor(box.left), 0);
+    box.bottom = MIN(ceil(box.bottom), b->height - 1);
+    box.right = MIN(ceil(box.right), b->width - 1);
+    if (box.top > box.bottom || box.left > box.right) return;
+
+    // Touching rectangles are merged, so drawing a few things close together
+    // doesn't fill the list.
+    for (int i = 0; i < d->count; i++) {
+        if (Overlap(d->rects[i], box)) {
+            box = Union(d->rects[i], box);
+            d->rects[i] = d->rects[--d->count];
+            i = -1;  // The union may touch rectangles already checked.
         }
     }
+
+    // Out of room, merge everything into one.
+    if (d->count == MAXDIRTY) {
+        for (int i = 0; i < d->count; i++) {
+            box = Union(d->rects[i], box);
+        }
+        d->count = 0;
+    }
+
+    d->rects[d->count++] = box;
+}
+
+
+void B_MarkAllDirty(Buffer *b) {
+    if (!b->dirty) return;
+
+    b->dirty->rects[0] = (Box){ 0, b->height - 1, 0, b->width - 1 };
+    b->dirty->count = 1;
+}
+
+
+void B_ClearDirty(Buffer *b) {
+    if (!b->dirty) return;
+
+    b->dirty->count = 0;
 }
 
 
 void B_DeleteBuffer(Buffer *buf) {
-    free(buf->pixels);
+    if (buf->arena) return;
+
+    free(buf->dirty);
+
+    if (buf->map) {
+        munmap(buf->map, buf->mapsize);
+    } else if (!buf->parent) {
+        free(buf->pixels);
+    }
     free(buf);
 }
@@ -1,34 +1,78 @@
 //------------------------------------------------------------------------------
 // Buffers are rectangular arrays of pixels.
+//
+// A Buffer can be a view into a rectangle of another Buffer, sharing its
+// pixels. Rows are then pitch pixels apart instead of width.
+//
+// Buffers can also keep track of the rectangles changed since their dirty
+// list was last cleared, so only those have to be redrawn or uploaded.
 //------------------------------------------------------------------------------
 #ifndef _BUFFER_
 #define _BUFFER_
 
+#include "arena.h"
 #include "dbg.h"
 #include "color.h"
+#include "geometry.h"
+#include "stats.h"
+
+#define MAXDIRTY 32
+
+// Rectangles in pixel coordinates, borders included.
+typedef struct DirtyList {
+    Box rects[MAXDIRTY];
+    int count;
+} DirtyList;
 
 typedef struct Buffer {
     int width, height;
+    int pitch;                  // Pixels from the start of a row to the next
     uint32_t *pixels;
+
+    struct Buffer *parent;      // Buffer owning the pixels, NULL if this one
+    Arena *arena;               // Where the Buffer was allocated, NULL for the heap.
+    void *map;                  // File mapping the pixels are in, NULL if none...
+    size_t mapsize;             // ... and its size
+
+    DirtyList *dirty;           // Changed areas, NULL if not tracked
 } Buffer;
 
 
-// Returns a Buffer of the given width and height.
-Buffer *B_CreateBuffer(int width, int height);
+// Returns a Buffer of the given width and height, allocated from arena
+// (NULL for the heap).
+Buffer *B_CreateBuffer(int width, int height, Arena *arena);
 
-// Free a Buffer
+// Free a Buffer. Does nothing for Buffers allocated from an arena.
 void B_DeleteBuffer(Buffer *buf);
 
 // Fills a Buffer with color
 void B_ClearBuffer(Buffer *b, uint32_t color);
 
-// Returns a rectangular sub-buffer of buf starting at pixel (x,y) and with
-// the given width and height.
-Buffer *B_GetSubBuffer(Buffer *buf, int x, int y, int width, int height);
+// Returns a view of the rectangle of buf starting at pixel (x,y) and with
+// the given width and height. No pixels are copied: the view must not outlive
+// buf.
+Buffer B_View(Buffer *buf, int x, int y, int width, int height);
+
+// Like B_View(), but returns a view allocated from arena.
+Buffer *B_GetSubBuffer(Buffer *buf, int x, int y, int width, int height, Arena *arena);
 
 // Copies src to dest starting at (x,y) pixel of dest.
 void B_BlitBuffer(Buffer *dest, Buffer *src, int x, int y);
 
+// Starts tracking the areas of b that change. The whole of b starts dirty.
+void B_TrackDirty(Buffer *b);
+
+// Adds box to the dirty areas of b, if they are tracked.
+// The drawing functions mark what they draw, but B_SetPixel() doesn't: code
+// writing pixels directly must mark them itself.
+void B_MarkDirty(Buffer *b, Box box);
+
+// Marks the whole of b as dirty.
+void B_MarkAllDirty(Buffer *b);
+
+// Forgets the dirty areas of b.
+void B_ClearDirty(Buffer *b);
+
 // Sets pixel (x,y) of b to color.
 static inline void B_SetPixel(Buffer *b, int x, int y, uint32_t color) {
 #ifndef NDEBUG
@@ -37,10 +81,13 @@ static inline void B_SetPixel(Buffer *b, int x, int y, uint32_t color) {
     }
 #endif
 
-    b->pixels[y * b->width + x] = color;
+    b->pixels[y * b->pitch + x] = color;
+    STAT(ST_PIXELS, 1);
 }
 
 // Returns the color of pixel (x,y) of b.
-uint32_t B_GetPixel(Buffer *b, int x, int y);
+static inline uint32_t B_GetPixel(Buffer *b, int x, int y) {
+    return b->pixels[y * b->pitch + x];
+}
 
 #endif
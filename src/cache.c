@@ -0,0 +1,203 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "cache.h"
+#include "color.h"
+#include "dbg.h"
+
+#define CACHEMAGIC 0x58455443   // "CTEX"
+#define CACHEVERSION 2
+#define PIXELOFFSET 64          // Where the pixels start, aligned to a cache line
+
+typedef struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t layout;    // BUILDRGB(1, 2, 3), changes with the pixel layout
+    int32_t width, height;
+} CacheHeader;
+
+// Cached images are named <hash of the path>-<hash of the source>.tex
+#define NAMELENGTH (16 + 1 + 16 + 4)
+
+static const char *cachedir = ".cache";
+
+
+void AC_SetDir(const char *dir) {
+    cachedir = dir;
+}
+
+
+static uint64_t Hash(uint64_t hash, const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+// Stores in name the path of the cached version of the image in path, and in
+// prefix the part of it that only depends on path.
+// Returns 0 if path can't be read.
+static int CachePath(const char *path, char *name, size_t size, char prefix[18]) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    uint8_t *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return 0;
+
+    // FNV-1a of the contents, then the modification time.
+    uint64_t hash = Hash(14695981039346656037ULL, data, st.st_size);
+    munmap(data, st.st_size);
+
+    uint64_t mtime = st.st_mtime;
+    for (int i = 0; i < 8; i++) {
+        uint8_t byte = mtime >> (i * 8);
+        hash = Hash(hash, &byte, 1);
+    }
+
+    uint64_t pathhash = Hash(14695981039346656037ULL, (const uint8_t *)path, strlen(path));
+
+    snprintf(prefix, 18, "%016llx-", (unsigned long long)pathhash);
+    snprintf(name, size, "%s/%s%016llx.tex", cachedir, prefix, (unsigned long long)hash);
+
+    return 1;
+}
+
+
+// Removes the cached versions of older contents of a source, whose names
+// start with prefix, and files that aren't named like cached images at all,
+// left by older versions.
+static void Prune(const char *prefix, const char *keep) {
+    DIR *dir = opendir(cachedir);
+    if (!dir) return;
+
+    struct dirent *e;
+    while ((e = readdir(dir))) {
+        const char *name = e->d_name;
+        size_t len = strlen(name);
+        if (len < 4 || strcmp(name + len - 4, ".tex")) continue;
+
+        int old = len != NAMELENGTH || name[16] != '-';
+        if (old || (!strncmp(name, prefix, 17) && strcmp(name, keep))) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%s", cachedir, name);
+            remove(path);
+        }
+    }
+
+    closedir(dir);
+}
+
+
+Buffer *AC_Load(const char *path, Arena *arena) {
+    char name[512], prefix[18];
+    if (!CachePath(path, name, sizeof(name), prefix)) return NULL;
+
+    int fd = open(name, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < PIXELOFFSET) {
+        close(fd);
+        return NULL;
+    }
+
+    // Private and writable: the Buffer can be drawn on like any other, the
+    // pages written to are copied, and the file is left alone.
+    uint8_t *data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    CacheHeader h;
+    memcpy(&h, data, sizeof(h));
+
+    size_t pixels = (size_t)h.width * h.height * sizeof(uint32_t);
+
+    if (h.magic != CACHEMAGIC || h.version != CACHEVERSION ||
+            h.layout != BUILDRGB(1, 2, 3) || h.width <= 0 || h.height <= 0 ||
+            (size_t)st.st_size != PIXELOFFSET + pixels) {
+        debug("Ignoring bad cached image %s", name);
+        munmap(data, st.st_size);
+        return NULL;
+    }
+
+    // Arenas free their memory all at once, and couldn't unmap the file:
+    // Buffers allocated from one get a copy.
+    if (arena) {
+        Buffer *b = B_CreateBuffer(h.width, h.height, arena);
+        memcpy(b->pixels, data + PIXELOFFSET, pixels);
+        munmap(data, st.st_size);
+        return b;
+    }
+
+    Buffer *b = A_Alloc(NULL, sizeof(Buffer));
+    *b = (Buffer){
+        .width = h.width,
+        .height = h.height,
+        .pitch = h.width,
+        .pixels = (uint32_t *)(data + PIXELOFFSET),
+        .map = data,
+        .mapsize = st.st_size,
+    };
+
+    return b;
+}
+
+
+void AC_Store(const char *path, Buffer *buf) {
+    char name[512], prefix[18];
+    if (!CachePath(path, name, sizeof(name), prefix)) return;
+
+    mkdir(cachedir, 0755);
+
+    // Several threads can be loading images: write to a file of our own and
+    // rename it, so nobody reads a half written one.
+    char tmp[576];
+    snprintf(tmp, sizeof(tmp), "%s.%lx.tmp", name, (unsigned long)pthread_self());
+
+    FILE *f = fopen(tmp, "wb");
+    check(f, "Can't write cached image %s", tmp);
+    if (!f) return;
+
+    CacheHeader h = {
+        .magic = CACHEMAGIC,
+        .version = CACHEVERSION,
+        .layout = BUILDRGB(1, 2, 3),
+        .width = buf->width,
+        .height = buf->height,
+    };
+    uint8_t header[PIXELOFFSET] = {0};
+    memcpy(header, &h, sizeof(h));
+    fwrite(header, sizeof(header), 1, f);
+
+    for (int y = 0; y < buf->height; y++) {
+        fwrite(&buf->pixels[y * buf->pitch], sizeof(uint32_t), buf->width, f);
+    }
+
+    int ok = !ferror(f);
+    fclose(f);
+
+    if (ok) {
+        rename(tmp, name);
+        Prune(prefix, name + strlen(cachedir) + 1);
+    } else {
+        remove(tmp);
+    }
+}
@@ -0,0 +1,29 @@
+//------------------------------------------------------------------------------
+// Asset cache
+//
+// Keeps decoded images in a directory, already converted to the pixel layout
+// of the engine, so they don't have to be decoded again. Cached images are
+// named after a hash of the path of their source and one of its contents and
+// modification time, and read back with mmap. Storing an image removes what
+// was cached for older contents of its source.
+//------------------------------------------------------------------------------
+#ifndef _CACHE_
+#define _CACHE_
+
+#include "arena.h"
+#include "buffer.h"
+
+// Sets the directory the cached images are kept in. Defaults to ".cache".
+void AC_SetDir(const char *dir);
+
+// Returns the cached version of the image in path, allocated from arena.
+// Returns NULL if there's none or path changed since it was cached.
+//
+// Without an arena, the pixels aren't copied: the Buffer points into a
+// private mapping of the cached file, unmapped by B_DeleteBuffer().
+Buffer *AC_Load(const char *path, Arena *arena);
+
+// Caches buf as the decoded version of the image in path.
+void AC_Store(const char *path, Buffer *buf);
+
+#endif
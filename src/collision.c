@@ -1,4 +1,5 @@
 #include <float.h>
+#include <math.h>
 #include <stdio.h>
 #include <assert.h>
 
@@ -7,6 +8,7 @@
 #include "defs.h"
 #include "geometry.h"
 #include "map.h"
+#include "stats.h"
 
 // We need to do check every segment, and keep the earliest collision.
 //
@@ -57,34 +59,95 @@
 //
 //  and check if it's inside the segment.
 //
+//  The mobile has to be closing in on the line, v · n < 0 with n pointing to
+//  the side of O, or it can't hit it. If it's already touching the line,
+//  because of rounding, t0 is 0.
+//
 //
 //  # Collision against a vertex.
 //
-//      G_Distance(O, s.start) - R = t0 v · (s.start - O) / |s.start - O|
+//  With d = s.start - O, contact happens when the center is R away from the
+//  vertex:
+//
+//      |d - t0 v|² = R²
+//
+//  The first root of this quadratic is
+//
+//           d · v - sqrt((d · v)² - |v|² (|d|² - R²))
+//      t0 = -----------------------------------------
+//                             |v|²
+//
+//  which is computed as the equivalent
+//
+//                       |d|² - R²
+//      t0 = ---------------------------------------
+//           d · v + sqrt((d · v)² - |v|² (|d|² - R²))
 //
-//               G_Distance(O, s.start) - R
-//      t0 = -----------------------------------
-//           v · (s.start - O) / |(s.start - O)|
+//  so that nothing cancels out. Again, the mobile has to be closing in on the
+//  vertex, d · v > 0, and if the discriminant is negative it goes past it.
 
 
 // Checks if mob will hit p.
 // If so, returns 1 and stores the distance and time to collision,
 // returns 0 otherwise.
 int CheckPoint(Vector p, Mobile mob, double *distance, double *t0) {
-    double t = (G_Distance(mob.pos, p) - mob.radius) /
-        G_Dot(mob.vel, G_Normalize(G_Sub(p, mob.pos)));
+    Vector d = G_Sub(p, mob.pos);
+    double closing = G_Dot(d, mob.vel);
 
-    if (t >= 0 && t <= 1) {
-        if (distance) {
-            *distance = G_Distance(mob.pos, p);
-        }
-        if (t0) {
-            *t0 = t;
-        }
-        return 1;
-    } else {
-        return 0;
+    // Moving away from p, or not moving at all
+    if (closing <= 0) return 0;
+
+    double c = G_LengthSquared(d) - mob.radius * mob.radius;
+    double t = 0;
+
+    // Not touching it already
+    if (c > 0) {
+        double disc = closing * closing - G_LengthSquared(mob.vel) * c;
+        if (disc < 0) return 0;
+
+        t = c / (closing + sqrt(disc));
+    }
+
+    if (t > 1) return 0;
+
+    if (distance) {
+        *distance = G_Length(d);
+    }
+    if (t0) {
+        *t0 = t;
     }
+    return 1;
+}
+
+
+// Checks if mob will hit the interior of s.
+// If so, returns 1 and stores the point and time of collision,
+// returns 0 otherwise.
+int CheckSegment(Segment s, Mobile mob, Vector *point, double *t0) {
+    Line l = G_SupportLine(s);
+    Vector normal = G_Normal(l);
+    double lp = G_LinePointDistance(l, mob.pos);
+
+    // Make it point to our side of the line.
+    if (G_Side(l, mob.pos) < 0) {
+        normal = G_Scale(-1, normal);
+    }
+
+    // Moving away from the line, or along it
+    double closing = -G_Dot(mob.vel, normal);
+    if (closing <= 0) return 0;
+
+    double t = MAX(0, (lp - mob.radius) / closing);
+    if (t > 1) return 0;
+
+    // Where we touch the support line, and whether that's on the segment.
+    Vector center = G_Sum(mob.pos, G_Scale(t, mob.vel));
+    double u = G_Dot(G_Sub(center, s.start), l.dir) / G_LengthSquared(l.dir);
+    if (u < 0 || u > 1) return 0;
+
+    *point = G_Sum(s.start, G_Scale(u, l.dir));
+    *t0 = t;
+    return 1;
 }
 
 
@@ -93,6 +156,8 @@ int Co_CheckCollision(Map *map, Mobile mob, Collision *collision) {
 
     if (ISZERO(v)) return 0;
 
+    STAT(ST_COLLISIONTESTS, map->numwalls);
+
     int collisions = 0;
     Collision c = {
         .mob = mob,
@@ -102,69 +167,49 @@ int Co_CheckCollision(Map *map, Mobile mob, Collision *collision) {
     for (int i = 0; i < map->numwalls; i++) {
         Wall *w = &map->walls[i];
         Segment s = w->seg;
-        Line l = G_SupportLine(s);
-        Vector normal = G_Normal(l);
-        double lp = G_LinePointDistance(l, mob.pos);
 
         // Skip if we are too far away from the line.
-        if (lp > v + mob.radius) continue;
-
-        // Skip if we are moving parallel to the line.
-        if (G_Parallel(mob.vel, l.dir) && lp > mob.radius) continue;
-
-        // Check for collision against the interior of the wall.
-        double d, t = (lp - mob.radius) / fabs(G_Dot(mob.vel, normal));
-        if (t >= 0 && t <= 1) {
-            // We hit the support line.
-            Vector I = G_Sub(
-                    G_Sum(mob.pos, G_Scale(t, mob.vel)),
-                    G_Scale(G_Side(l, mob.pos) * mob.radius, normal)
-                    );
-
-            if (G_IsPointOnSegment(s, I)) {
-                // We hit the segment: we have a collision.
-                d = G_Distance(mob.pos, I);
-                if (t < c.t0) {
-                    collisions++;
-                    c.point = I;
-                    c.t0 = t;
-                    c.wall = w;
-                    c.distance = d;
-                }
-                continue;
-            }
+        if (G_LinePointDistance(G_SupportLine(s), mob.pos) > v + mob.radius) {
+            continue;
         }
 
-        // Check for collision against the start vertex.
-        if (CheckPoint(s.start, mob, &d, &t)) {
-            // We hit the start vertex.
+        // Check for collision against the interior of the wall: if we hit
+        // it, we can't hit the vertices any earlier.
+        Vector I;
+        double d, t;
+        if (CheckSegment(s, mob, &I, &t)) {
             if (t < c.t0) {
                 collisions++;
-                c.point = s.start;
+                c.point = I;
                 c.t0 = t;
                 c.wall = w;
-                c.distance = d;
+                c.distance = G_Distance(mob.pos, I);
             }
             continue;
         }
 
-        // Check for collision against the end vertex.
-        if (CheckPoint(s.end, mob, &d, &t)) {
-            // We hit the end vertex.
-            if (t < c.t0) {
-                collisions++;
-                c.point = s.end;
-                c.t0 = t;
-                c.wall = w;
-                c.distance = d;
-            }
-            continue;
+        // Check for collision against both vertices, the earliest first.
+        if (CheckPoint(s.start, mob, &d, &t) && t < c.t0) {
+            collisions++;
+            c.point = s.start;
+            c.t0 = t;
+            c.wall = w;
+            c.distance = d;
+        }
+
+        if (CheckPoint(s.end, mob, &d, &t) && t < c.t0) {
+            collisions++;
+            c.point = s.end;
+            c.t0 = t;
+            c.wall = w;
+            c.distance = d;
         }
     }
 
     if (collisions && collision) {
         *collision = c;
     }
+    STAT(ST_COLLISIONS, collisions > 0);
 
     return collisions;
 }
@@ -193,12 +238,20 @@ Mobile MoveOnce(Map *map, Mobile mob) {
 }
 
 
-#define DEPTH 3
-
 Mobile Co_Move(Map *map, Mobile mob) {
+    return Co_MoveTraced(map, mob, NULL);
+}
+
+
+Mobile Co_MoveTraced(Map *map, Mobile mob, Trace *trace) {
     Vector orig_vel = mob.vel;
 
-    for (int d = 0; d < DEPTH; d++) {
+    if (trace) {
+        trace->pos[0] = mob.pos;
+        trace->steps = 0;
+    }
+
+    for (int d = 0; d < CO_MAXSTEPS; d++) {
         if (ISZERO(G_Length(mob.vel))) return mob;
 
         // Return if the new velocity is against the original velocity.
@@ -211,6 +264,7 @@ Mobile Co_Move(Map *map, Mobile mob) {
         if (G_Dot(orig_vel, mob.vel) < 0) return mob;
 
         mob = MoveOnce(map, mob);
+        if (trace) trace->pos[++trace->steps] = mob.pos;
     }
 
     return mob;
@@ -26,10 +26,23 @@ typedef struct Collision {
 } Collision;
 
 
+// Most times Co_Move moves and slides along walls in a tick.
+#define CO_MAXSTEPS 3
+
+// Where a move went, step by step: from pos[0] to pos[1], and so on up to
+// pos[steps].
+typedef struct Trace {
+    Vector pos[CO_MAXSTEPS + 1];
+    int steps;
+} Trace;
+
 // Returns a Mobile representing the movement of mob in map after handling
 // collisions.
 Mobile Co_Move(Map *map, Mobile mob);
 
+// Like Co_Move, and stores every step it took in trace.
+Mobile Co_MoveTraced(Map *map, Mobile mob, Trace *trace);
+
 // Checks if mob will hit anything in map.
 //
 // Returns 1 and stores the collision info in collision if there's a collision.
@@ -0,0 +1,96 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "dbg.h"
+
+
+// Removes leading and trailing whitespace from s, in place.
+static char *Trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+
+    return s;
+}
+
+
+static CfVar *FindVar(CfVar *vars, int numvars, const char *name) {
+    for (int i = 0; i < numvars; i++) {
+        if (!strcmp(vars[i].name, name)) return &vars[i];
+    }
+
+    return NULL;
+}
+
+
+int Cf_Bind(CfVar *vars, int numvars, const char *name, void *value) {
+    CfVar *var = FindVar(vars, numvars, name);
+    if (!var) return 0;
+
+    var->value = value;
+    return 1;
+}
+
+
+int Cf_Load(const char *path, CfVar *vars, int numvars) {
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+
+    char line[256];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+
+        char *s = Trim(line);
+        if (!*s || *s == '#') continue;
+
+        char *eq = strchr(s, '=');
+        if (!eq) {
+            log_warn("%s:%d: Expected name = value", path, lineno);
+            continue;
+        }
+
+        *eq = '\0';
+        char *name = Trim(s);
+        char *value = Trim(eq + 1);
+
+        CfVar *var = FindVar(vars, numvars, name);
+        if (!var) {
+            log_warn("%s:%d: Unknown setting %s", path, lineno, name);
+            continue;
+        }
+        if (!var->value) continue;
+
+        char *end;
+        double v = strtod(value, &end);
+        if (end == value || *end) {
+            log_warn("%s:%d: Bad value for %s: %s", path, lineno, name, value);
+            continue;
+        }
+        if (!(v >= var->min && v <= var->max)) {
+            log_warn("%s:%d: %s must be between %g and %g, not %s", path, lineno,
+                    name, var->min, var->max, value);
+            continue;
+        }
+        if (var->type == CF_INT && v != (int)v) {
+            log_warn("%s:%d: %s must be a whole number, not %s", path, lineno,
+                    name, value);
+            continue;
+        }
+
+        if (var->type == CF_INT) {
+            *(int *)var->value = v;
+        } else {
+            *(double *)var->value = v;
+        }
+    }
+
+    fclose(f);
+
+    return 1;
+}
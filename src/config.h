@@ -0,0 +1,37 @@
+//------------------------------------------------------------------------------
+// Configuration files
+//
+// Lines of the form "name = value" set the variable called name. Blank lines
+// and lines starting with # are ignored. Every variable has a range of values
+// it accepts.
+//------------------------------------------------------------------------------
+#ifndef _CONFIG_
+#define _CONFIG_
+
+typedef enum CfType {
+    CF_INT,
+    CF_DOUBLE,
+} CfType;
+
+// A variable that can be set from a configuration file.
+typedef struct CfVar {
+    const char *name;
+    CfType type;
+    void *value;        // int * or double *, depending on type, or NULL to
+                        // accept the name and ignore it
+    double min, max;    // Values accepted, both included
+} CfVar;
+
+
+// Points the variable called name in vars at value. Returns 0 if there's no
+// such variable.
+int Cf_Bind(CfVar *vars, int numvars, const char *name, void *value);
+
+// Sets the variables named in the file in path. Variables not in the file
+// keep their value. Unknown names, and values that can't be read or are out of
+// range, are reported and skipped.
+//
+// Returns 0 if the file can't be read, 1 otherwise.
+int Cf_Load(const char *path, CfVar *vars, int numvars);
+
+#endif
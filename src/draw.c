@@ -9,11 +9,24 @@
 #include "system.h"
 #include "draw.h"
 #include "dbg.h"
+#include "rle.h"
 #include "color.h"
 
 
-// Doom's version of Bresenham
-void D_DrawLine(Buffer *b, int x0, int y0, int x1, int y1, uint32_t color) {
+static inline void Plot(Buffer *b, int x, int y, Box clip, uint32_t color) {
+    if (x >= clip.left && x <= clip.right && y >= clip.top && y <= clip.bottom) {
+        B_SetPixel(b, x, y, color);
+    }
+}
+
+
+// Doom's version of Bresenham, drawing only the pixels inside clip.
+static void ClippedLine(Buffer *b, int x0, int y0, int x1, int y1, Box clip, uint32_t color) {
+    B_MarkDirty(b, (Box){
+        MAX(MIN(y0, y1), clip.top), MIN(MAX(y0, y1), clip.bottom),
+        MAX(MIN(x0, x1), clip.left), MIN(MAX(x0, x1), clip.right)
+    });
+
     int dx = x1 - x0;
     int ax = 2 * abs(dx);
     int sx = dx < 0 ? -1 : 1;
@@ -28,7 +41,7 @@ void D_DrawLine(Buffer *b, int x0, int y0, int x1, int y1, uint32_t color) {
     if (ax > ay) {
         int d = ay - ax / 2;
         while (1) {
-            B_SetPixel(b, x, y, color);
+            Plot(b, x, y, clip, color);
             if (x == x1) return;
 
             if (d >= 0) {
@@ -41,7 +54,7 @@ void D_DrawLine(Buffer *b, int x0, int y0, int x1, int y1, uint32_t color) {
     } else {
         int d = ax - ay / 2;
         while (1) {
-            B_SetPixel(b, x, y, color);
+            Plot(b, x, y, clip, color);
             if (y == y1) return;
 
             if (d >= 0) {
@@ -55,8 +68,15 @@ void D_DrawLine(Buffer *b, int x0, int y0, int x1, int y1, uint32_t color) {
 }
 
 
+void D_DrawLine(Buffer *b, int x0, int y0, int x1, int y1, uint32_t color) {
+    ClippedLine(b, x0, y0, x1, y1, (Box){ 0, b->height - 1, 0, b->width - 1 }, color);
+}
+
+
 // https://en.wikipedia.org/wiki/Midpoint_circle_algorithm
 void D_DrawCircle(Buffer *b, int x0, int y0, int radius, uint32_t color) {
+    B_MarkDirty(b, (Box){ y0 - radius, y0 + radius, x0 - radius, x0 + radius });
+
     int x = radius;
     int y = 0;
     int decisionOver2 = 1 - x;  // Decision criterion divided by 2 evaluated at x=r, y=0
@@ -87,6 +107,16 @@ void D_DrawSegment(Buffer *b, Segment l, uint32_t color) {
 }
 
 
+void D_DrawSegmentIn(Buffer *b, Segment l, Box clip, uint32_t color) {
+    clip.top = MAX(clip.top, 0);
+    clip.bottom = MIN(clip.bottom, b->height - 1);
+    clip.left = MAX(clip.left, 0);
+    clip.right = MIN(clip.right, b->width - 1);
+
+    ClippedLine(b, l.start.x, l.start.y, l.end.x, l.end.y, clip, color);
+}
+
+
 void D_DrawBox(Buffer *buf, Box b, uint32_t color) {
     D_DrawLine(buf, b.left, b.top, b.right, b.top, color);
     D_DrawLine(buf, b.left, b.bottom, b.right, b.bottom, color);
@@ -95,24 +125,27 @@ void D_DrawBox(Buffer *buf, Box b, uint32_t color) {
 }
 
 
+void D_DrawString(Buffer *b, SpriteSheet ascii, int x, int y, const char *text, int len) {
+    for (int i = 0; i < len; i++) {
+        unsigned char c = text[i];
+
+        int xx = c % 16;
+        int yy = c / 16;
+
+        RL_Blit(b, SS_GetCompiledSprite(ascii, xx, yy), x + i * GLYPHWIDTH, y);
+    }
+}
+
+
 void
 D_DrawText(Buffer *b, SpriteSheet ascii, int x, int y, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
 
     char text[128] = "";
-    vsnprintf(text, 128, fmt, args);
+    int len = vsnprintf(text, 128, fmt, args);
 
     va_end(args);
 
-    for (int i = 0; i < strlen(text); i++) {
-        unsigned char c = text[i];
-
-        int xx = c % 16;
-        int yy = c / 16;
-
-        Buffer *bitmap = SS_GetSprite(ascii, xx, yy);
-
-        B_BlitBuffer(b, bitmap, x + i * 8, y);
-    }
+    D_DrawString(b, ascii, x, y, text, MIN(len, 127));
 }
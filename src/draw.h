@@ -9,10 +9,18 @@
 #include "sprites.h"
 #include "color.h"
 
+#define GLYPHWIDTH 8    // Horizontal advance of the characters of a font
+
 void D_DrawLine(Buffer *b, int x0, int y0, int x1, int y1, uint32_t color);
 void D_DrawCircle(Buffer *b, int x0, int y0, int radius, uint32_t color);
 void D_DrawSegment(Buffer *b, Segment l, uint32_t color);
+
+// Draws the pixels of l inside clip only. They're the same pixels drawing the
+// whole of l would, unlike drawing l clipped with G_ClipSegment().
+void D_DrawSegmentIn(Buffer *b, Segment l, Box clip, uint32_t color);
+
 void D_DrawBox(Buffer *buf, Box b, uint32_t color);
+void D_DrawString(Buffer *b, SpriteSheet ascii, int x, int y, const char *text, int len);
 void D_DrawText(Buffer *b, SpriteSheet ascii, int x, int y, const char *fmt, ...);
 
 #endif
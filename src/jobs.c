@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "dbg.h"
+#include "jobs.h"
+
+
+static double Now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+
+static void *Worker(void *arg) {
+    JobPool *p = arg;
+
+    pthread_mutex_lock(&p->lock);
+
+    while (1) {
+        while (!p->head && !p->quit) {
+            pthread_cond_wait(&p->work, &p->lock);
+        }
+
+        // Quitting, and nothing left to do.
+        if (!p->head) break;
+
+        Job *j = p->head;
+        p->head = j->next;
+        if (!p->head) p->tail = NULL;
+
+        pthread_mutex_unlock(&p->lock);
+
+        double start = Now();
+        j->waited = start - j->queued;
+        j->result = j->func(j->arg);
+        j->took = Now() - start;
+
+        pthread_mutex_lock(&p->lock);
+        j->done = 1;
+        pthread_cond_broadcast(&p->done);
+    }
+
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+
+void J_Init(JobPool *p, int numthreads) {
+    if (numthreads <= 0) {
+        numthreads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (numthreads <= 0) numthreads = 1;
+    }
+
+    p->numthreads = numthreads;
+    p->threads = malloc(sizeof(pthread_t) * numthreads);
+    check_mem(p->threads);
+
+    p->head = p->tail = NULL;
+    p->quit = 0;
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->work, NULL);
+    pthread_cond_init(&p->done, NULL);
+
+    for (int i = 0; i < numthreads; i++) {
+        pthread_create(&p->threads[i], NULL, Worker, p);
+    }
+}
+
+
+void J_Quit(JobPool *p) {
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->work);
+    pthread_mutex_unlock(&p->lock);
+
+    for (int i = 0; i < p->numthreads; i++) {
+        pthread_join(p->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->work);
+    pthread_cond_destroy(&p->done);
+
+    free(p->threads);
+    p->threads = NULL;
+    p->numthreads = 0;
+}
+
+
+void J_Submit(JobPool *p, Job *job, const char *name, JobFunc func, void *arg) {
+    *job = (Job){
+        .name = name,
+        .func = func,
+        .arg = arg,
+        .queued = Now(),
+        .pool = p,
+    };
+
+    pthread_mutex_lock(&p->lock);
+
+    if (p->tail) {
+        p->tail->next = job;
+    } else {
+        p->head = job;
+    }
+    p->tail = job;
+
+    pthread_cond_signal(&p->work);
+    pthread_mutex_unlock(&p->lock);
+}
+
+
+void *J_Wait(Job *job) {
+    JobPool *p = job->pool;
+
+    pthread_mutex_lock(&p->lock);
+    while (!job->done) {
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return job->result;
+}
+
+
+int J_Done(Job *job) {
+    JobPool *p = job->pool;
+
+    pthread_mutex_lock(&p->lock);
+    int done = job->done;
+    pthread_mutex_unlock(&p->lock);
+
+    return done;
+}
@@ -0,0 +1,58 @@
+//------------------------------------------------------------------------------
+// Job pool
+//
+// Runs functions on a fixed set of worker threads. Submitting a job returns
+// right away; the Job itself works as a handle to wait for its result.
+//------------------------------------------------------------------------------
+#ifndef _JOBS_
+#define _JOBS_
+
+#include <pthread.h>
+
+typedef void *(*JobFunc)(void *arg);
+
+typedef struct Job {
+    const char *name;   // For reporting
+    JobFunc func;
+    void *arg;
+    void *result;       // What func returned, once done
+
+    int done;
+    double queued;      // When it was submitted, in ms
+    double waited;      // Time spent in the queue, in ms
+    double took;        // Time spent running, in ms
+
+    struct JobPool *pool;
+    struct Job *next;   // Next job in the queue
+} Job;
+
+typedef struct JobPool {
+    pthread_t *threads;
+    int numthreads;
+
+    Job *head, *tail;   // Jobs not started yet
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;    // A job was queued, or it's time to quit
+    pthread_cond_t done;    // A job finished
+    int quit;
+} JobPool;
+
+
+// Starts numthreads workers, or one per CPU if numthreads is 0.
+void J_Init(JobPool *p, int numthreads);
+
+// Finishes the queued jobs and stops the workers.
+void J_Quit(JobPool *p);
+
+// Queues func(arg) to run on a worker. job must stay valid until J_Wait()
+// returns.
+void J_Submit(JobPool *p, Job *job, const char *name, JobFunc func, void *arg);
+
+// Blocks until job is done and returns its result.
+void *J_Wait(Job *job);
+
+// Returns 1 if job is done, 0 if it's queued or running. Never blocks.
+int J_Done(Job *job);
+
+#endif
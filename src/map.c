@@ -1,36 +1,426 @@
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 
+#include "arena.h"
 #include "map.h"
 #include "dbg.h"
+#include "defs.h"
 #include "geometry.h"
 
-Map *CreateEmptyMap() {
-    Map *map = malloc(sizeof(struct Map));
+Map *CreateEmptyMap(Arena *arena) {
+    Map *map = A_Alloc(arena, sizeof(struct Map));
 
     map->walls = NULL;
     map->numwalls = 0;
+    map->arena = arena;
 
     return map;
 }
 
 
-Map *M_Load(const char *path) {
+static void JournalPath(const char *path, char *journal, size_t size) {
+    snprintf(journal, size, "%s.journal", path);
+}
+
+
+#define FNVBASIS 14695981039346656037ULL
+#define FNVPRIME 1099511628211ULL
+
+// Hash of the last snapshot read or written, and what the file looked like
+// then. The editor checks the journal's base on every save, and hashing the
+// whole snapshot each time would cost more than the save itself.
+static struct {
+    char path[256];
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    uint64_t hash;
+} base;
+static pthread_mutex_t baselock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static int SameFile(const char *path, struct stat *st) {
+    return !strcmp(base.path, path) && base.dev == st->st_dev &&
+        base.ino == st->st_ino && base.size == st->st_size &&
+        base.mtime.tv_sec == st->st_mtim.tv_sec &&
+        base.mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+
+static void RememberHash(const char *path, struct stat *st, uint64_t hash) {
+    pthread_mutex_lock(&baselock);
+    snprintf(base.path, sizeof(base.path), "%s", path);
+    base.dev = st->st_dev;
+    base.ino = st->st_ino;
+    base.size = st->st_size;
+    base.mtime = st->st_mtim;
+    base.hash = hash;
+    pthread_mutex_unlock(&baselock);
+}
+
+
+static uint64_t HashBytes(uint64_t hash, const char *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        hash ^= (unsigned char)s[i];
+        hash *= FNVPRIME;
+    }
+
+    return hash;
+}
+
+
+// FNV-1a of the contents of the file in path, 0 if it can't be read. Only
+// read again if the file changed since it was last hashed.
+static uint64_t FileHash(const char *path) {
+    struct stat st;
+    if (stat(path, &st)) return 0;
+
+    pthread_mutex_lock(&baselock);
+    int same = SameFile(path, &st);
+    uint64_t hash = base.hash;
+    pthread_mutex_unlock(&baselock);
+    if (same) return hash;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+
+    hash = FNVBASIS;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        hash = HashBytes(hash, buf, n);
+    }
+
+    fclose(f);
+    RememberHash(path, &st, hash);
+
+    return hash;
+}
+
+
+// Reads the next edit of a journal. Returns 1 on success, 0 at the end.
+static int ReadEdit(FILE *f, Edit *e) {
+    char type;
+    if (fscanf(f, " %c %lf %lf %lf %lf", &type,
+                &e->seg.start.x, &e->seg.start.y,
+                &e->seg.end.x, &e->seg.end.y) != 5) {
+        return 0;
+    }
+
+    e->type = type;
+    if (type == EDIT_MOVE) {
+        if (fscanf(f, "%lf %lf %lf %lf",
+                    &e->to.start.x, &e->to.start.y,
+                    &e->to.end.x, &e->to.end.y) != 4) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+// Opens the journal of the snapshot in path, if it was written for the
+// current snapshot. Returns NULL otherwise.
+static FILE *OpenJournal(const char *path) {
+    char journal[256];
+    JournalPath(path, journal, sizeof(journal));
+
+    FILE *f = fopen(journal, "r");
+    if (!f) return NULL;
+
+    // A journal left behind by an interrupted M_Save() belongs to an older
+    // snapshot.
+    uint64_t base;
+    if (fscanf(f, "base %" SCNx64, &base) != 1 || base != FileHash(path)) {
+        log_warn("Ignoring stale journal %s", journal);
+        fclose(f);
+        return NULL;
+    }
+
+    return f;
+}
+
+
+static int FindWall(Map *map, Segment s) {
+    for (int i = 0; i < map->numwalls; i++) {
+        if (SEGEQ(map->walls[i].seg, s)) return i;
+    }
+
+    return -1;
+}
+
+
+// Applies e to map, which must have room for one more wall.
+static void ApplyEdit(Map *map, Edit e) {
+    int i;
+
+    switch (e.type) {
+        case EDIT_ADD:
+            map->walls[map->numwalls++] = (Wall){ .seg = e.seg, .seen = 0 };
+            break;
+
+        case EDIT_DELETE:
+            i = FindWall(map, e.seg);
+            if (i >= 0) {
+                map->walls[i] = map->walls[--map->numwalls];
+            }
+            break;
+
+        case EDIT_MOVE:
+            i = FindWall(map, e.seg);
+            if (i >= 0) {
+                map->walls[i].seg = e.to;
+            }
+            break;
+    }
+}
+
+
+Map *M_Load(const char *path, Arena *arena) {
     FILE *f = fopen(path, "r");
+    if (!f) return NULL;
 
-    Map *map = CreateEmptyMap();
+    Map *map = CreateEmptyMap(arena);
+    FILE *journal = OpenJournal(path);
 
+    // Count the walls first, so they can be allocated in one go.
     Segment seg;
-    for (int i = 0;
-            fscanf(f, "%lf %lf %lf %lf",
-                &seg.start.x, &seg.start.y, &seg.end.x, &seg.end.y) != EOF;
-            i++)
-    {
-        map->walls = realloc(map->walls, ++(map->numwalls) * sizeof(Wall));
-        map->walls[i] = (Wall){ .seg = seg, .seen = 0 };
+    int count = 0;
+    while (fscanf(f, "%lf %lf %lf %lf",
+                &seg.start.x, &seg.start.y, &seg.end.x, &seg.end.y) != EOF) {
+        count++;
+    }
+
+    Edit e;
+    long edits = journal ? ftell(journal) : 0;
+    while (journal && ReadEdit(journal, &e)) {
+        if (e.type == EDIT_ADD) count++;
+    }
+
+    map->walls = A_Alloc(arena, count * sizeof(Wall));
+
+    rewind(f);
+    while (map->numwalls < count && fscanf(f, "%lf %lf %lf %lf",
+                &seg.start.x, &seg.start.y, &seg.end.x, &seg.end.y) == 4) {
+        map->walls[map->numwalls++] = (Wall){ .seg = seg, .seen = 0 };
     }
 
     fclose(f);
 
+    if (journal) {
+        fseek(journal, edits, SEEK_SET);
+        while (ReadEdit(journal, &e)) {
+            ApplyEdit(map, e);
+        }
+
+        fclose(journal);
+    }
+
     return map;
 }
+
+
+void M_Save(Map *map, const char *path) {
+    // Write the snapshot to a temporary file and then replace the old one, so
+    // it's never left half written.
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    FILE *f = fopen(tmp, "w");
+    check(f, "Can't write map %s", tmp);
+    if (!f) return;
+
+    // Hash it while it's written, so the next journal needn't read it back.
+    uint64_t hash = FNVBASIS;
+    for (int i = 0; i < map->numwalls; i++) {
+        char line[128];
+        int n = snprintf(line, sizeof(line), "%f %f %f %f\n",
+                map->walls[i].seg.start.x,
+                map->walls[i].seg.start.y,
+                map->walls[i].seg.end.x,
+                map->walls[i].seg.end.y);
+        n = MIN(n, (int)sizeof(line) - 1);
+
+        fwrite(line, 1, n, f);
+        hash = HashBytes(hash, line, n);
+    }
+
+    int failed = ferror(f);
+    fclose(f);
+    rename(tmp, path);
+
+    struct stat st;
+    if (!failed && !stat(path, &st)) RememberHash(path, &st, hash);
+
+    char journal[256];
+    JournalPath(path, journal, sizeof(journal));
+    remove(journal);
+}
+
+
+int M_AppendJournal(const char *path, Edit *edits, int numedits) {
+    uint64_t base = FileHash(path);
+    if (!base) return 0;
+
+    char journal[256];
+    JournalPath(path, journal, sizeof(journal));
+
+    // Start a new journal if there's none for this snapshot.
+    FILE *f = OpenJournal(path);
+    if (f) {
+        fclose(f);
+        f = fopen(journal, "a");
+    } else {
+        f = fopen(journal, "w");
+        if (f) fprintf(f, "base %" PRIx64 "\n", base);
+    }
+
+    check(f, "Can't write journal %s", journal);
+    if (!f) return 0;
+
+    for (int i = 0; i < numedits; i++) {
+        Edit e = edits[i];
+        fprintf(f, "%c %f %f %f %f", e.type,
+                e.seg.start.x, e.seg.start.y, e.seg.end.x, e.seg.end.y);
+        if (e.type == EDIT_MOVE) {
+            fprintf(f, " %f %f %f %f",
+                    e.to.start.x, e.to.start.y, e.to.end.x, e.to.end.y);
+        }
+        fprintf(f, "\n");
+    }
+
+    fclose(f);
+
+    return 1;
+}
+
+
+int M_JournalLength(const char *path) {
+    FILE *f = OpenJournal(path);
+    if (!f) return 0;
+
+    int n = 0;
+    Edit e;
+    while (ReadEdit(f, &e)) n++;
+
+    fclose(f);
+
+    return n;
+}
+
+
+Edit M_InverseEdit(Edit e) {
+    switch (e.type) {
+        case EDIT_ADD:
+            return (Edit){ .type = EDIT_DELETE, .seg = e.seg };
+
+        case EDIT_DELETE:
+            return (Edit){ .type = EDIT_ADD, .seg = e.seg };
+
+        case EDIT_MOVE:
+        default:
+            return (Edit){ .type = EDIT_MOVE, .seg = e.to, .to = e.seg };
+    }
+}
+
+
+void M_Delete(Map *map) {
+    if (map->arena) return;
+
+    free(map->walls);
+    free(map);
+}
+
+
+// FNV-1a
+uint64_t M_Hash(Map *map) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (int i = 0; i < map->numwalls; i++) {
+        const unsigned char *p = (const unsigned char *)&map->walls[i].seg;
+        for (int j = 0; j < sizeof(Segment); j++) {
+            hash ^= p[j];
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    return hash;
+}
+
+
+typedef struct SortedWall {
+    Segment seg;
+    int index;
+} SortedWall;
+
+static int CompareWalls(const void *a, const void *b) {
+    const double *p = (const double *)&((const SortedWall *)a)->seg;
+    const double *q = (const double *)&((const SortedWall *)b)->seg;
+
+    for (int i = 0; i < 4; i++) {
+        if (p[i] != q[i]) return p[i] < q[i] ? -1 : 1;
+    }
+
+    return 0;
+}
+
+
+static SortedWall *SortWalls(Map *map) {
+    SortedWall *sorted = malloc(sizeof(SortedWall) * MAX(map->numwalls, 1));
+    check_mem(sorted);
+
+    for (int i = 0; i < map->numwalls; i++) {
+        sorted[i] = (SortedWall){ map->walls[i].seg, i };
+    }
+    qsort(sorted, map->numwalls, sizeof(SortedWall), CompareWalls);
+
+    return sorted;
+}
+
+
+static void ExtendBox(Box *box, Segment s, int first) {
+    if (first) *box = (Box){ s.start.y, s.start.y, s.start.x, s.start.x };
+
+    box->left = MIN(box->left, MIN(s.start.x, s.end.x));
+    box->right = MAX(box->right, MAX(s.start.x, s.end.x));
+    box->top = MIN(box->top, MIN(s.start.y, s.end.y));
+    box->bottom = MAX(box->bottom, MAX(s.start.y, s.end.y));
+}
+
+
+int M_Diff(Map *a, Map *b, int *from, Box *changed) {
+    SortedWall *sa = SortWalls(a);
+    SortedWall *sb = SortWalls(b);
+
+    for (int i = 0; i < b->numwalls; i++) {
+        from[i] = -1;
+    }
+
+    // Walk both sorted lists at once, like merging them.
+    int diffs = 0;
+    int i = 0, j = 0;
+    while (i < a->numwalls || j < b->numwalls) {
+        int cmp = i == a->numwalls ? 1 :
+            j == b->numwalls ? -1 :
+            CompareWalls(&sa[i], &sb[j]);
+
+        if (cmp == 0) {
+            from[sb[j++].index] = sa[i++].index;
+        } else if (cmp < 0) {
+            ExtendBox(changed, sa[i++].seg, diffs++ == 0);
+        } else {
+            ExtendBox(changed, sb[j++].seg, diffs++ == 0);
+        }
+    }
+
+    free(sa);
+    free(sb);
+
+    return diffs;
+}
@@ -1,6 +1,16 @@
+//------------------------------------------------------------------------------
+// Maps
+//
+// Maps are stored as a text snapshot, one wall per line, and an optional
+// journal of the edits made since the snapshot was written, in
+// "<snapshot>.journal". Loading a map replays its journal.
+//------------------------------------------------------------------------------
 #ifndef _MAP_
 #define _MAP_
 
+#include <stdint.h>
+
+#include "arena.h"
 #include "geometry.h"
 
 typedef struct {
@@ -12,9 +22,54 @@ typedef struct {
 typedef struct Map {
     Wall *walls;
     int numwalls;
+
+    Arena *arena;   // Where the Map was allocated, NULL for the heap.
 } Map;
 
+typedef enum EditType {
+    EDIT_ADD = '+',
+    EDIT_DELETE = '-',
+    EDIT_MOVE = 'm',
+} EditType;
+
+// A change to the walls of a map.
+typedef struct Edit {
+    EditType type;
+    Segment seg;    // Wall added, deleted or moved
+    Segment to;     // Where seg is moved to
+} Edit;
+
+
+// Loads the map stored in path, allocating it from arena.
+// Returns NULL if path can't be read.
+Map *M_Load(const char *path, Arena *arena);
+
+// Writes map to path, and removes its journal.
+void M_Save(Map *map, const char *path);
+
+// Appends edits to the journal of the map stored in path.
+//
+// Returns 0 if there's no map stored in path to append to, 1 otherwise.
+int M_AppendJournal(const char *path, Edit *edits, int numedits);
+
+// Returns the number of edits in the journal of the map stored in path.
+int M_JournalLength(const char *path);
+
+// Returns the edit that undoes e.
+Edit M_InverseEdit(Edit e);
+
+// Matches the walls of b with identical walls of a: from[i] is set to the
+// index of the wall of a equal to wall i of b, -1 if there's none. Stores in
+// changed the bounding box of the walls that are in just one of the maps.
+//
+// Returns how many walls are in just one of the maps.
+int M_Diff(Map *a, Map *b, int *from, Box *changed);
+
+// Free a Map. Does nothing for Maps allocated from an arena.
+void M_Delete(Map *map);
 
-Map *M_Load(const char *path);
+// Returns a hash of the geometry of map. Two maps with the same walls in the
+// same order have the same hash.
+uint64_t M_Hash(Map *map);
 
 #endif
@@ -0,0 +1,305 @@
+#include <arpa/inet.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "dbg.h"
+#include "metrics.h"
+
+#define POLLMS 100      // How often the endpoint checks whether to quit
+
+_Thread_local int mt_shard;
+
+static _Atomic int numshards;
+
+
+int Mt_NewShard() {
+    mt_shard = atomic_fetch_add(&numshards, 1) % MTSHARDS + 1;
+    return mt_shard;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Registry
+//------------------------------------------------------------------------------
+
+void Mt_Init(Metrics *ms) {
+    memset(ms, 0, sizeof(*ms));
+    ms->sock = -1;
+}
+
+
+void Mt_Free(Metrics *ms) {
+    if (ms->sock >= 0) {
+        ms->quit = 1;
+        pthread_join(ms->thread, NULL);
+        close(ms->sock);
+    }
+
+    for (int i = 0; i < ms->nummetrics; i++) {
+        free(ms->metrics[i]);
+    }
+
+    Mt_Init(ms);
+}
+
+
+static Metric *Create(Metrics *ms, MtType type, const char *name,
+        const char *help, double unit) {
+    int n = ms->nummetrics;
+    check(n < MTMAX, "Too many metrics, %s left out", name);
+    if (n == MTMAX) return NULL;
+
+    // Aligned, for shards not to share cache lines.
+    Metric *m = aligned_alloc(64, sizeof(Metric));
+    check_mem(m);
+    if (!m) return NULL;
+    memset(m, 0, sizeof(Metric));
+
+    snprintf(m->name, sizeof(m->name), "%s", name);
+    snprintf(m->help, sizeof(m->help), "%s", help);
+    m->type = type;
+    m->unit = unit;
+
+    // Published only once it's all there, for the endpoint to see.
+    ms->metrics[n] = m;
+    atomic_store_explicit(&ms->nummetrics, n + 1, memory_order_release);
+
+    return m;
+}
+
+
+Metric *Mt_Counter(Metrics *ms, const char *name, const char *help) {
+    return Create(ms, MT_COUNTER, name, help, 1);
+}
+
+
+Metric *Mt_Gauge(Metrics *ms, const char *name, const char *help, double unit) {
+    return Create(ms, MT_GAUGE, name, help, unit);
+}
+
+
+Metric *Mt_Histogram(Metrics *ms, const char *name, const char *help,
+        double unit) {
+    return Create(ms, MT_HISTOGRAM, name, help, unit);
+}
+
+
+Metric *Mt_Find(Metrics *ms, const char *name) {
+    int n = atomic_load_explicit(&ms->nummetrics, memory_order_acquire);
+    for (int i = 0; i < n; i++) {
+        if (!strcmp(ms->metrics[i]->name, name)) return ms->metrics[i];
+    }
+    return NULL;
+}
+
+
+uint64_t Mt_Value(Metric *m) {
+    uint64_t v = 0;
+    for (int i = 0; i < MTSHARDS; i++) {
+        v += atomic_load_explicit(&m->shards[i].sum, memory_order_relaxed);
+    }
+    return v;
+}
+
+
+static uint64_t Bucket(Metric *m, int b) {
+    uint64_t n = 0;
+    for (int i = 0; i < MTSHARDS; i++) {
+        n += atomic_load_explicit(&m->shards[i].buckets[b],
+                memory_order_relaxed);
+    }
+    return n;
+}
+
+
+uint64_t Mt_Count(Metric *m) {
+    uint64_t n = 0;
+    for (int b = 0; b < MTBUCKETS; b++) {
+        n += Bucket(m, b);
+    }
+    return n;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Reporting
+//------------------------------------------------------------------------------
+
+static const char *types[] = {
+    [MT_COUNTER] = "counter",
+    [MT_GAUGE] = "gauge",
+    [MT_HISTOGRAM] = "histogram",
+};
+
+
+void Mt_Write(Metrics *ms, FILE *f) {
+    int n = atomic_load_explicit(&ms->nummetrics, memory_order_acquire);
+
+    for (int i = 0; i < n; i++) {
+        Metric *m = ms->metrics[i];
+
+        fprintf(f, "# HELP %s %s\n", m->name, m->help);
+        fprintf(f, "# TYPE %s %s\n", m->name, types[m->type]);
+
+        if (m->type != MT_HISTOGRAM) {
+            fprintf(f, "%s %.15g\n", m->name, Mt_Value(m) * m->unit);
+            continue;
+        }
+
+        // Buckets are cumulative.
+        uint64_t count = 0;
+        for (int b = 0; b < MTBUCKETS - 1; b++) {
+            count += Bucket(m, b);
+            fprintf(f, "%s_bucket{le=\"%.15g\"} %lu\n", m->name,
+                    (double)(1ULL << b) * m->unit, (unsigned long)count);
+        }
+        count += Bucket(m, MTBUCKETS - 1);
+        fprintf(f, "%s_bucket{le=\"+Inf\"} %lu\n", m->name, (unsigned long)count);
+        fprintf(f, "%s_sum %.15g\n", m->name, Mt_Value(m) * m->unit);
+        fprintf(f, "%s_count %lu\n", m->name, (unsigned long)count);
+    }
+}
+
+
+// Sends all of data to conn. Returns 0 if the client went away.
+static int SendAll(int conn, const char *data, size_t size) {
+    while (size > 0) {
+        // A client closing early must not take the process down with SIGPIPE.
+        ssize_t n = send(conn, data, size, MSG_NOSIGNAL);
+        if (n <= 0) return 0;
+
+        data += n;
+        size -= n;
+    }
+
+    return 1;
+}
+
+
+// Answers every request with the metrics, whatever was asked.
+static void *Serve(void *arg) {
+    Metrics *ms = arg;
+
+    while (!ms->quit) {
+        struct pollfd p = { .fd = ms->sock, .events = POLLIN };
+        if (poll(&p, 1, POLLMS) <= 0) continue;
+
+        int conn = accept(ms->sock, NULL, NULL);
+        if (conn < 0) continue;
+
+        // The request itself doesn't matter, but it has to be read.
+        char request[1024];
+        struct timeval timeout = { .tv_sec = 1 };
+        setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if (recv(conn, request, sizeof(request), 0) <= 0) {
+            close(conn);
+            continue;
+        }
+
+        // Written to memory first, and then sent in one go.
+        char *response = NULL;
+        size_t size = 0;
+        FILE *f = open_memstream(&response, &size);
+        if (!f) {
+            close(conn);
+            continue;
+        }
+
+        fprintf(f, "HTTP/1.0 200 OK\r\n"
+                "Content-Type: text/plain; version=0.0.4\r\n"
+                "Connection: close\r\n\r\n");
+        Mt_Write(ms, f);
+        fclose(f);
+
+        SendAll(conn, response, size);
+        free(response);
+        close(conn);
+    }
+
+    return NULL;
+}
+
+
+int Mt_Serve(Metrics *ms, int port) {
+    ms->sock = socket(AF_INET, SOCK_STREAM, 0);
+    check(ms->sock >= 0, "Can't open socket");
+    if (ms->sock < 0) return 0;
+
+    int yes = 1;
+    setsockopt(ms->sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(ms->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+            listen(ms->sock, 8) < 0) {
+        log_err("Can't serve metrics on port %d", port);
+        close(ms->sock);
+        ms->sock = -1;
+        return 0;
+    }
+
+    ms->quit = 0;
+    pthread_create(&ms->thread, NULL, Serve, ms);
+
+    return 1;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Rings
+//
+// Every slot works as a seqlock: a writer claims a slot by bumping the head,
+// makes its seq odd while it writes, and even when done. Readers take a
+// sample only if its seq is the one expected of it before and after copying.
+//------------------------------------------------------------------------------
+
+void Mt_Push(MtRing *r, const uint32_t values[MTFIELDS]) {
+    uint64_t n = atomic_fetch_add_explicit(&r->head, 1, memory_order_relaxed);
+    MtSlot *s = &r->slots[n & (MTRINGLEN - 1)];
+
+    atomic_store_explicit(&s->seq, 2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    for (int i = 0; i < MTFIELDS; i++) {
+        atomic_store_explicit(&s->values[i], values[i], memory_order_relaxed);
+    }
+
+    atomic_store_explicit(&s->seq, 2 * n + 2, memory_order_release);
+}
+
+
+int Mt_Latest(MtRing *r, uint32_t (*out)[MTFIELDS], int n) {
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    uint64_t oldest = head > MTRINGLEN ? head - MTRINGLEN : 0;
+    int copied = 0;
+
+    for (uint64_t k = head; k > oldest && copied < n; k--) {
+        MtSlot *s = &r->slots[(k - 1) & (MTRINGLEN - 1)];
+
+        uint64_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (seq != 2 * k) continue;
+
+        for (int i = 0; i < MTFIELDS; i++) {
+            out[copied][i] = atomic_load_explicit(&s->values[i],
+                    memory_order_relaxed);
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&s->seq, memory_order_relaxed) != seq) continue;
+
+        copied++;
+    }
+
+    return copied;
+}
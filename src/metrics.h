@@ -0,0 +1,149 @@
+//------------------------------------------------------------------------------
+// Metrics
+//
+// Counters, gauges, histograms and rings of the latest samples, which any
+// thread can write without locks, and an HTTP endpoint on localhost that
+// serves them in the Prometheus text format:
+//
+//   curl http://127.0.0.1:9100/metrics
+//
+// Counters and histograms are split over MTSHARDS cache lines, and every
+// thread writes to its own, so writing one is a relaxed atomic add on a line
+// no other thread is writing to: a few ns.
+//------------------------------------------------------------------------------
+#ifndef _METRICS_
+#define _METRICS_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define MTPORT 9100
+#define MTMAX 64            // Metrics in a registry
+#define MTSHARDS 16         // Cache lines a metric is split over
+#define MTBUCKETS 16        // Histogram buckets: <= 1, 2, 4 ... 2^14, and more
+#define MTRINGLEN 128       // Samples kept by a ring, a power of two
+#define MTFIELDS 4          // Values in a sample
+
+typedef enum MtType {
+    MT_COUNTER,
+    MT_GAUGE,
+    MT_HISTOGRAM,
+} MtType;
+
+// A thread's share of a metric.
+typedef struct MtShard {
+    _Atomic uint64_t sum;                   // Of the values added or observed
+    _Atomic uint64_t buckets[MTBUCKETS];    // Histograms only
+} __attribute__((aligned(64))) MtShard;
+
+typedef struct Metric {
+    MtShard shards[MTSHARDS];   // Gauges only use the first
+
+    char name[64];
+    char help[128];
+    MtType type;
+    double unit;                // What a value is worth, when reported
+} Metric;
+
+// A slot of a ring. seq is odd while the sample is being written.
+typedef struct MtSlot {
+    _Atomic uint64_t seq;
+    _Atomic uint32_t values[MTFIELDS];
+} MtSlot;
+
+// Keeps the last MTRINGLEN samples pushed, from any number of threads. Older
+// ones are overwritten: pushing never waits.
+typedef struct MtRing {
+    _Atomic uint64_t head;      // Samples ever pushed
+    MtSlot slots[MTRINGLEN];
+} MtRing;
+
+typedef struct Metrics {
+    Metric *metrics[MTMAX];
+    _Atomic int nummetrics;
+
+    int sock;                   // Endpoint, -1 if not serving
+    pthread_t thread;
+    _Atomic int quit;
+} Metrics;
+
+
+// Starts a registry with no metrics, not serving them.
+void Mt_Init(Metrics *ms);
+
+// Stops serving and deletes every metric.
+void Mt_Free(Metrics *ms);
+
+// Creates a metric in ms. Values are multiplied by unit when reported: a
+// histogram of times in ms should have a unit of 0.001, to report seconds.
+// Metrics are created from one thread, which can be while serving them.
+//
+// Returns NULL when ms is full.
+Metric *Mt_Counter(Metrics *ms, const char *name, const char *help);
+Metric *Mt_Gauge(Metrics *ms, const char *name, const char *help, double unit);
+Metric *Mt_Histogram(Metrics *ms, const char *name, const char *help,
+        double unit);
+
+// Returns the metric in ms called name, NULL if there's none.
+Metric *Mt_Find(Metrics *ms, const char *name);
+
+// Shard of the calling thread, plus one. 0 until it writes a metric.
+extern _Thread_local int mt_shard;
+
+// Picks the shard of the calling thread.
+int Mt_NewShard();
+
+static inline int Mt_Shard() {
+    return (mt_shard ? mt_shard : Mt_NewShard()) - 1;
+}
+
+// Adds n to counter m.
+static inline void Mt_Add(Metric *m, uint64_t n) {
+    atomic_fetch_add_explicit(&m->shards[Mt_Shard()].sum, n,
+            memory_order_relaxed);
+}
+
+// Sets gauge m to v.
+static inline void Mt_Set(Metric *m, uint64_t v) {
+    atomic_store_explicit(&m->shards[0].sum, v, memory_order_relaxed);
+}
+
+// Adds v to histogram m, in the bucket of the smallest power of two not
+// under it.
+static inline void Mt_Observe(Metric *m, uint64_t v) {
+    int b = v <= 1 ? 0 : 64 - __builtin_clzll(v - 1);
+    if (b > MTBUCKETS - 1) b = MTBUCKETS - 1;
+
+    MtShard *s = &m->shards[Mt_Shard()];
+    atomic_fetch_add_explicit(&s->buckets[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->sum, v, memory_order_relaxed);
+}
+
+// Returns the value of counter or gauge m, or the sum of what histogram m
+// observed.
+uint64_t Mt_Value(Metric *m);
+
+// Returns the number of values histogram m observed.
+uint64_t Mt_Count(Metric *m);
+
+// Writes every metric in ms to f in the Prometheus text format.
+void Mt_Write(Metrics *ms, FILE *f);
+
+// Serves the metrics of ms over HTTP on localhost, from another thread.
+//
+// Returns 0 if port can't be listened on, 1 otherwise.
+int Mt_Serve(Metrics *ms, int port);
+
+
+// Adds a sample of MTFIELDS values to r.
+void Mt_Push(MtRing *r, const uint32_t values[MTFIELDS]);
+
+// Copies up to n of the latest samples in r to out, the latest first.
+// Samples being written at the time are skipped.
+//
+// Returns the number of samples copied.
+int Mt_Latest(MtRing *r, uint32_t (*out)[MTFIELDS], int n);
+
+#endif
@@ -0,0 +1,644 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "dbg.h"
+#include "defs.h"
+#include "geometry.h"
+#include "map.h"
+#include "nav.h"
+
+#define NAVCACHE 1024           // Cached paths
+#define NAVCACHEPOINTS 65536    // Waypoints shared by all the cached paths
+#define NAVMAGIC 0x3156414E     // "NAV1"
+
+#define SQRT2 1.41421356f
+
+
+//------------------------------------------------------------------------------
+// Cells
+//------------------------------------------------------------------------------
+
+static Vector CellCenter(NavGrid *nav, int cell) {
+    return (Vector){
+        nav->origin.x + (cell % nav->width + 0.5) * nav->cellsize,
+        nav->origin.y + (cell / nav->width + 0.5) * nav->cellsize,
+    };
+}
+
+
+// Returns the index of the cell containing p, -1 if outside the grid.
+static int CellAt(NavGrid *nav, Vector p) {
+    int x = floor((p.x - nav->origin.x) / nav->cellsize);
+    int y = floor((p.y - nav->origin.y) / nav->cellsize);
+
+    if (x < 0 || x >= nav->width || y < 0 || y >= nav->height) return -1;
+
+    return y * nav->width + x;
+}
+
+
+// Recomputes the blocked flag of the cells in [x0, x1] x [y0, y1].
+static void Rasterize(NavGrid *nav, Map *map, int x0, int y0, int x1, int y1) {
+    x0 = MAX(x0, 0);
+    y0 = MAX(y0, 0);
+    x1 = MIN(x1, nav->width - 1);
+    y1 = MIN(y1, nav->height - 1);
+
+    for (int y = y0; y <= y1; y++) {
+        memset(&nav->blocked[y * nav->width + x0], 0, x1 - x0 + 1);
+    }
+
+    // Only the cells under the bounding box of each wall, inflated by radius,
+    // can be blocked by it.
+    for (int i = 0; i < map->numwalls; i++) {
+        Segment s = map->walls[i].seg;
+
+        int wx0 = floor((MIN(s.start.x, s.end.x) - nav->radius - nav->origin.x) / nav->cellsize);
+        int wx1 = floor((MAX(s.start.x, s.end.x) + nav->radius - nav->origin.x) / nav->cellsize);
+        int wy0 = floor((MIN(s.start.y, s.end.y) - nav->radius - nav->origin.y) / nav->cellsize);
+        int wy1 = floor((MAX(s.start.y, s.end.y) + nav->radius - nav->origin.y) / nav->cellsize);
+
+        wx0 = MAX(wx0, x0);
+        wy0 = MAX(wy0, y0);
+        wx1 = MIN(wx1, x1);
+        wy1 = MIN(wy1, y1);
+
+        for (int y = wy0; y <= wy1; y++) {
+            for (int x = wx0; x <= wx1; x++) {
+                int cell = y * nav->width + x;
+                if (nav->blocked[cell]) continue;
+
+                if (G_SegmentPointDistance(s, CellCenter(nav, cell)) < nav->radius) {
+                    nav->blocked[cell] = 1;
+                }
+            }
+        }
+    }
+}
+
+
+// Returns 1 if the straight line between the centers of cells a and b only
+// crosses walkable cells.
+//
+// Walks every cell the line crosses, in order: the next one is across the
+// column or the row boundary the line reaches first. Reaching both at once
+// is going through a corner, allowed only if both cells beside it are free,
+// as Search() does.
+static int LineOfSight(NavGrid *nav, int a, int b) {
+    int w = nav->width;
+    int x = a % w, y = a / w;
+    int dx = abs(b % w - x), dy = abs(b / w - y);
+    int sx = b % w > x ? 1 : -1;
+    int sy = b / w > y ? 1 : -1;
+
+    for (int ix = 0, iy = 0; ix < dx || iy < dy;) {
+        // Boundaries are reached at (1 + 2 ix) / 2 dx and (1 + 2 iy) / 2 dy
+        // of the way.
+        long cmp = (long)(1 + 2 * ix) * dy - (long)(1 + 2 * iy) * dx;
+
+        if (cmp == 0) {
+            if (nav->blocked[y * w + x + sx] || nav->blocked[(y + sy) * w + x]) {
+                return 0;
+            }
+            x += sx, ix++;
+            y += sy, iy++;
+        } else if (cmp < 0) {
+            x += sx, ix++;
+        } else {
+            y += sy, iy++;
+        }
+
+        if (nav->blocked[y * w + x]) return 0;
+    }
+
+    return 1;
+}
+
+
+// Numbers the regions of connected free cells, flooding them one at a time.
+// Moving diagonally needs both cells beside the move free, so cells that
+// connect at all connect through their sides.
+static void FindRegions(NavGrid *nav) {
+    int w = nav->width, h = nav->height;
+    int *stack = nav->parent;   // Not needed between searches
+    int regions = 0;
+
+    for (int i = 0; i < w * h; i++) {
+        nav->region[i] = -1;
+    }
+
+    for (int i = 0; i < w * h; i++) {
+        if (nav->blocked[i] || nav->region[i] >= 0) continue;
+
+        int size = 0;
+        stack[size++] = i;
+        nav->region[i] = regions;
+
+        while (size > 0) {
+            int cell = stack[--size];
+            int x = cell % w, y = cell / w;
+            int next[] = { cell - 1, cell + 1, cell - w, cell + w };
+            int inside[] = { x > 0, x < w - 1, y > 0, y < h - 1 };
+
+            for (int j = 0; j < 4; j++) {
+                if (!inside[j] || nav->blocked[next[j]] || nav->region[next[j]] >= 0) {
+                    continue;
+                }
+                nav->region[next[j]] = regions;
+                stack[size++] = next[j];
+            }
+        }
+
+        regions++;
+    }
+}
+
+
+
+//------------------------------------------------------------------------------
+// Open list
+//------------------------------------------------------------------------------
+
+// Whether a goes before b in the open list. Of the cells as promising, the
+// ones further from the start go first: they're closer to the goal, and far
+// fewer cells get expanded in open space.
+static inline int Before(NavOpen a, NavOpen b) {
+    return a.f < b.f || (a.f == b.f && a.g > b.g);
+}
+
+
+// Moves e up from the hole at i to where it belongs.
+static void HeapUp(NavGrid *nav, int i, NavOpen e) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!Before(e, nav->heap[parent])) break;
+
+        nav->heap[i] = nav->heap[parent];
+        nav->heappos[nav->heap[i].cell] = i;
+        i = parent;
+    }
+
+    nav->heap[i] = e;
+    nav->heappos[e.cell] = i;
+}
+
+
+// Moves e down from the hole at i to where it belongs.
+static void HeapDown(NavGrid *nav, int size, int i, NavOpen e) {
+    while (1) {
+        int min = 2 * i + 1;
+        if (min >= size) break;
+        if (min + 1 < size && Before(nav->heap[min + 1], nav->heap[min])) min++;
+        if (!Before(nav->heap[min], e)) break;
+
+        nav->heap[i] = nav->heap[min];
+        nav->heappos[nav->heap[i].cell] = i;
+        i = min;
+    }
+
+    nav->heap[i] = e;
+    nav->heappos[e.cell] = i;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Search
+//------------------------------------------------------------------------------
+
+// Length of the shortest path across dx columns and dy rows, with nothing in
+// the way.
+static inline float Octile(int dx, int dy) {
+    dx = abs(dx);
+    dy = abs(dy);
+    return MAX(dx, dy) + (SQRT2 - 1) * MIN(dx, dy);
+}
+
+
+// Octile distance, a little over. In open space, every cell between the start
+// and the goal is on some shortest path, and would be expanded. Overestimating
+// by a thousandth breaks those ties towards the goal, for paths that are at
+// most a thousandth longer.
+static inline float Heuristic(int dx, int dy) {
+    return Octile(dx, dy) * 1.001f;
+}
+
+
+static inline int Free(NavGrid *nav, int x, int y) {
+    return x >= 0 && x < nav->width && y >= 0 && y < nav->height &&
+        !nav->blocked[y * nav->width + x];
+}
+
+
+// Walks from (x, y) in direction (dx, dy) to the next jump point: the goal, or
+// a cell some shortest path turns at. Straight runs end beside the corner of a
+// blocked cell, where the cells behind it open up. Diagonal runs end where one
+// of the straight runs out of them finds a jump point.
+//
+// Returns the jump point, -1 if the run hits a wall first.
+static int Jump(NavGrid *nav, int x, int y, int dx, int dy, int goal) {
+    while (1) {
+        x += dx;
+        y += dy;
+        if (!Free(nav, x, y)) return -1;
+
+        int cell = y * nav->width + x;
+        if (cell == goal) return cell;
+
+        if (dx && dy) {
+            if (Jump(nav, x, y, dx, 0, goal) >= 0) return cell;
+            if (Jump(nav, x, y, 0, dy, goal) >= 0) return cell;
+
+            // Don't cut corners.
+            if (!Free(nav, x + dx, y) || !Free(nav, x, y + dy)) return -1;
+        } else if (dx) {
+            if (Free(nav, x, y - 1) && !Free(nav, x - dx, y - 1)) return cell;
+            if (Free(nav, x, y + 1) && !Free(nav, x - dx, y + 1)) return cell;
+        } else {
+            if (Free(nav, x - 1, y) && !Free(nav, x - 1, y - dy)) return cell;
+            if (Free(nav, x + 1, y) && !Free(nav, x + 1, y - dy)) return cell;
+        }
+    }
+}
+
+
+// Jump point search from cell start to cell goal: A* over the jump points
+// only, each one jumping on in the directions a shortest path through it can
+// take. That's every direction from the start, the way it was reached, and
+// around the corners that made it a jump point.
+//
+// Returns 1 if goal was reached, leaving the jump points leading to it in
+// nav->parent.
+static int Search(NavGrid *nav, int start, int goal) {
+    int w = nav->width;
+    int gx = goal % w, gy = goal / w;
+
+    // Bumping the search counter marks every cell as untouched.
+    if (++nav->search == 0) {
+        memset(nav->visited, 0, sizeof(uint32_t) * nav->width * nav->height);
+        nav->search = 1;
+    }
+
+    nav->visited[start] = nav->search;
+    nav->g[start] = 0;
+    nav->parent[start] = -1;
+    nav->heap[0] = (NavOpen){ Heuristic(start % w - gx, start / w - gy), 0, start };
+    nav->heappos[start] = 0;
+    int size = 1;
+
+    while (size > 0) {
+        int cell = nav->heap[0].cell;
+        if (cell == goal) return 1;
+
+        if (--size) HeapDown(nav, size, 0, nav->heap[size]);
+        nav->heappos[cell] = -1;  // Closed
+
+        int cx = cell % w;
+        int cy = cell / w;
+
+        // Directions to jump in
+        int dirs[8][2];
+        int numdirs = 0;
+        int parent = nav->parent[cell];
+
+        if (parent < 0) {
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    if (!dx && !dy) continue;
+                    if (dx && dy && (!Free(nav, cx + dx, cy) || !Free(nav, cx, cy + dy))) {
+                        continue;
+                    }
+                    dirs[numdirs][0] = dx, dirs[numdirs][1] = dy, numdirs++;
+                }
+            }
+        } else {
+            int dx = (cx > parent % w) - (cx < parent % w);
+            int dy = (cy > parent / w) - (cy < parent / w);
+
+            if (dx && dy) {
+                dirs[numdirs][0] = dx, dirs[numdirs][1] = 0, numdirs++;
+                dirs[numdirs][0] = 0, dirs[numdirs][1] = dy, numdirs++;
+                if (Free(nav, cx + dx, cy) && Free(nav, cx, cy + dy)) {
+                    dirs[numdirs][0] = dx, dirs[numdirs][1] = dy, numdirs++;
+                }
+            } else {
+                // Along the run, and to either side with a corner behind it
+                int ahead = Free(nav, cx + dx, cy + dy);
+                dirs[numdirs][0] = dx, dirs[numdirs][1] = dy, numdirs++;
+
+                for (int side = -1; side <= 1; side += 2) {
+                    int sx = dy ? side : 0, sy = dx ? side : 0;
+                    if (!Free(nav, cx + sx, cy + sy)) continue;
+                    if (Free(nav, cx + sx - dx, cy + sy - dy)) continue;
+
+                    dirs[numdirs][0] = sx, dirs[numdirs][1] = sy, numdirs++;
+                    if (ahead) {
+                        dirs[numdirs][0] = dx + sx, dirs[numdirs][1] = dy + sy, numdirs++;
+                    }
+                }
+            }
+        }
+
+        for (int i = 0; i < numdirs; i++) {
+            int next = Jump(nav, cx, cy, dirs[i][0], dirs[i][1], goal);
+            if (next < 0) continue;
+
+            int x = next % w;
+            int y = next / w;
+            float g = nav->g[cell] + Octile(x - cx, y - cy);
+            NavOpen e = { g + Heuristic(x - gx, y - gy), g, next };
+
+            if (nav->visited[next] != nav->search) {
+                nav->visited[next] = nav->search;
+                nav->g[next] = g;
+                nav->parent[next] = cell;
+                HeapUp(nav, size++, e);
+            } else if (nav->heappos[next] >= 0 && g < nav->g[next]) {
+                nav->g[next] = g;
+                nav->parent[next] = cell;
+                HeapUp(nav, nav->heappos[next], e);
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+// Turns the jump points leading to goal left in nav->parent by Search() into
+// waypoints, dropping the ones that can be skipped walking in a straight line.
+//
+// Returns the number of waypoints of the path, even if only the first
+// maxpoints fit in points.
+static int BuildPath(NavGrid *nav, int goal, Vector *points, int maxpoints) {
+    int w = nav->width;
+
+    // The positions in the open list aren't needed anymore, reuse them to
+    // hold the cells in order, filling in the runs between jump points.
+    int *cells = nav->heappos;
+    int len = 1;
+    for (int c = goal, p; (p = nav->parent[c]) != -1; c = p) {
+        len += MAX(abs(c % w - p % w), abs(c / w - p / w));
+    }
+
+    cells[len - 1] = goal;
+    for (int c = goal, p, i = len - 1; (p = nav->parent[c]) != -1; c = p) {
+        int dx = (p % w > c % w) - (p % w < c % w);
+        int dy = (p / w > c / w) - (p / w < c / w);
+        for (int x = c % w, y = c / w; y * w + x != p;) {
+            x += dx, y += dy;
+            cells[--i] = y * w + x;
+        }
+    }
+
+    int n = 0;
+    int anchor = 0;
+    for (int i = 1; i < len; i++) {
+        if (i == len - 1 || !LineOfSight(nav, cells[anchor], cells[i + 1])) {
+            if (n < maxpoints) points[n] = CellCenter(nav, cells[i]);
+            n++;
+            anchor = i;
+        }
+    }
+
+    return n;
+}
+
+
+static NavCacheEntry *CacheEntry(NavGrid *nav, int from, int to) {
+    uint32_t h = (uint32_t)from * 2654435761u ^ (uint32_t)to * 40503u;
+    return &nav->cache[h % NAVCACHE];
+}
+
+
+
+//------------------------------------------------------------------------------
+// Public interface
+//------------------------------------------------------------------------------
+
+static NavGrid *AllocGrid(int width, int height, Arena *arena) {
+    NavGrid *nav = A_Alloc(arena, sizeof(NavGrid));
+    int cells = width * height;
+
+    nav->width = width;
+    nav->height = height;
+    nav->arena = arena;
+    nav->blocked = A_Alloc(arena, cells);
+    nav->region = A_Alloc(arena, sizeof(int) * cells);
+    nav->g = A_Alloc(arena, sizeof(float) * cells);
+    nav->parent = A_Alloc(arena, sizeof(int) * cells);
+    nav->heap = A_Alloc(arena, sizeof(NavOpen) * cells);
+    nav->heappos = A_Alloc(arena, sizeof(int) * cells);
+    nav->visited = A_Alloc(arena, sizeof(uint32_t) * cells);
+    nav->cache = A_Alloc(arena, sizeof(NavCacheEntry) * NAVCACHE);
+    nav->cachepoints = A_Alloc(arena, sizeof(Vector) * NAVCACHEPOINTS);
+
+    memset(nav->visited, 0, sizeof(uint32_t) * cells);
+    nav->search = 0;
+
+    N_Invalidate(nav);
+
+    return nav;
+}
+
+
+NavGrid *N_Build(Map *map, double radius, double cellsize, Arena *arena) {
+    Box bounds = { 0, 0, 0, 0 };
+    for (int i = 0; i < map->numwalls; i++) {
+        Segment s = map->walls[i].seg;
+        if (i == 0) bounds = (Box){ s.start.y, s.start.y, s.start.x, s.start.x };
+
+        bounds.left = MIN(bounds.left, MIN(s.start.x, s.end.x));
+        bounds.right = MAX(bounds.right, MAX(s.start.x, s.end.x));
+        bounds.top = MIN(bounds.top, MIN(s.start.y, s.end.y));
+        bounds.bottom = MAX(bounds.bottom, MAX(s.start.y, s.end.y));
+    }
+
+    int width = ceil((bounds.right - bounds.left) / cellsize) + 1;
+    int height = ceil((bounds.bottom - bounds.top) / cellsize) + 1;
+
+    NavGrid *nav = AllocGrid(width, height, arena);
+    nav->origin = (Vector){ bounds.left, bounds.top };
+    nav->cellsize = cellsize;
+    nav->radius = radius;
+    nav->maphash = M_Hash(map);
+
+    Rasterize(nav, map, 0, 0, width - 1, height - 1);
+    FindRegions(nav);
+
+    return nav;
+}
+
+
+NavGrid *N_Copy(NavGrid *nav, Arena *arena) {
+    NavGrid *copy = AllocGrid(nav->width, nav->height, arena);
+    copy->origin = nav->origin;
+    copy->cellsize = nav->cellsize;
+    copy->radius = nav->radius;
+    copy->maphash = nav->maphash;
+
+    memcpy(copy->blocked, nav->blocked, nav->width * nav->height);
+    memcpy(copy->region, nav->region, sizeof(int) * nav->width * nav->height);
+
+    return copy;
+}
+
+
+void N_UpdateRegion(NavGrid *nav, Map *map, Box box) {
+    Rasterize(nav, map,
+            floor((box.left - nav->origin.x) / nav->cellsize),
+            floor((box.top - nav->origin.y) / nav->cellsize),
+            floor((box.right - nav->origin.x) / nav->cellsize),
+            floor((box.bottom - nav->origin.y) / nav->cellsize));
+    FindRegions(nav);
+
+    nav->maphash = M_Hash(map);
+    N_Invalidate(nav);
+}
+
+
+void N_Invalidate(NavGrid *nav) {
+    for (int i = 0; i < NAVCACHE; i++) {
+        nav->cache[i] = (NavCacheEntry){ .from = -1, .to = -1 };
+    }
+    nav->numcachepoints = 0;
+}
+
+
+void N_Delete(NavGrid *nav) {
+    if (nav->arena) return;
+
+    free(nav->blocked);
+    free(nav->region);
+    free(nav->g);
+    free(nav->parent);
+    free(nav->heap);
+    free(nav->heappos);
+    free(nav->visited);
+    free(nav->cache);
+    free(nav->cachepoints);
+    free(nav);
+}
+
+
+int N_IsWalkable(NavGrid *nav, Vector p) {
+    int cell = CellAt(nav, p);
+
+    return cell >= 0 && !nav->blocked[cell];
+}
+
+
+int N_FindPath(NavGrid *nav, Vector from, Vector to, Vector *points, int maxpoints) {
+    int start = CellAt(nav, from);
+    int goal = CellAt(nav, to);
+
+    if (maxpoints < 1) return 0;
+    if (start < 0 || goal < 0) return 0;
+    if (nav->blocked[start] || nav->blocked[goal]) return 0;
+    if (nav->region[start] != nav->region[goal]) return 0;
+
+    if (start == goal || LineOfSight(nav, start, goal)) {
+        points[0] = to;
+        return 1;
+    }
+
+    NavCacheEntry *e = CacheEntry(nav, start, goal);
+    if (e->from != start || e->to != goal) {
+        if (!Search(nav, start, goal)) return 0;
+
+        int room = NAVCACHEPOINTS - nav->numcachepoints;
+        int len = BuildPath(nav, goal, nav->cachepoints + nav->numcachepoints, room);
+
+        // When the cache runs out of room, start over.
+        if (len > room) {
+            N_Invalidate(nav);
+            len = BuildPath(nav, goal, nav->cachepoints, NAVCACHEPOINTS);
+            len = MIN(len, NAVCACHEPOINTS);
+        }
+
+        *e = (NavCacheEntry){
+            .from = start, .to = goal,
+            .start = nav->numcachepoints, .len = len
+        };
+        nav->numcachepoints += len;
+    }
+
+    int n = MIN(e->len, maxpoints);
+    memcpy(points, nav->cachepoints + e->start, sizeof(Vector) * n);
+
+    // Cached paths end at the center of the goal cell.
+    if (n == e->len) {
+        points[n - 1] = to;
+    }
+
+    return n;
+}
+
+
+void N_Save(NavGrid *nav, const char *path) {
+    FILE *f = fopen(path, "wb");
+    check(f, "Can't write navigation grid %s", path);
+    if (!f) return;
+
+    uint32_t magic = NAVMAGIC;
+    fwrite(&magic, sizeof(magic), 1, f);
+    fwrite(&nav->maphash, sizeof(nav->maphash), 1, f);
+    fwrite(&nav->radius, sizeof(nav->radius), 1, f);
+    fwrite(&nav->cellsize, sizeof(nav->cellsize), 1, f);
+    fwrite(&nav->origin, sizeof(nav->origin), 1, f);
+    fwrite(&nav->width, sizeof(nav->width), 1, f);
+    fwrite(&nav->height, sizeof(nav->height), 1, f);
+    fwrite(nav->blocked, 1, nav->width * nav->height, f);
+
+    fclose(f);
+}
+
+
+NavGrid *N_Load(const char *path, Map *map, double radius, double cellsize,
+        Arena *arena) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    uint32_t magic = 0;
+    uint64_t maphash = 0;
+    double r = 0, cs = 0;
+    Vector origin;
+    int width = 0, height = 0;
+
+    fread(&magic, sizeof(magic), 1, f);
+    fread(&maphash, sizeof(maphash), 1, f);
+    fread(&r, sizeof(r), 1, f);
+    fread(&cs, sizeof(cs), 1, f);
+    fread(&origin, sizeof(origin), 1, f);
+    fread(&width, sizeof(width), 1, f);
+    fread(&height, sizeof(height), 1, f);
+
+    if (magic != NAVMAGIC || maphash != M_Hash(map) ||
+            r != radius || cs != cellsize || width <= 0 || height <= 0) {
+        debug("Stale navigation grid %s", path);
+        fclose(f);
+        return NULL;
+    }
+
+    NavGrid *nav = AllocGrid(width, height, arena);
+    nav->origin = origin;
+    nav->cellsize = cellsize;
+    nav->radius = radius;
+    nav->maphash = maphash;
+
+    size_t read = fread(nav->blocked, 1, width * height, f);
+    fclose(f);
+
+    if (read != width * height) {
+        debug("Truncated navigation grid %s", path);
+        N_Delete(nav);
+        return NULL;
+    }
+
+    FindRegions(nav);
+
+    return nav;
+}
@@ -0,0 +1,95 @@
+//------------------------------------------------------------------------------
+// Navigation grid and path finding
+//
+// The map is rasterized into a grid of cells. A cell is blocked if a Mobile of
+// the given radius centered on it would touch a wall. Paths are found with jump
+// point search, an A* that skips over the cells of straight runs, and cached
+// until the grid changes. Goals in another region than the start, with no path
+// at all, are turned down without searching.
+//------------------------------------------------------------------------------
+#ifndef _NAV_
+#define _NAV_
+
+#include <stdint.h>
+
+#include "arena.h"
+#include "geometry.h"
+#include "map.h"
+
+typedef struct NavCacheEntry {
+    int from, to;       // Cell indices, -1 if the entry is empty
+    int start, len;     // Waypoints in NavGrid.cachepoints
+} NavCacheEntry;
+
+// A cell in the open list, with its keys at hand to compare.
+typedef struct NavOpen {
+    float f;            // g plus the heuristic
+    float g;            // Cost from the start cell
+    int cell;
+} NavOpen;
+
+typedef struct NavGrid {
+    Vector origin;      // World position of the top-left corner of cell (0, 0)
+    double cellsize;
+    double radius;      // Radius the walls have been inflated by
+    int width, height;  // In cells
+    uint64_t maphash;   // M_Hash() of the map the grid was built from
+
+    uint8_t *blocked;   // 1 if the cell can't be walked
+    int *region;        // Cells reach each other only in the same region, -1
+                        // for blocked ones
+
+    // Search state. Allocated once, reused by every query.
+    float *g;           // Cost from the start cell
+    int *parent;
+    NavOpen *heap;      // Binary heap of cells in the open list...
+    int *heappos;       // ... and the position of each cell in it
+    uint32_t *visited;  // Search in which the cell was last touched
+    uint32_t search;
+
+    // Path cache
+    NavCacheEntry *cache;
+    Vector *cachepoints;
+    int numcachepoints;
+
+    Arena *arena;       // Where the grid was allocated, NULL for the heap.
+} NavGrid;
+
+
+// Builds the navigation grid of map for a Mobile of the given radius,
+// allocating it from arena.
+// cellsize should be at most radius, or paths might clip wall corners.
+NavGrid *N_Build(Map *map, double radius, double cellsize, Arena *arena);
+
+// Returns a copy of the cells of nav, allocated from arena, with an empty
+// path cache.
+NavGrid *N_Copy(NavGrid *nav, Arena *arena);
+
+// Recomputes the blocked cells whose center is inside box, and invalidates the
+// path cache. Use it after walls inside box change.
+void N_UpdateRegion(NavGrid *nav, Map *map, Box box);
+
+// Drops all the cached paths.
+void N_Invalidate(NavGrid *nav);
+
+// Free a NavGrid. Does nothing for grids allocated from an arena.
+void N_Delete(NavGrid *nav);
+
+// Returns 1 if a Mobile of radius nav->radius can stand at p, 0 otherwise.
+int N_IsWalkable(NavGrid *nav, Vector p);
+
+// Finds a path from `from` to `to` and stores at most maxpoints of its
+// waypoints in points. The last waypoint is `to` itself.
+//
+// Returns the number of waypoints stored, 0 if there's no path.
+int N_FindPath(NavGrid *nav, Vector from, Vector to, Vector *points, int maxpoints);
+
+// Writes nav to path, so it doesn't need to be built again.
+void N_Save(NavGrid *nav, const char *path);
+
+// Loads the grid stored in path. Returns NULL if it can't be read or it
+// wasn't built for map with the same radius and cellsize.
+NavGrid *N_Load(const char *path, Map *map, double radius, double cellsize,
+        Arena *arena);
+
+#endif
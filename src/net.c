@@ -0,0 +1,584 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "dbg.h"
+#include "defs.h"
+#include "net.h"
+
+// Packet types
+#define NET_INPUT 1
+#define NET_BYE 2
+#define NET_SNAPSHOT 3
+
+// What changed about a player in a delta
+#define NET_POS 1
+#define NET_VEL 2
+#define NET_FORWARD 4
+#define NET_RADIUS 8
+#define NET_GONE 16
+
+
+//------------------------------------------------------------------------------
+// Encoding
+//------------------------------------------------------------------------------
+
+// A buffer being written or read. Going past its end sets error instead.
+typedef struct Packet {
+    uint8_t *data;
+    int len;        // Written or read so far
+    int size;
+    int error;
+} Packet;
+
+
+static void Put(Packet *p, const void *v, int n) {
+    if (p->len + n > p->size) {
+        p->error = 1;
+        return;
+    }
+
+    memcpy(p->data + p->len, v, n);
+    p->len += n;
+}
+
+
+static void Get(Packet *p, void *v, int n) {
+    if (p->len + n > p->size) {
+        p->error = 1;
+        memset(v, 0, n);
+        return;
+    }
+
+    memcpy(v, p->data + p->len, n);
+    p->len += n;
+}
+
+
+static void PutVector(Packet *p, Vector v) {
+    float f[2] = { v.x, v.y };
+    Put(p, f, sizeof(f));
+}
+
+
+static Vector GetVector(Packet *p) {
+    float f[2];
+    Get(p, f, sizeof(f));
+    return (Vector){ f[0], f[1] };
+}
+
+
+static int SameVector(Vector a, Vector b) {
+    return a.x == b.x && a.y == b.y;
+}
+
+
+// Rounds x to a float. Through memory, as some versions of GCC lose the
+// rounding when they vectorize Nt_Quantize().
+static double Round(double x) {
+    volatile float f = x;
+    return f;
+}
+
+
+static Vector QuantizeVector(Vector v) {
+    return (Vector){ Round(v.x), Round(v.y) };
+}
+
+
+Mobile Nt_Quantize(Mobile mob) {
+    return (Mobile){
+        .pos = QuantizeVector(mob.pos),
+        .vel = QuantizeVector(mob.vel),
+        .forward = QuantizeVector(mob.forward),
+        .radius = Round(mob.radius),
+    };
+}
+
+
+int Nt_WriteDelta(uint8_t *buf, int size, const NetState *base,
+        const NetState *state) {
+    static const NetState empty;
+    if (!base) base = &empty;
+
+    Packet p = { .data = buf, .size = size };
+
+    // Filled in at the end
+    uint16_t count = 0;
+    Put(&p, &count, sizeof(count));
+
+    for (int i = 0; i < MAXPEERS; i++) {
+        const Mobile *a = &base->mobs[i], *b = &state->mobs[i];
+        uint8_t fields = 0;
+
+        if (!state->present[i]) {
+            if (base->present[i]) fields = NET_GONE;
+        } else if (!base->present[i]) {
+            fields = NET_POS | NET_VEL | NET_FORWARD | NET_RADIUS;
+        } else {
+            if (!SameVector(a->pos, b->pos)) fields |= NET_POS;
+            if (!SameVector(a->vel, b->vel)) fields |= NET_VEL;
+            if (!SameVector(a->forward, b->forward)) fields |= NET_FORWARD;
+            if (a->radius != b->radius) fields |= NET_RADIUS;
+        }
+
+        if (!fields) continue;
+
+        uint8_t id = i;
+        Put(&p, &id, sizeof(id));
+        Put(&p, &fields, sizeof(fields));
+
+        if (fields & NET_POS) PutVector(&p, b->pos);
+        if (fields & NET_VEL) PutVector(&p, b->vel);
+        if (fields & NET_FORWARD) PutVector(&p, b->forward);
+        if (fields & NET_RADIUS) {
+            float r = b->radius;
+            Put(&p, &r, sizeof(r));
+        }
+        count++;
+    }
+
+    if (p.error) return -1;
+
+    memcpy(buf, &count, sizeof(count));
+    return p.len;
+}
+
+
+int Nt_ReadDelta(const uint8_t *buf, int len, const NetState *base,
+        NetState *state) {
+    if (base) {
+        *state = *base;
+    } else {
+        memset(state, 0, sizeof(*state));
+    }
+
+    Packet p = { .data = (uint8_t *)buf, .size = len };
+
+    uint16_t count;
+    Get(&p, &count, sizeof(count));
+
+    for (int i = 0; i < count && !p.error; i++) {
+        uint8_t id, fields;
+        Get(&p, &id, sizeof(id));
+        Get(&p, &fields, sizeof(fields));
+
+        Mobile *mob = &state->mobs[id];
+
+        if (fields & NET_GONE) {
+            state->present[id] = 0;
+            continue;
+        }
+
+        state->present[id] = 1;
+        if (fields & NET_POS) mob->pos = GetVector(&p);
+        if (fields & NET_VEL) mob->vel = GetVector(&p);
+        if (fields & NET_FORWARD) mob->forward = GetVector(&p);
+        if (fields & NET_RADIUS) {
+            float r;
+            Get(&p, &r, sizeof(r));
+            mob->radius = r;
+        }
+    }
+
+    return p.error ? -1 : p.len;
+}
+
+
+// Ticks are sent in 5 bytes, ticks that don't fit are clamped.
+static Tick ClampTick(Tick t) {
+    return (Tick){
+        .forward = CLAMP(t.forward, -1, 1),
+        .strafe = CLAMP(t.strafe, -1, 1),
+        .turn = CLAMP(t.turn, -1, 1),
+        .relative_mouse_x = CLAMP(t.relative_mouse_x, INT16_MIN, INT16_MAX),
+    };
+}
+
+
+static void PutTick(Packet *p, Tick t) {
+    int8_t keys[3] = { t.forward, t.strafe, t.turn };
+    int16_t mouse = t.relative_mouse_x;
+    Put(p, keys, sizeof(keys));
+    Put(p, &mouse, sizeof(mouse));
+}
+
+
+static Tick GetTick(Packet *p) {
+    int8_t keys[3];
+    int16_t mouse;
+    Get(p, keys, sizeof(keys));
+    Get(p, &mouse, sizeof(mouse));
+
+    return (Tick){ keys[0], keys[1], keys[2], mouse };
+}
+
+
+// Returns a non blocking UDP socket.
+static int OpenSocket() {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    check(sock >= 0, "Can't open socket");
+    if (sock < 0) return -1;
+
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+
+    return sock;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Server
+//------------------------------------------------------------------------------
+
+NetServer *Nt_Listen(int port, Map *map, const Movement *m, Mobile spawn) {
+    NetServer *s = calloc(1, sizeof(NetServer));
+    check_mem(s);
+
+    s->map = map;
+    s->movement = *m;
+    s->spawn = Nt_Quantize(spawn);
+
+    s->sock = OpenSocket();
+    if (s->sock < 0) goto error;
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (bind(s->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        log_err("Can't listen on port %d", port);
+        close(s->sock);
+        goto error;
+    }
+
+    return s;
+
+error:
+    free(s);
+    return NULL;
+}
+
+
+void Nt_CloseServer(NetServer *s) {
+    close(s->sock);
+    free(s);
+}
+
+
+static int FindPeer(NetServer *s, struct sockaddr_in *addr) {
+    for (int i = 0; i < MAXPEERS; i++) {
+        NetPeer *peer = &s->peers[i];
+        if (peer->active && peer->addr.sin_port == addr->sin_port &&
+                peer->addr.sin_addr.s_addr == addr->sin_addr.s_addr) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+static int AddPeer(NetServer *s, struct sockaddr_in *addr) {
+    for (int i = 0; i < MAXPEERS; i++) {
+        NetPeer *peer = &s->peers[i];
+        if (peer->active) continue;
+
+        *peer = (NetPeer){
+            .active = 1,
+            .addr = *addr,
+            .heard = s->seq,
+        };
+        s->mobs[i] = s->spawn;
+        s->numpeers++;
+
+        return i;
+    }
+
+    log_warn("Server full, ignoring %s:%d", inet_ntoa(addr->sin_addr),
+            ntohs(addr->sin_port));
+    return -1;
+}
+
+
+static void RemovePeer(NetServer *s, int id) {
+    s->peers[id].active = 0;
+    s->numpeers--;
+}
+
+
+// Applies the inputs in p the peer id hasn't had yet, oldest first.
+static void ApplyInputs(NetServer *s, int id, Packet *p) {
+    NetPeer *peer = &s->peers[id];
+
+    uint32_t acked, seq;
+    uint8_t count;
+    Get(p, &acked, sizeof(acked));
+    Get(p, &seq, sizeof(seq));
+    Get(p, &count, sizeof(count));
+
+    Tick ticks[NETREDUNDANCY];
+    count = MIN(count, NETREDUNDANCY);
+    for (int i = 0; i < count; i++) {
+        ticks[i] = GetTick(p);
+    }
+    if (p->error) return;
+
+    if (acked > peer->acked && acked <= s->seq) peer->acked = acked;
+    peer->heard = s->seq;
+
+    // ticks[i] is input seq - i
+    for (int i = count - 1; i >= 0; i--) {
+        if (seq - i <= peer->applied) continue;
+
+        P_Move(&s->mobs[id], s->map, &s->movement, ticks[i]);
+        s->mobs[id] = Nt_Quantize(s->mobs[id]);
+    }
+
+    peer->applied = MAX(peer->applied, seq);
+}
+
+
+void Nt_Receive(NetServer *s) {
+    uint8_t buf[NETMAXPACKET];
+
+    while (1) {
+        struct sockaddr_in addr;
+        socklen_t addrlen = sizeof(addr);
+
+        int len = recvfrom(s->sock, buf, sizeof(buf), 0,
+                (struct sockaddr *)&addr, &addrlen);
+        if (len <= 0) break;
+
+        Packet p = { .data = buf, .size = len };
+        uint8_t type;
+        Get(&p, &type, sizeof(type));
+
+        int id = FindPeer(s, &addr);
+
+        if (type == NET_BYE) {
+            if (id >= 0) RemovePeer(s, id);
+            continue;
+        }
+
+        if (type != NET_INPUT) continue;
+
+        if (id < 0) id = AddPeer(s, &addr);
+        if (id < 0) continue;
+
+        s->peers[id].received += len;
+        s->received += len;
+        ApplyInputs(s, id, &p);
+    }
+}
+
+
+void Nt_SendSnapshots(NetServer *s) {
+    s->seq++;
+
+    // Clients that are gone
+    for (int i = 0; i < MAXPEERS; i++) {
+        if (s->peers[i].active && s->seq - s->peers[i].heard > NETTIMEOUT) {
+            log_info("Client %d timed out", i);
+            RemovePeer(s, i);
+        }
+    }
+
+    NetState *state = &s->history[s->seq % NETHISTORY];
+    state->seq = s->seq;
+    for (int i = 0; i < MAXPEERS; i++) {
+        state->present[i] = s->peers[i].active;
+        state->mobs[i] = s->peers[i].active ? s->mobs[i] : (Mobile){{0}};
+    }
+
+    uint8_t buf[NETMAXPACKET];
+
+    for (int i = 0; i < MAXPEERS; i++) {
+        NetPeer *peer = &s->peers[i];
+        if (!peer->active) continue;
+
+        // Deltas are from the last snapshot the client has, if we still have
+        // it too.
+        NetState *base = &s->history[peer->acked % NETHISTORY];
+        if (!peer->acked || base->seq != peer->acked) base = NULL;
+
+        Packet p = { .data = buf, .size = sizeof(buf) };
+        uint8_t type = NET_SNAPSHOT, id = i;
+        uint32_t baseseq = base ? base->seq : 0;
+        Put(&p, &type, sizeof(type));
+        Put(&p, &s->seq, sizeof(s->seq));
+        Put(&p, &baseseq, sizeof(baseseq));
+        Put(&p, &id, sizeof(id));
+        Put(&p, &peer->applied, sizeof(peer->applied));
+
+        int len = Nt_WriteDelta(buf + p.len, p.size - p.len, base, state);
+        check(len >= 0, "Snapshot too big for client %d", i);
+        if (len < 0) continue;
+        p.len += len;
+
+        sendto(s->sock, buf, p.len, 0, (struct sockaddr *)&peer->addr,
+                sizeof(peer->addr));
+        peer->sent += p.len;
+        s->sent += p.len;
+    }
+}
+
+
+
+//------------------------------------------------------------------------------
+// Client
+//------------------------------------------------------------------------------
+
+NetClient *Nt_Connect(const char *host, int port) {
+    NetClient *c = calloc(1, sizeof(NetClient));
+    check_mem(c);
+
+    c->id = -1;
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    if (!inet_aton(host, &addr.sin_addr)) {
+        log_err("Bad server address %s", host);
+        goto error;
+    }
+
+    c->sock = OpenSocket();
+    if (c->sock < 0) goto error;
+
+    // Only packets from the server get through.
+    if (connect(c->sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        log_err("Can't connect to %s:%d", host, port);
+        close(c->sock);
+        goto error;
+    }
+
+    return c;
+
+error:
+    free(c);
+    return NULL;
+}
+
+
+void Nt_Disconnect(NetClient *c) {
+    uint8_t type = NET_BYE;
+    send(c->sock, &type, sizeof(type), 0);
+
+    close(c->sock);
+    free(c);
+}
+
+
+void Nt_SendInput(NetClient *c, Tick t) {
+    c->seq++;
+    c->inputs[c->seq % NETHISTORY] = ClampTick(t);
+
+    uint8_t buf[64];
+    Packet p = { .data = buf, .size = sizeof(buf) };
+
+    uint8_t type = NET_INPUT;
+    uint32_t acked = c->latest ? c->latest->seq : 0;
+    uint8_t count = MIN(c->seq, NETREDUNDANCY);
+    Put(&p, &type, sizeof(type));
+    Put(&p, &acked, sizeof(acked));
+    Put(&p, &c->seq, sizeof(c->seq));
+    Put(&p, &count, sizeof(count));
+    for (int i = 0; i < count; i++) {
+        PutTick(&p, c->inputs[(c->seq - i) % NETHISTORY]);
+    }
+
+    send(c->sock, buf, p.len, 0);
+    c->sent += p.len;
+}
+
+
+// Reads the snapshot in p. Returns 1 if it's the newest.
+static int ReadSnapshot(NetClient *c, Packet *p) {
+    uint32_t seq, baseseq, applied;
+    uint8_t id;
+    Get(p, &seq, sizeof(seq));
+    Get(p, &baseseq, sizeof(baseseq));
+    Get(p, &id, sizeof(id));
+    Get(p, &applied, sizeof(applied));
+    if (p->error) return 0;
+
+    // Old news
+    if (c->latest && seq <= c->latest->seq) return 0;
+
+    NetState *base = NULL;
+    if (baseseq) {
+        base = &c->states[baseseq % NETHISTORY];
+        if (base->seq != baseseq) return 0;
+    }
+
+    NetState state;
+    if (Nt_ReadDelta(p->data + p->len, p->size - p->len, base, &state) < 0) {
+        return 0;
+    }
+    state.seq = seq;
+
+    // Did the server get where we predicted?
+    if (applied > c->applied && applied <= c->lastpredicted &&
+            c->seq - applied < NETHISTORY) {
+        Mobile *p = &c->predicted[applied % NETHISTORY];
+        Mobile *s = &state.mobs[id];
+        if (!SameVector(p->pos, s->pos) || !SameVector(p->vel, s->vel) ||
+                !SameVector(p->forward, s->forward)) {
+            c->mispredictions++;
+        }
+    }
+
+    c->states[seq % NETHISTORY] = state;
+    c->latest = &c->states[seq % NETHISTORY];
+    c->id = id;
+    c->applied = applied;
+
+    return 1;
+}
+
+
+int Nt_ReceiveSnapshots(NetClient *c) {
+    uint8_t buf[NETMAXPACKET];
+    int newer = 0;
+
+    int len;
+    while ((len = recv(c->sock, buf, sizeof(buf), 0)) > 0) {
+        c->received += len;
+
+        Packet p = { .data = buf, .size = len };
+        uint8_t type;
+        Get(&p, &type, sizeof(type));
+
+        if (type == NET_SNAPSHOT) {
+            newer |= ReadSnapshot(c, &p);
+        }
+    }
+
+    return newer;
+}
+
+
+int Nt_Predict(NetClient *c, Map *map, const Movement *m, Mobile *mob) {
+    if (!c->latest) return 0;
+
+    *mob = c->latest->mobs[c->id];
+
+    // Inputs older than that are forgotten, the prediction falls short.
+    uint32_t first = c->applied + 1;
+    if (c->seq - c->applied > NETHISTORY) first = c->seq - NETHISTORY + 1;
+
+    for (uint32_t seq = first; seq <= c->seq; seq++) {
+        P_Move(mob, map, m, c->inputs[seq % NETHISTORY]);
+        *mob = Nt_Quantize(*mob);
+        c->predicted[seq % NETHISTORY] = *mob;
+    }
+    c->lastpredicted = c->seq;
+
+    return 1;
+}
@@ -0,0 +1,162 @@
+//------------------------------------------------------------------------------
+// Multiplayer over UDP
+//
+// The server is authoritative: clients send it their input, one Tick per
+// simulation step, and it moves their players and sends back snapshots of
+// every player. Each packet carries the last few inputs too, so a lost one
+// doesn't lose a step.
+//
+// Snapshots are deltas from the last snapshot the client acknowledged, so only
+// the players that changed since then are sent. Players are quantized to
+// floats after every step, by the server and by the clients alike, so what's
+// sent is exactly what's simulated.
+//
+// Clients predict their own player by applying the inputs the server hasn't
+// yet to the player in the latest snapshot.
+//
+// Packets are in host byte order: this is meant for localhost.
+//------------------------------------------------------------------------------
+#ifndef _NET_
+#define _NET_
+
+#include <netinet/in.h>
+#include <stdint.h>
+
+#include "collision.h"
+#include "map.h"
+#include "player.h"
+
+#define NETPORT 27960
+#define MAXPEERS 256        // Players per server
+#define NETHISTORY 32       // Snapshots and inputs kept to delta against
+#define NETREDUNDANCY 4     // Inputs in every input packet
+#define NETTIMEOUT 300      // Server ticks without news before a client is dropped
+#define NETMAXPACKET 16384
+
+// Every player at one point in time.
+typedef struct NetState {
+    uint32_t seq;               // Snapshot number, 0 if empty
+    uint8_t present[MAXPEERS];  // Whether each player is in the game
+    Mobile mobs[MAXPEERS];
+} NetState;
+
+
+//------------------------------------------------------------------------------
+// Server
+//------------------------------------------------------------------------------
+
+typedef struct NetPeer {
+    int active;
+    struct sockaddr_in addr;
+    uint32_t applied;   // Newest input applied
+    uint32_t acked;     // Newest snapshot the client has
+    uint32_t heard;     // Snapshot sent when it was last heard from
+
+    uint64_t sent, received;    // Bytes
+} NetPeer;
+
+typedef struct NetServer {
+    int sock;
+
+    Map *map;
+    Movement movement;
+    Mobile spawn;       // Where new players start
+
+    NetPeer peers[MAXPEERS];
+    Mobile mobs[MAXPEERS];
+    int numpeers;
+
+    uint32_t seq;       // Snapshots sent so far
+    NetState history[NETHISTORY];   // The last ones, by seq % NETHISTORY
+
+    uint64_t sent, received;    // Bytes, to and from every client
+} NetServer;
+
+
+// Starts a server on the localhost port given, where players move with m in
+// map, which must outlive it.
+//
+// Returns NULL if the port can't be used.
+NetServer *Nt_Listen(int port, Map *map, const Movement *m, Mobile spawn);
+
+// Closes the port and frees s.
+void Nt_CloseServer(NetServer *s);
+
+// Applies every input received since the last call. New clients join when
+// their first input arrives. Never blocks.
+void Nt_Receive(NetServer *s);
+
+// Sends every client a snapshot of all the players, and drops the clients
+// that haven't been heard from in NETTIMEOUT snapshots.
+void Nt_SendSnapshots(NetServer *s);
+
+
+
+//------------------------------------------------------------------------------
+// Client
+//------------------------------------------------------------------------------
+
+typedef struct NetClient {
+    int sock;
+    int id;             // Our player in the snapshots, -1 until the first
+
+    uint32_t seq;       // Inputs sent so far
+    Tick inputs[NETHISTORY];        // The last ones, by seq % NETHISTORY
+    Mobile predicted[NETHISTORY];   // Our player after each of them...
+    uint32_t lastpredicted;         // ... up to this one
+
+    NetState states[NETHISTORY];    // The last snapshots, by seq % NETHISTORY
+    NetState *latest;   // NULL until the first
+    uint32_t applied;   // Newest input the server had applied in latest
+    int mispredictions; // Snapshots that didn't agree with the prediction
+
+    uint64_t sent, received;    // Bytes
+} NetClient;
+
+
+// Connects to the server at the IPv4 address host, port. Nothing is sent
+// until the first input.
+//
+// Returns NULL on errors.
+NetClient *Nt_Connect(const char *host, int port);
+
+// Tells the server we're leaving, and frees c.
+void Nt_Disconnect(NetClient *c);
+
+// Sends the input of the next step to the server.
+void Nt_SendInput(NetClient *c, Tick t);
+
+// Reads the snapshots received since the last call. Returns 1 if any was
+// newer than latest. Never blocks.
+int Nt_ReceiveSnapshots(NetClient *c);
+
+// Sets mob to our player in the latest snapshot, moved by the inputs the
+// server hadn't applied yet.
+//
+// Returns 0, leaving mob alone, if there's no snapshot yet.
+int Nt_Predict(NetClient *c, Map *map, const Movement *m, Mobile *mob);
+
+
+
+//------------------------------------------------------------------------------
+// Encoding
+//------------------------------------------------------------------------------
+
+// Returns mob with everything rounded to floats.
+Mobile Nt_Quantize(Mobile mob);
+
+// Writes the players that changed from base to state into buf, which is size
+// bytes long. base can be NULL to write every player.
+//
+// Returns the bytes written, or -1 if they don't fit.
+int Nt_WriteDelta(uint8_t *buf, int size, const NetState *base,
+        const NetState *state);
+
+// Reads a delta written by Nt_WriteDelta() from buf, len bytes long, applying
+// it to base (or to no players, if NULL) into state.
+//
+// Returns the bytes read, or -1 if buf is malformed.
+int Nt_ReadDelta(const uint8_t *buf, int len, const NetState *base,
+        NetState *state);
+
+#endif
@@ -0,0 +1,299 @@
+#include <string.h>
+
+#include "color.h"
+#include "defs.h"
+#include "pixops.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PX_X86
+#include <immintrin.h>
+#endif
+
+
+//------------------------------------------------------------------------------
+// Scalar
+//------------------------------------------------------------------------------
+
+static void FillScalar(uint32_t *dst, uint32_t color, int n) {
+    for (int i = 0; i < n; i++) {
+        dst[i] = color;
+    }
+}
+
+
+static void CopyKeyScalar(uint32_t *dst, const uint32_t *src, int n, uint32_t key) {
+    for (int i = 0; i < n; i++) {
+        if (src[i] != key) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+
+// intensity is fixed point, 256 is 1.
+static void ScaleScalar(uint32_t *dst, const uint32_t *src, int n, uint32_t intensity) {
+    for (int i = 0; i < n; i++) {
+        uint32_t c = src[i];
+        dst[i] = BUILDRGB(
+                (GETR(c) * intensity) >> 8,
+                (GETG(c) * intensity) >> 8,
+                (GETB(c) * intensity) >> 8);
+    }
+}
+
+
+static void ConvertARGBScalar(uint32_t *dst, const uint32_t *src, int n) {
+    for (int i = 0; i < n; i++) {
+        uint32_t c = src[i];
+        dst[i] = BUILDRGB((c >> 16) & 0xFF, (c >> 8) & 0xFF, c & 0xFF);
+    }
+}
+
+
+
+#ifdef PX_X86
+//------------------------------------------------------------------------------
+// SSE2
+//------------------------------------------------------------------------------
+
+__attribute__((target("sse2")))
+static void FillSSE2(uint32_t *dst, uint32_t color, int n) {
+    __m128i c = _mm_set1_epi32(color);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_si128((__m128i *)&dst[i], c);
+    }
+
+    FillScalar(dst + i, color, n - i);
+}
+
+
+__attribute__((target("sse2")))
+static void CopyKeySSE2(uint32_t *dst, const uint32_t *src, int n, uint32_t key) {
+    __m128i k = _mm_set1_epi32(key);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+        __m128i d = _mm_loadu_si128((const __m128i *)&dst[i]);
+        __m128i transparent = _mm_cmpeq_epi32(s, k);
+
+        // (transparent & d) | (~transparent & s)
+        __m128i r = _mm_or_si128(
+                _mm_and_si128(transparent, d),
+                _mm_andnot_si128(transparent, s));
+
+        _mm_storeu_si128((__m128i *)&dst[i], r);
+    }
+
+    CopyKeyScalar(dst + i, src + i, n - i, key);
+}
+
+
+__attribute__((target("sse2")))
+static void ScaleSSE2(uint32_t *dst, const uint32_t *src, int n, uint32_t intensity) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i k = _mm_set1_epi16(intensity);
+    __m128i rgb = _mm_set1_epi32(0xFFFFFF);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+
+        // Widen the channels to 16 bits, multiply and narrow them back.
+        __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), k), 8);
+        __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), k), 8);
+
+        __m128i r = _mm_and_si128(_mm_packus_epi16(lo, hi), rgb);
+        _mm_storeu_si128((__m128i *)&dst[i], r);
+    }
+
+    ScaleScalar(dst + i, src + i, n - i, intensity);
+}
+
+
+__attribute__((target("sse2")))
+static void ConvertARGBSSE2(uint32_t *dst, const uint32_t *src, int n) {
+    __m128i byte = _mm_set1_epi32(0xFF);
+    __m128i green = _mm_set1_epi32(0xFF00);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)&src[i]);
+
+        __m128i r = _mm_and_si128(_mm_srli_epi32(s, 16), byte);
+        __m128i g = _mm_and_si128(s, green);
+        __m128i b = _mm_slli_epi32(_mm_and_si128(s, byte), 16);
+
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_or_si128(_mm_or_si128(r, g), b));
+    }
+
+    ConvertARGBScalar(dst + i, src + i, n - i);
+}
+
+
+
+//------------------------------------------------------------------------------
+// AVX2
+//------------------------------------------------------------------------------
+
+__attribute__((target("avx2")))
+static void FillAVX2(uint32_t *dst, uint32_t color, int n) {
+    __m256i c = _mm256_set1_epi32(color);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256((__m256i *)&dst[i], c);
+    }
+
+    FillScalar(dst + i, color, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static void CopyKeyAVX2(uint32_t *dst, const uint32_t *src, int n, uint32_t key) {
+    __m256i k = _mm256_set1_epi32(key);
+    __m256i ones = _mm256_set1_epi32(-1);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)&src[i]);
+        __m256i opaque = _mm256_xor_si256(_mm256_cmpeq_epi32(s, k), ones);
+
+        // Only the opaque pixels are written, dst isn't even read.
+        _mm256_maskstore_epi32((int *)&dst[i], opaque, s);
+    }
+
+    CopyKeyScalar(dst + i, src + i, n - i, key);
+}
+
+
+__attribute__((target("avx2")))
+static void ScaleAVX2(uint32_t *dst, const uint32_t *src, int n, uint32_t intensity) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i k = _mm256_set1_epi16(intensity);
+    __m256i rgb = _mm256_set1_epi32(0xFFFFFF);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)&src[i]);
+
+        // unpack and pack work within 128 bit lanes, so the order is kept.
+        __m256i lo = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero), k), 8);
+        __m256i hi = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero), k), 8);
+
+        __m256i r = _mm256_and_si256(_mm256_packus_epi16(lo, hi), rgb);
+        _mm256_storeu_si256((__m256i *)&dst[i], r);
+    }
+
+    ScaleScalar(dst + i, src + i, n - i, intensity);
+}
+
+
+__attribute__((target("avx2")))
+static void ConvertARGBAVX2(uint32_t *dst, const uint32_t *src, int n) {
+    // Per 32 bit pixel: bytes B G R A -> R G B 0
+    __m256i shuffle = _mm256_setr_epi8(
+            2, 1, 0, -1,  6, 5, 4, -1,  10, 9, 8, -1,  14, 13, 12, -1,
+            2, 1, 0, -1,  6, 5, 4, -1,  10, 9, 8, -1,  14, 13, 12, -1);
+
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)&src[i]);
+        _mm256_storeu_si256((__m256i *)&dst[i], _mm256_shuffle_epi8(s, shuffle));
+    }
+
+    ConvertARGBScalar(dst + i, src + i, n - i);
+}
+#endif
+
+
+
+//------------------------------------------------------------------------------
+// Dispatch
+//------------------------------------------------------------------------------
+
+static struct {
+    void (*fill)(uint32_t *, uint32_t, int);
+    void (*copykey)(uint32_t *, const uint32_t *, int, uint32_t);
+    void (*scale)(uint32_t *, const uint32_t *, int, uint32_t);
+    void (*convertargb)(uint32_t *, const uint32_t *, int);
+} ops;
+
+
+PXLevel PX_BestLevel() {
+#ifdef PX_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return PX_AVX2;
+    if (__builtin_cpu_supports("sse2")) return PX_SSE2;
+#endif
+    return PX_SCALAR;
+}
+
+
+void PX_UseLevel(PXLevel level) {
+    level = MIN(level, PX_BestLevel());
+
+    switch (level) {
+#ifdef PX_X86
+        case PX_AVX2:
+            ops.fill = FillAVX2;
+            ops.copykey = CopyKeyAVX2;
+            ops.scale = ScaleAVX2;
+            ops.convertargb = ConvertARGBAVX2;
+            break;
+
+        case PX_SSE2:
+            ops.fill = FillSSE2;
+            ops.copykey = CopyKeySSE2;
+            ops.scale = ScaleSSE2;
+            ops.convertargb = ConvertARGBSSE2;
+            break;
+#endif
+
+        default:
+            ops.fill = FillScalar;
+            ops.copykey = CopyKeyScalar;
+            ops.scale = ScaleScalar;
+            ops.convertargb = ConvertARGBScalar;
+            break;
+    }
+}
+
+
+void PX_Init() {
+    if (!ops.fill) PX_UseLevel(PX_BestLevel());
+}
+
+
+#define DISPATCH(op) if (!ops.op) PX_UseLevel(PX_BestLevel())
+
+void PX_Fill(uint32_t *dst, uint32_t color, int n) {
+    DISPATCH(fill);
+    ops.fill(dst, color, n);
+}
+
+
+// memcpy is already as vectorized as it gets.
+void PX_Copy(uint32_t *dst, const uint32_t *src, int n) {
+    memcpy(dst, src, sizeof(uint32_t) * n);
+}
+
+
+void PX_CopyKey(uint32_t *dst, const uint32_t *src, int n, uint32_t key) {
+    DISPATCH(copykey);
+    ops.copykey(dst, src, n, key);
+}
+
+
+void PX_Scale(uint32_t *dst, const uint32_t *src, int n, double intensity) {
+    DISPATCH(scale);
+    ops.scale(dst, src, n, CLAMP(intensity, 0, 1) * 256);
+}
+
+
+void PX_ConvertARGB(uint32_t *dst, const uint32_t *src, int n) {
+    DISPATCH(convertargb);
+    ops.convertargb(dst, src, n);
+}
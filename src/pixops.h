@@ -0,0 +1,46 @@
+//------------------------------------------------------------------------------
+// Operations over runs of pixels
+//
+// Every operation has a scalar, an SSE2 and an AVX2 version. The best one
+// supported by the CPU is picked the first time it's called.
+//------------------------------------------------------------------------------
+#ifndef _PIXOPS_
+#define _PIXOPS_
+
+#include <stdint.h>
+
+typedef enum PXLevel {
+    PX_SCALAR,
+    PX_SSE2,
+    PX_AVX2,
+} PXLevel;
+
+
+// Sets n pixels of dst to color.
+void PX_Fill(uint32_t *dst, uint32_t color, int n);
+
+// Copies n pixels from src to dst.
+void PX_Copy(uint32_t *dst, const uint32_t *src, int n);
+
+// Copies the n pixels of src that aren't key to dst.
+void PX_CopyKey(uint32_t *dst, const uint32_t *src, int n, uint32_t key);
+
+// Stores in dst the n pixels of src with their brightness scaled by
+// intensity, between 0 and 1.
+void PX_Scale(uint32_t *dst, const uint32_t *src, int n, double intensity);
+
+// Converts n pixels from 0xAARRGGBB (SDL's ARGB8888) to BUILDRGB() colors.
+void PX_ConvertARGB(uint32_t *dst, const uint32_t *src, int n);
+
+// Returns the best level supported by the CPU.
+PXLevel PX_BestLevel();
+
+// Picks the best level, unless one has been picked already. Calling it
+// before using the operations from several threads avoids racing to pick one.
+void PX_Init();
+
+// Forces the versions of the operations to use. Levels not supported by the
+// CPU fall back to the best one supported.
+void PX_UseLevel(PXLevel level);
+
+#endif
@@ -0,0 +1,97 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "collision.h"
+#include "config.h"
+#include "geometry.h"
+#include "player.h"
+
+const Movement p_defaultmovement = {
+    .speed = 6,
+    .accel = 1.5,
+    .friction = 0.2,
+    .turnspeed = 0.1,
+    .sensitivity = 0.002,
+};
+const double p_defaultradius = 8;
+
+
+void P_Move(Mobile *mob, Map *map, const Movement *m, Tick t) {
+    // Turning
+    if (t.turn) {
+        mob->forward = G_Rotate(mob->forward, t.turn * m->turnspeed);
+    }
+
+    if (t.relative_mouse_x) {
+        mob->forward = G_Rotate(mob->forward, t.relative_mouse_x * m->sensitivity);
+    }
+
+
+    // Acceleration
+    Vector side = G_Perpendicular(mob->forward);
+    Vector a = G_SetLength(
+            G_Sum(
+                G_Scale(t.forward, mob->forward),
+                G_Scale(t.strafe,  side)
+                ),
+            m->accel
+            );
+
+    if (t.forward || t.strafe) {
+        mob->vel = G_Sum(mob->vel, a);
+    } else {
+        mob->vel = G_Sub(mob->vel, G_Scale(m->friction, mob->vel));
+    }
+
+    if (G_Length(mob->vel) > m->speed) {
+        mob->vel = G_SetLength(mob->vel, m->speed);
+    }
+
+    // Translation
+    mob->pos = Co_Move(map, *mob).pos;
+}
+
+
+// The video settings are the engine's business, it binds them itself.
+static const CfVar settings[] = {
+    { "width", CF_INT, NULL, 16, 7680 },
+    { "height", CF_INT, NULL, 16, 4320 },
+    { "fov", CF_DOUBLE, NULL, 1, 179 },
+    { "near", CF_DOUBLE, NULL, 0.01, 100 },
+    { "far", CF_DOUBLE, NULL, 1, 100000 },
+    { "wallheight", CF_INT, NULL, 1, 4096 },
+    { "tickrate", CF_INT, NULL, 1, 1000 },      // The engine's ticktime is whole ms
+    { "speed", CF_DOUBLE, NULL, 0, 1000 },
+    { "accel", CF_DOUBLE, NULL, 0, 1000 },
+    { "friction", CF_DOUBLE, NULL, 0, 1 },
+    { "turnspeed", CF_DOUBLE, NULL, 0, 3.2 },
+    { "sensitivity", CF_DOUBLE, NULL, 0, 1 },
+    { "radius", CF_DOUBLE, NULL, 0.5, 256 },
+};
+_Static_assert(sizeof(settings) / sizeof(settings[0]) == P_NUMSETTINGS,
+        "P_NUMSETTINGS doesn't match the settings");
+
+
+int P_SettingsTable(CfVar *vars, Movement *m, double *radius, int *tickrate) {
+    memcpy(vars, settings, sizeof(settings));
+
+    Cf_Bind(vars, P_NUMSETTINGS, "tickrate", tickrate);
+    Cf_Bind(vars, P_NUMSETTINGS, "radius", radius);
+    if (m) {
+        Cf_Bind(vars, P_NUMSETTINGS, "speed", &m->speed);
+        Cf_Bind(vars, P_NUMSETTINGS, "accel", &m->accel);
+        Cf_Bind(vars, P_NUMSETTINGS, "friction", &m->friction);
+        Cf_Bind(vars, P_NUMSETTINGS, "turnspeed", &m->turnspeed);
+        Cf_Bind(vars, P_NUMSETTINGS, "sensitivity", &m->sensitivity);
+    }
+
+    return P_NUMSETTINGS;
+}
+
+
+int P_LoadSettings(const char *path, Movement *m, double *radius, int *tickrate) {
+    CfVar vars[P_NUMSETTINGS];
+    int numvars = P_SettingsTable(vars, m, radius, tickrate);
+
+    return Cf_Load(path, vars, numvars);
+}
@@ -0,0 +1,60 @@
+//------------------------------------------------------------------------------
+// Player movement
+//
+// The simulation of a player, driven by one Tick of input at a time. It
+// doesn't depend on where the input comes from: the keyboard, a replay, a
+// network client or a bot.
+//------------------------------------------------------------------------------
+#ifndef _PLAYER_
+#define _PLAYER_
+
+#include "collision.h"
+#include "config.h"
+#include "map.h"
+
+// A Tick contains all the input info needed to process one gametick.
+typedef struct Tick {
+    int forward;            // 1 forward, -1 backwards
+    int strafe;             // 1 right, -1 left
+    int turn;               // 1 clockwise, -1 anticlockwise
+    int relative_mouse_x;   // > 0 clockwise, < 0 anticlockwise
+} Tick;
+
+// How players move.
+typedef struct Movement {
+    double speed;           // Max movement speed
+    double accel;           // Movement acceleration
+    double friction;        // Friction
+    double turnspeed;       // Turning speed
+    double sensitivity;     // Mouse sensitivity
+} Movement;
+
+
+// Defaults of the settings of players, for the engine and the servers alike.
+extern const Movement p_defaultmovement;
+extern const double p_defaultradius;
+
+
+// Advances mob by one tick of input t, colliding with the walls in map.
+void P_Move(Mobile *mob, Map *map, const Movement *m, Tick t);
+
+// Every setting in the engine's configuration file, the one table the engine
+// and the servers read it with.
+#define P_NUMSETTINGS 13
+
+// Fills vars, which has room for P_NUMSETTINGS, with the settings of the
+// engine's configuration file. m, radius and tickrate are set by theirs, and
+// any of them can be NULL to skip it. The rest, like the video settings, set
+// nothing until Cf_Bind points them somewhere.
+//
+// Returns the number of settings.
+int P_SettingsTable(CfVar *vars, Movement *m, double *radius, int *tickrate);
+
+// Sets m, radius and tickrate from the configuration file in path, the
+// engine's, skipping its other settings. Any of them can be NULL to skip it
+// too. Settings not in the file keep their value.
+//
+// Returns 0 if the file can't be read, 1 otherwise.
+int P_LoadSettings(const char *path, Movement *m, double *radius, int *tickrate);
+
+#endif
@@ -0,0 +1,181 @@
+#define _GNU_SOURCE     // For dladdr()
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "dbg.h"
+#include "profile.h"
+
+// Frames of a sample that belong to the profiler: the handler, and the
+// trampoline the kernel returns from the signal through.
+#define SKIP 2
+
+#define MAXLINE 4096    // Characters in a folded stack
+
+// Samples, one after the other: the number of frames, then the frames,
+// innermost first. A sample that doesn't fit is dropped, and so is every one
+// after it, so unwritten entries are all NULL.
+static void **buf;
+static _Atomic size_t used;
+static _Atomic long samples, dropped;
+
+
+// Runs on whatever thread the timer interrupted. backtrace() is safe here
+// once it has been called outside of a handler, which loads the unwinder.
+static void Sample(int sig) {
+    (void)sig;
+    int saved = errno;
+
+    void *frames[PFMAXDEPTH + SKIP];
+    int depth = backtrace(frames, PFMAXDEPTH + SKIP) - SKIP;
+
+    if (depth > 0) {
+        size_t at = atomic_fetch_add_explicit(&used, depth + 1, memory_order_relaxed);
+        if (at + depth + 1 <= PFBUFLEN) {
+            memcpy(&buf[at + 1], &frames[SKIP], sizeof(void *) * depth);
+            buf[at] = (void *)(intptr_t)depth;
+            atomic_fetch_add_explicit(&samples, 1, memory_order_relaxed);
+        } else {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        }
+    }
+
+    errno = saved;
+}
+
+
+static void SetTimer(int hz) {
+    struct itimerval timer = {
+        .it_interval = { .tv_usec = hz ? 1000000 / hz : 0 },
+        .it_value = { .tv_usec = hz ? 1000000 / hz : 0 },
+    };
+    setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+
+int Pf_Start(int hz) {
+    if (!buf) {
+        buf = malloc(sizeof(void *) * PFBUFLEN);
+        check_mem(buf);
+        if (!buf) return 0;
+    }
+    memset(buf, 0, sizeof(void *) * PFBUFLEN);
+    used = samples = dropped = 0;
+
+    void *warmup[1];
+    backtrace(warmup, 1);
+
+    struct sigaction action = { .sa_handler = Sample, .sa_flags = SA_RESTART };
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, NULL) < 0 || hz <= 0) {
+        log_err("Can't start profiling");
+        return 0;
+    }
+
+    SetTimer(hz);
+    return 1;
+}
+
+
+void Pf_Stop() {
+    SetTimer(0);
+    signal(SIGPROF, SIG_IGN);
+
+    if (dropped) {
+        log_info("Profile full, %ld samples dropped", (long)dropped);
+    }
+}
+
+
+long Pf_Samples() {
+    return samples;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Folded stacks
+//------------------------------------------------------------------------------
+
+// Appends the name of the function at addr to line.
+static int AppendName(char *line, int len, void *addr) {
+    Dl_info info = {0};
+    const char *sep = len ? ";" : "";
+
+    if (!dladdr(addr, &info)) {
+        return snprintf(line + len, MAXLINE - len, "%s%p", sep, addr);
+    }
+
+    if (info.dli_sname) {
+        return snprintf(line + len, MAXLINE - len, "%s%s", sep, info.dli_sname);
+    }
+
+    const char *module = strrchr(info.dli_fname, '/');
+    module = module ? module + 1 : info.dli_fname;
+    return snprintf(line + len, MAXLINE - len, "%s%s+0x%lx", sep, module,
+            (unsigned long)((char *)addr - (char *)info.dli_fbase));
+}
+
+
+static int CompareLines(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+
+int Pf_Write(const char *path) {
+    FILE *f = fopen(path, "w");
+    check(f, "Can't write profile %s", path);
+    if (!f) return 0;
+
+    long n = samples;
+    char **lines = malloc(sizeof(char *) * (n ? n : 1));
+    check_mem(lines);
+
+    // Names every sample, outermost first.
+    long numlines = 0;
+    size_t end = used < PFBUFLEN ? used : PFBUFLEN;
+    for (size_t at = 0; at < end && buf[at] && numlines < n;) {
+        int depth = (intptr_t)buf[at];
+        void **frames = &buf[at + 1];
+
+        char line[MAXLINE];
+        int len = 0;
+        for (int i = depth - 1; i >= 0 && len < MAXLINE; i--) {
+            // Return addresses are past the call, maybe in the next function.
+            void *addr = i ? (char *)frames[i] - 1 : frames[i];
+            len += AppendName(line, len, addr);
+        }
+
+        lines[numlines] = strdup(line);
+        check_mem(lines[numlines]);
+        numlines++;
+        at += depth + 1;
+    }
+
+    // Identical stacks end up next to each other.
+    qsort(lines, numlines, sizeof(char *), CompareLines);
+
+    for (long i = 0; i < numlines;) {
+        long count = 1;
+        while (i + count < numlines && !strcmp(lines[i], lines[i + count])) {
+            free(lines[i + count]);
+            count++;
+        }
+        fprintf(f, "%s %ld\n", lines[i], count);
+        free(lines[i]);
+        i += count;
+    }
+
+    free(lines);
+    fclose(f);
+
+    log_info("Wrote %ld samples to %s", numlines, path);
+    return 1;
+}
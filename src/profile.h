@@ -0,0 +1,43 @@
+//------------------------------------------------------------------------------
+// Sampling profiler
+//
+// Samples the call stack of whatever thread is running, PFHZ times per second
+// of CPU time, from a SIGPROF timer, and writes the samples as folded stacks:
+// one line per distinct stack, outermost function first, with the number of
+// times it was seen. flamegraph.pl turns that into a flame graph:
+//
+//   ./bin/engine --headless --replay session.replay --profile out.folded
+//   flamegraph.pl out.folded > out.svg
+//
+// Functions are named with dladdr(), which only knows of exported symbols:
+// binaries are linked with -rdynamic for it to see theirs. Static functions
+// and those in stripped libraries show as module+offset.
+//------------------------------------------------------------------------------
+#ifndef _PROFILE_
+#define _PROFILE_
+
+#define PFHZ 997                // Samples per second, off any frame rate
+#define PFMAXDEPTH 64           // Frames kept per sample, the innermost ones
+#define PFBUFLEN (1 << 21)      // Frames kept in all, 16 MiB worth
+
+
+// Starts sampling every thread of the process, hz times per second of CPU
+// time, until Pf_Stop(). The kernel may sample less often than asked, no more
+// than its own tick rate, usually 250 Hz. Samples that don't fit in the
+// buffer are dropped.
+//
+// Returns 0 if the timer can't be set, 1 otherwise.
+int Pf_Start(int hz);
+
+// Stops sampling. The samples are kept until the next Pf_Start().
+void Pf_Stop();
+
+// Returns the number of samples taken since Pf_Start().
+long Pf_Samples();
+
+// Writes the samples taken as folded stacks to path.
+//
+// Returns 0 if path can't be written, 1 otherwise.
+int Pf_Write(const char *path);
+
+#endif
@@ -0,0 +1,195 @@
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "buffer.h"
+#include "color.h"
+#include "dbg.h"
+#include "defs.h"
+#include "geometry.h"
+#include "map.h"
+#include "render.h"
+#include "stats.h"
+
+#define ISPOW2(n) (((n) & ((n) - 1)) == 0)
+
+// Wraps texture coordinate v to [0, size). With pow2 a constant, the check
+// goes away when inlined.
+#define WRAP(v, size, pow2) ((pow2) ? (v) & ((size) - 1) : MOD((v), (size)))
+
+
+void R_Init(Renderer *r, double fov, double near, double far, int wallheight) {
+    *r = (Renderer){
+        .fov = fov,
+        .near = near,
+        .far = far,
+        .wallheight = wallheight,
+    };
+}
+
+
+void R_Free(Renderer *r) {
+    free(r->angles);
+    r->angles = NULL;
+    r->width = 0;
+}
+
+
+double R_ViewDistance(Renderer *r, int width) {
+    return (width / 2.0) / tan(r->fov / 2.0);
+}
+
+
+static void SetWidth(Renderer *r, int width) {
+    if (width == r->width) return;
+
+    r->angles = realloc(r->angles, sizeof(double) * width);
+    check_mem(r->angles);
+
+    r->width = width;
+    r->view = R_ViewDistance(r, width);
+
+    for (int x = 0; x < width; x++) {
+        r->angles[x] = atan2((x + 0.5) - (width / 2), r->view);
+    }
+}
+
+
+// The whole view, compiled twice: once for textures with power of two sizes,
+// once for any size.
+static inline __attribute__((always_inline))
+void DrawColumns(Renderer *r, Buffer *b, Map *map, Vector pos, Vector forward,
+        int pow2) {
+    int width = b->width;
+    int height = b->height;
+    int step = r->interlaced ? 2 : 1;
+    int povheight = r->wallheight / 2;
+
+    Buffer *walltex = r->walltex;
+    Buffer *flortex = r->flortex;
+    Buffer *ceiltex = r->ceiltex;
+
+    for (int x = 0; x < width; x += step) {
+        double ray_angle = r->angles[x];
+        double ray_cos = cos(ray_angle);
+        double viewcos = r->view / ray_cos;
+        double nearcos = r->near / ray_cos;
+
+        Line ray = {
+            .start = pos,
+            .dir = G_Rotate(forward, ray_angle)
+        };
+
+        STAT(ST_COLUMNS, 1);
+        STAT(ST_WALLTESTS, map->numwalls);
+
+        // Iterate over all the walls and use the one that's hit
+        // closest to the player.
+        Wall *wall = NULL;
+        double distance = DBL_MAX;
+        Vector hit;
+
+        for (int i = 0; i < map->numwalls; i++) {
+            Wall *w = &map->walls[i];
+            Vector h;
+            if (G_SegmentRayIntersection(w->seg, ray, &h)) {
+                double d = G_Distance(h, pos);
+                if (d < distance && d > nearcos) {
+                    wall = w;
+                    distance = d;
+                    hit = h;
+                }
+            }
+        }
+
+        // Wall
+        int col_height = 0;
+        if (wall) {
+            wall->seen = 1;
+            STAT(ST_WALLHITS, 1);
+
+            col_height = viewcos * r->wallheight / distance;
+            // Everything is *much* easier if col_height is even.
+            if (col_height & 1) col_height++;
+
+            int top = (height - col_height) / 2;
+
+            int texel_x = WRAP((int)G_Distance(wall->seg.start, hit), walltex->width, pow2);
+            for (int i = 0; i < col_height; i++) {
+                int y = top + i;
+                if (y < 0 || y >= height) continue;
+
+                // The texture covers the whole column, whatever its size.
+                int texel_y = walltex->height * i / col_height;
+                uint32_t c = walltex->pixels[texel_y * walltex->pitch + texel_x];
+                STAT(ST_TEXELS, 1);
+                if (distance > r->far) {
+                    c = C_ScaleColor(c, r->far / distance);
+                }
+
+                B_SetPixel(b, x, y, c);
+            }
+        }
+
+        // Floor & ceiling
+        for (int h = (height - col_height) / 2; h > 0; h--) {
+            double texel_distance = (povheight * viewcos) / ((height / 2) - h);
+            Vector texel_world_pos = G_Sum(pos, G_Scale(texel_distance, ray.dir));
+            STAT(ST_TEXELS, 2);
+
+            int texel_x = WRAP((int)texel_world_pos.x, flortex->width, pow2);
+            int texel_y = WRAP((int)texel_world_pos.y, flortex->height, pow2);
+
+            uint32_t color = flortex->pixels[texel_y * flortex->pitch + texel_x];
+            if (texel_distance > r->far) {
+                color = C_ScaleColor(color, r->far / texel_distance);
+            }
+            B_SetPixel(b, x, height - h, color);
+
+            texel_x = WRAP((int)texel_world_pos.x, ceiltex->width, pow2);
+            texel_y = WRAP((int)texel_world_pos.y, ceiltex->height, pow2);
+
+            color = ceiltex->pixels[texel_y * ceiltex->pitch + texel_x];
+            if (texel_distance > r->far) {
+                color = C_ScaleColor(color, r->far / texel_distance);
+            }
+            B_SetPixel(b, x, h - 1, color);
+        }
+    }
+}
+
+
+void R_DrawView(Renderer *r, Buffer *b, Map *map, Vector pos, Vector forward) {
+    SetWidth(r, b->width);
+
+    int pow2 = ISPOW2(r->walltex->width) &&
+        ISPOW2(r->flortex->width) && ISPOW2(r->flortex->height) &&
+        ISPOW2(r->ceiltex->width) && ISPOW2(r->ceiltex->height);
+
+    if (pow2) {
+        DrawColumns(r, b, map, pos, forward, 1);
+    } else {
+        DrawColumns(r, b, map, pos, forward, 0);
+    }
+
+    if (r->interlaced) R_FillColumns(b);
+}
+
+
+void R_FillColumns(Buffer *b) {
+    STAT(ST_PIXELS, ((b->width - 1) / 2 + !(b->width & 1)) * b->height);
+
+    for (int y = 0; y < b->height; y++) {
+        uint32_t *row = &b->pixels[y * b->pitch];
+
+        for (int x = 1; x < b->width - 1; x += 2) {
+            uint32_t l = row[x - 1], r = row[x + 1];
+            // Per channel (l + r) / 2, without carries between channels.
+            row[x] = (l & r) + (((l ^ r) & 0xfefefefe) >> 1);
+        }
+
+        if (!(b->width & 1)) {
+            row[b->width - 1] = row[b->width - 2];
+        }
+    }
+}
@@ -0,0 +1,50 @@
+//------------------------------------------------------------------------------
+// First person view
+//
+// A ray is cast for every column of the screen, and the closest wall it hits
+// is drawn as a vertical strip, with the floor below and the ceiling above.
+//------------------------------------------------------------------------------
+#ifndef _RENDER_
+#define _RENDER_
+
+#include "buffer.h"
+#include "geometry.h"
+#include "map.h"
+
+typedef struct Renderer {
+    double fov;         // Horizontal field of view, in radians
+    double near;        // Nothing closer than this is drawn
+    double far;         // Things get darker beyond this
+    int wallheight;     // The point of view is at half of it
+
+    Buffer *walltex, *flortex, *ceiltex;
+
+    int interlaced;     // Cast every other column only, and fill the rest
+
+    // Depend on the width of the buffer drawn to
+    int width;
+    double view;        // Viewplane distance
+    double *angles;     // Angle of the ray of every column
+} Renderer;
+
+
+// Initializes r to draw with the given settings. Textures have to be set
+// before drawing.
+void R_Init(Renderer *r, double fov, double near, double far, int wallheight);
+
+// Frees everything but r itself.
+void R_Free(Renderer *r);
+
+// Draws map as seen from pos, looking towards forward, filling b. Marks the
+// walls drawn as seen.
+//
+// Textures whose sizes are powers of two take a faster path.
+void R_DrawView(Renderer *r, Buffer *b, Map *map, Vector pos, Vector forward);
+
+// Returns the viewplane distance when drawing to buffers width pixels wide.
+double R_ViewDistance(Renderer *r, int width);
+
+// Fills the odd columns of b with the average of the columns at their sides.
+void R_FillColumns(Buffer *b);
+
+#endif
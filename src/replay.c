@@ -0,0 +1,78 @@
+#include <stdio.h>
+
+#include "dbg.h"
+#include "replay.h"
+
+#define REPLAYMAGIC 0x594c5052  // "RPLY"
+#define REPLAYVERSION 2
+
+
+int RP_StartRecording(Replay *rp, const char *path, uint64_t maphash,
+        Mobile start, Movement movement, int tickrate) {
+    *rp = (Replay){
+        .writing = 1,
+        .maphash = maphash,
+        .start = start,
+        .movement = movement,
+        .tickrate = tickrate,
+    };
+
+    rp->f = fopen(path, "wb");
+    check(rp->f, "Can't write replay %s", path);
+    if (!rp->f) return 0;
+
+    uint32_t magic = REPLAYMAGIC, version = REPLAYVERSION;
+    fwrite(&magic, sizeof(magic), 1, rp->f);
+    fwrite(&version, sizeof(version), 1, rp->f);
+    fwrite(&rp->maphash, sizeof(rp->maphash), 1, rp->f);
+    fwrite(&rp->start, sizeof(rp->start), 1, rp->f);
+    fwrite(&rp->movement, sizeof(rp->movement), 1, rp->f);
+    fwrite(&rp->tickrate, sizeof(rp->tickrate), 1, rp->f);
+
+    return 1;
+}
+
+
+void RP_Record(Replay *rp, Tick t) {
+    fwrite(&t, sizeof(t), 1, rp->f);
+    rp->numticks++;
+}
+
+
+int RP_StartPlaying(Replay *rp, const char *path) {
+    *rp = (Replay){0};
+
+    rp->f = fopen(path, "rb");
+    check(rp->f, "Can't read replay %s", path);
+    if (!rp->f) return 0;
+
+    uint32_t magic = 0, version = 0;
+    fread(&magic, sizeof(magic), 1, rp->f);
+    fread(&version, sizeof(version), 1, rp->f);
+    fread(&rp->maphash, sizeof(rp->maphash), 1, rp->f);
+    fread(&rp->start, sizeof(rp->start), 1, rp->f);
+    fread(&rp->movement, sizeof(rp->movement), 1, rp->f);
+    fread(&rp->tickrate, sizeof(rp->tickrate), 1, rp->f);
+
+    if (magic != REPLAYMAGIC || version != REPLAYVERSION) {
+        log_err("%s is not a replay", path);
+        RP_Close(rp);
+        return 0;
+    }
+
+    return 1;
+}
+
+
+int RP_Play(Replay *rp, Tick *t) {
+    if (fread(t, sizeof(*t), 1, rp->f) != 1) return 0;
+
+    rp->numticks++;
+    return 1;
+}
+
+
+void RP_Close(Replay *rp) {
+    if (rp->f) fclose(rp->f);
+    rp->f = NULL;
+}
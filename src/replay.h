@@ -0,0 +1,53 @@
+//------------------------------------------------------------------------------
+// Replays
+//
+// A recording of a session: the map it was played on, the state of the player
+// at the start, and the input of every tick after that. Feeding the ticks back
+// to the same simulation reproduces the session exactly.
+//
+// The map is identified by its hash. The settings that change the movement of
+// the player are recorded too, to play it back with the same ones.
+//------------------------------------------------------------------------------
+#ifndef _REPLAY_
+#define _REPLAY_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "collision.h"
+#include "player.h"
+
+typedef struct Replay {
+    FILE *f;
+    int writing;        // Recording rather than playing
+
+    uint64_t maphash;   // M_Hash() of the map played
+    Mobile start;       // The player, before the first tick
+    Movement movement;  // How the player moved
+    int tickrate;       // Ticks per second when recorded
+
+    int numticks;       // Ticks recorded or played so far
+} Replay;
+
+
+// Starts recording to path. The ticks are added with RP_Record().
+//
+// Returns 0 if path can't be written.
+int RP_StartRecording(Replay *rp, const char *path, uint64_t maphash,
+        Mobile start, Movement movement, int tickrate);
+
+// Adds the input of the next tick to a recording.
+void RP_Record(Replay *rp, Tick t);
+
+// Opens the recording in path to play it, reading its header into rp.
+//
+// Returns 0 if path can't be read or isn't a recording.
+int RP_StartPlaying(Replay *rp, const char *path);
+
+// Reads the input of the next tick into t. Returns 0 once all have been read.
+int RP_Play(Replay *rp, Tick *t);
+
+// Finishes recording or playing.
+void RP_Close(Replay *rp);
+
+#endif
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "buffer.h"
+#include "color.h"
+#include "defs.h"
+#include "rle.h"
+#include "stats.h"
+
+
+RLESprite *RL_Compile(Buffer *b, Arena *arena) {
+    // Count the spans and opaque pixels...
+    int numspans = 0, numpixels = 0;
+    for (int j = 0; j < b->height; j++) {
+        for (int i = 0; i < b->width; i++) {
+            if (B_GetPixel(b, i, j) == TRANSPARENT) continue;
+
+            if (i == 0 || B_GetPixel(b, i - 1, j) == TRANSPARENT) numspans++;
+            numpixels++;
+        }
+    }
+
+    // ... so everything fits in a single allocation.
+    size_t size = sizeof(RLESprite) +
+        sizeof(uint32_t) * numpixels +
+        sizeof(Span) * numspans +
+        sizeof(int) * (b->height + 1);
+
+    RLESprite *s = A_Alloc(arena, size);
+    s->width = b->width;
+    s->height = b->height;
+    s->pixels = (uint32_t *)(s + 1);
+    s->spans = (Span *)(s->pixels + numpixels);
+    s->rows = (int *)(s->spans + numspans);
+    s->arena = arena;
+
+    int span = 0, pixel = 0;
+    for (int j = 0; j < b->height; j++) {
+        s->rows[j] = span;
+
+        for (int i = 0; i < b->width; i++) {
+            uint32_t c = B_GetPixel(b, i, j);
+            if (c == TRANSPARENT) continue;
+
+            if (i == 0 || B_GetPixel(b, i - 1, j) == TRANSPARENT) {
+                s->spans[span++] = (Span){ .x = i, .len = 0, .offset = pixel };
+            }
+
+            s->spans[span - 1].len++;
+            s->pixels[pixel++] = c;
+        }
+    }
+    s->rows[b->height] = span;
+
+    return s;
+}
+
+
+void RL_Delete(RLESprite *s) {
+    if (s->arena) return;
+
+    free(s);
+}
+
+
+void RL_Blit(Buffer *dest, RLESprite *s, int x, int y) {
+    B_MarkDirty(dest, (Box){ y, y + s->height - 1, x, x + s->width - 1 });
+
+    int j0 = MAX(0, -y);
+    int j1 = MIN(s->height, dest->height - y);
+
+    for (int j = j0; j < j1; j++) {
+        uint32_t *row = &dest->pixels[(y + j) * dest->pitch];
+
+        for (int k = s->rows[j]; k < s->rows[j + 1]; k++) {
+            Span span = s->spans[k];
+
+            int start = x + span.x;
+            int end = start + span.len;
+            int skip = MAX(0, -start);
+            end = MIN(end, dest->width);
+
+            if (start + skip < end) {
+                memcpy(&row[start + skip], &s->pixels[span.offset + skip],
+                        sizeof(uint32_t) * (end - start - skip));
+                STAT(ST_PIXELS, end - start - skip);
+            }
+        }
+    }
+}
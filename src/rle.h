@@ -0,0 +1,42 @@
+//------------------------------------------------------------------------------
+// Run-length encoded sprites
+//
+// Sprites are compiled into the runs of opaque pixels of each row, so blitting
+// them is copying those runs without looking at the transparent pixels.
+//------------------------------------------------------------------------------
+#ifndef _RLE_
+#define _RLE_
+
+#include <stdint.h>
+
+#include "arena.h"
+#include "buffer.h"
+
+// A run of opaque pixels in a row.
+typedef struct Span {
+    uint16_t x;         // First column
+    uint16_t len;       // Number of pixels
+    uint32_t offset;    // Index of its first pixel in RLESprite.pixels
+} Span;
+
+typedef struct RLESprite {
+    int width, height;
+    int *rows;          // Spans of row j are spans[rows[j]] to spans[rows[j + 1] - 1]
+    Span *spans;
+    uint32_t *pixels;   // Opaque pixels, packed
+
+    Arena *arena;       // Where the sprite was allocated, NULL for the heap.
+} RLESprite;
+
+
+// Compiles the opaque pixels of b, allocating the sprite from arena.
+RLESprite *RL_Compile(Buffer *b, Arena *arena);
+
+// Free a RLESprite. Does nothing for sprites allocated from an arena.
+void RL_Delete(RLESprite *s);
+
+// Copies the opaque pixels of s to dest starting at (x,y) pixel of dest.
+// The parts of s outside of dest are skipped.
+void RL_Blit(Buffer *dest, RLESprite *s, int x, int y);
+
+#endif
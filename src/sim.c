@@ -0,0 +1,144 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "dbg.h"
+#include "defs.h"
+#include "player.h"
+#include "sim.h"
+
+#define MINCHUNK 16         // Fewest players worth a job
+
+
+void Sm_Init(Sim *s, Map *map, const Movement *m, int nummobs, Mobile spawn,
+        JobPool *pool, Arena *arena) {
+    *s = (Sim){
+        .map = map,
+        .movement = *m,
+        .nummobs = nummobs,
+        .pool = pool,
+        .arena = arena,
+    };
+
+    s->mobs = A_Alloc(arena, sizeof(Mobile) * nummobs);
+    s->ticks = A_Alloc(arena, sizeof(Tick) * nummobs);
+    check_mem(s->mobs && s->ticks);
+
+    for (int i = 0; i < nummobs; i++) {
+        s->mobs[i] = spawn;
+        s->ticks[i] = (Tick){0};
+    }
+
+    SP_Init(&s->grid, SIMCELL);
+    for (int i = 0; i < map->numwalls; i++) {
+        SP_InsertSegment(&s->grid, i, map->walls[i].seg);
+    }
+
+    // A few chunks per worker, to even out the load.
+    int chunks = pool ? pool->numthreads * 4 : 1;
+    chunks = CLAMP(nummobs / MINCHUNK, 1, MIN(chunks, SIMCHUNKS));
+
+    s->numchunks = chunks;
+    for (int i = 0; i < chunks; i++) {
+        s->chunks[i] = (SimChunk){
+            .sim = s,
+            .first = (long)nummobs * i / chunks,
+            .last = (long)nummobs * (i + 1) / chunks,
+        };
+    }
+}
+
+
+void Sm_Free(Sim *s) {
+    SP_Free(&s->grid);
+    for (int i = 0; i < s->numchunks; i++) {
+        free(s->chunks[i].ids);
+        free(s->chunks[i].near.walls);
+    }
+
+    if (s->arena) return;
+
+    free(s->mobs);
+    free(s->ticks);
+}
+
+
+static int CompareIds(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+
+// Puts in c->near the walls mob could reach in a tick, in the order they are
+// in the map, so collisions go exactly as they would against all of them.
+static void FindNearWalls(SimChunk *c, Mobile *mob) {
+    Sim *s = c->sim;
+
+    // A bit more than it can move, for what Co_Move() leaves between it and
+    // the walls.
+    double reach = s->movement.speed + mob->radius + 1;
+    Box box = {
+        mob->pos.y - reach, mob->pos.y + reach,
+        mob->pos.x - reach, mob->pos.x + reach
+    };
+
+    int n = SP_QueryAll(&s->grid, box, c->ids, c->capacity);
+    if (n > c->capacity) {
+        c->capacity = MAX(n, c->capacity * 2);
+        c->ids = realloc(c->ids, sizeof(int) * c->capacity);
+        c->near.walls = realloc(c->near.walls, sizeof(Wall) * c->capacity);
+        check_mem(c->ids && c->near.walls);
+
+        n = SP_QueryAll(&s->grid, box, c->ids, c->capacity);
+    }
+
+    // Walls in several cells come up once per cell.
+    qsort(c->ids, n, sizeof(int), CompareIds);
+
+    c->near.numwalls = 0;
+    for (int i = 0; i < n; i++) {
+        if (i > 0 && c->ids[i] == c->ids[i - 1]) continue;
+        c->near.walls[c->near.numwalls++] = s->map->walls[c->ids[i]];
+    }
+}
+
+
+static void *StepChunk(void *arg) {
+    SimChunk *c = arg;
+    Sim *s = c->sim;
+
+    for (int i = c->first; i < c->last; i++) {
+        FindNearWalls(c, &s->mobs[i]);
+        P_Move(&s->mobs[i], &c->near, &s->movement, s->ticks[i]);
+    }
+
+    return NULL;
+}
+
+
+void Sm_Step(Sim *s) {
+    if (!s->pool || s->numchunks == 1) {
+        for (int i = 0; i < s->numchunks; i++) StepChunk(&s->chunks[i]);
+    } else {
+        for (int i = 0; i < s->numchunks; i++) {
+            J_Submit(s->pool, &s->chunks[i].job, "step", StepChunk, &s->chunks[i]);
+        }
+        for (int i = 0; i < s->numchunks; i++) {
+            J_Wait(&s->chunks[i].job);
+        }
+    }
+
+    s->steps++;
+}
+
+
+uint64_t Sm_Hash(Sim *s) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    const unsigned char *p = (const unsigned char *)s->mobs;
+    for (size_t i = 0; i < sizeof(Mobile) * s->nummobs; i++) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
@@ -0,0 +1,73 @@
+//------------------------------------------------------------------------------
+// Simulation
+//
+// Many players moving in a map, with no window, input devices or timing of
+// their own: whoever runs it sets the input of every player and steps it. Used
+// for load testing and training bots, where ticks per second is all that
+// matters.
+//
+// Players only collide with walls, so they can be moved in parallel. Each one
+// is only tested against the walls near it, found in a grid of the walls.
+//------------------------------------------------------------------------------
+#ifndef _SIM_
+#define _SIM_
+
+#include <stdint.h>
+
+#include "arena.h"
+#include "collision.h"
+#include "jobs.h"
+#include "map.h"
+#include "player.h"
+#include "spatial.h"
+
+#define SIMCHUNKS 64        // Most jobs a step is split into
+#define SIMCELL 64          // Size of the cells of the grid of walls
+
+typedef struct SimChunk {
+    struct Sim *sim;
+    int first, last;        // Players moved, [first, last)
+    Job job;
+
+    // Walls near the player being moved, as a map of their own
+    int *ids;
+    Map near;
+    int capacity;
+} SimChunk;
+
+typedef struct Sim {
+    Map *map;
+    SpatialIndex grid;      // Walls of map
+    Movement movement;
+
+    Mobile *mobs;
+    Tick *ticks;            // Input of every player for the next step
+    int nummobs;
+
+    uint64_t steps;         // Taken so far
+
+    JobPool *pool;          // Where steps run, NULL to run them in the caller
+    SimChunk chunks[SIMCHUNKS];
+    int numchunks;
+
+    Arena *arena;           // Where mobs and ticks come from, NULL for the heap
+} Sim;
+
+
+// Initializes s with nummobs players at spawn, in map, which must outlive it.
+// Steps are split between the workers of pool, if not NULL.
+void Sm_Init(Sim *s, Map *map, const Movement *m, int nummobs, Mobile spawn,
+        JobPool *pool, Arena *arena);
+
+// Frees everything but s itself. Players and their input are left to the
+// arena, if s was allocated from one.
+void Sm_Free(Sim *s);
+
+// Moves every player by one tick of their input.
+void Sm_Step(Sim *s);
+
+// Returns a hash of the state of every player, to tell whether two runs went
+// the same way.
+uint64_t Sm_Hash(Sim *s);
+
+#endif
@@ -0,0 +1,309 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbg.h"
+#include "defs.h"
+#include "geometry.h"
+#include "spatial.h"
+
+#define INITIALBUCKETS 256
+
+// What present holds for each id
+#define PRESENTBOX 1
+#define PRESENTSEGMENT 2
+
+
+static int CellCoord(SpatialIndex *si, double x) {
+    return floor(x / si->cellsize);
+}
+
+
+static SpatialBucket *GetBucket(SpatialIndex *si, int cx, int cy) {
+    uint32_t h = (uint32_t)cx * 73856093u ^ (uint32_t)cy * 19349663u;
+    return &si->buckets[h & (si->numbuckets - 1)];
+}
+
+
+static void AddEntry(SpatialIndex *si, SpatialEntry e) {
+    SpatialBucket *b = GetBucket(si, e.cx, e.cy);
+
+    if (b->count == b->capacity) {
+        b->capacity = MAX(4, b->capacity * 2);
+        b->entries = realloc(b->entries, sizeof(SpatialEntry) * b->capacity);
+        check_mem(b->entries);
+    }
+
+    b->entries[b->count++] = e;
+    si->numentries++;
+}
+
+
+// Doubles the number of buckets, keeping the entries per bucket low.
+static void Grow(SpatialIndex *si) {
+    SpatialBucket *old = si->buckets;
+    int numold = si->numbuckets;
+
+    si->numbuckets *= 2;
+    si->buckets = calloc(si->numbuckets, sizeof(SpatialBucket));
+    check_mem(si->buckets);
+    si->numentries = 0;
+
+    for (int i = 0; i < numold; i++) {
+        for (int j = 0; j < old[i].count; j++) {
+            AddEntry(si, old[i].entries[j]);
+        }
+        free(old[i].entries);
+    }
+
+    free(old);
+}
+
+
+static void ReserveIds(SpatialIndex *si, int id) {
+    if (id < si->numids) return;
+
+    int n = MAX(id + 1, si->numids * 2);
+
+    si->boxes = realloc(si->boxes, sizeof(Box) * n);
+    si->segments = realloc(si->segments, sizeof(Segment) * n);
+    si->present = realloc(si->present, n);
+    si->stamp = realloc(si->stamp, sizeof(uint32_t) * n);
+    check_mem(si->boxes && si->segments && si->present && si->stamp);
+
+    memset(si->present + si->numids, 0, n - si->numids);
+    memset(si->stamp + si->numids, 0, sizeof(uint32_t) * (n - si->numids));
+
+    si->numids = n;
+}
+
+
+void SP_Init(SpatialIndex *si, double cellsize) {
+    si->cellsize = cellsize;
+    si->numbuckets = INITIALBUCKETS;
+    si->buckets = calloc(si->numbuckets, sizeof(SpatialBucket));
+    si->numentries = 0;
+    si->boxes = NULL;
+    si->segments = NULL;
+    si->present = NULL;
+    si->stamp = NULL;
+    si->numids = 0;
+    si->query = 0;
+}
+
+
+void SP_Free(SpatialIndex *si) {
+    for (int i = 0; i < si->numbuckets; i++) {
+        free(si->buckets[i].entries);
+    }
+
+    free(si->buckets);
+    free(si->boxes);
+    free(si->segments);
+    free(si->present);
+    free(si->stamp);
+}
+
+
+static void AddCell(SpatialIndex *si, int cx, int cy, int id) {
+    AddEntry(si, (SpatialEntry){ cx, cy, id });
+}
+
+
+static void RemoveCell(SpatialIndex *si, int cx, int cy, int id) {
+    SpatialBucket *b = GetBucket(si, cx, cy);
+
+    for (int i = 0; i < b->count; i++) {
+        SpatialEntry e = b->entries[i];
+        if (e.id == id && e.cx == cx && e.cy == cy) {
+            b->entries[i] = b->entries[--b->count];
+            si->numentries--;
+            return;
+        }
+    }
+}
+
+
+// Calls visit for every cell a segment crosses, walking the grid from cell to
+// cell (Amanatides & Woo). Where it goes exactly through a corner, both cells
+// beside the corner are visited too.
+static void SegmentCells(SpatialIndex *si, Segment s, int id,
+        void (*visit)(SpatialIndex *, int, int, int)) {
+    double cs = si->cellsize;
+    double dx = s.end.x - s.start.x, dy = s.end.y - s.start.y;
+
+    int cx = CellCoord(si, s.start.x), cy = CellCoord(si, s.start.y);
+    int ex = CellCoord(si, s.end.x), ey = CellCoord(si, s.end.y);
+    int sx = ex < cx ? -1 : 1, sy = ey < cy ? -1 : 1;
+
+    // Fraction of the segment where it enters the next column and row, and the
+    // fraction it takes to cross one.
+    double tx = dx > 0 ? ((cx + 1) * cs - s.start.x) / dx :
+            dx < 0 ? (cx * cs - s.start.x) / dx : INFINITY;
+    double ty = dy > 0 ? ((cy + 1) * cs - s.start.y) / dy :
+            dy < 0 ? (cy * cs - s.start.y) / dy : INFINITY;
+    double stepx = dx ? cs / fabs(dx) : INFINITY;
+    double stepy = dy ? cs / fabs(dy) : INFINITY;
+
+    visit(si, cx, cy, id);
+
+    // Rounding can't make it miss the last cell: once in its column or row,
+    // it only moves the other way.
+    while (cx != ex || cy != ey) {
+        if (cy == ey || (cx != ex && tx < ty)) {
+            cx += sx;
+            tx += stepx;
+        } else if (cx == ex || ty < tx) {
+            cy += sy;
+            ty += stepy;
+        } else {
+            visit(si, cx + sx, cy, id);
+            visit(si, cx, cy + sy, id);
+            cx += sx;
+            cy += sy;
+            tx += stepx;
+            ty += stepy;
+        }
+
+        visit(si, cx, cy, id);
+    }
+}
+
+
+// Calls visit for every cell id is in.
+static void ItemCells(SpatialIndex *si, int id,
+        void (*visit)(SpatialIndex *, int, int, int)) {
+    if (si->present[id] == PRESENTSEGMENT) {
+        SegmentCells(si, si->segments[id], id, visit);
+        return;
+    }
+
+    Box box = si->boxes[id];
+    int x0 = CellCoord(si, box.left), x1 = CellCoord(si, box.right);
+    int y0 = CellCoord(si, box.top), y1 = CellCoord(si, box.bottom);
+
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            visit(si, cx, cy, id);
+        }
+    }
+}
+
+
+void SP_Insert(SpatialIndex *si, int id, Box box) {
+    ReserveIds(si, id);
+    if (si->present[id]) SP_Remove(si, id);
+
+    si->boxes[id] = box;
+    si->present[id] = PRESENTBOX;
+    ItemCells(si, id, AddCell);
+
+    if (si->numentries > 2 * si->numbuckets) {
+        Grow(si);
+    }
+}
+
+
+void SP_InsertSegment(SpatialIndex *si, int id, Segment s) {
+    ReserveIds(si, id);
+    if (si->present[id]) SP_Remove(si, id);
+
+    si->boxes[id] = SP_SegmentBox(s);
+    si->segments[id] = s;
+    si->present[id] = PRESENTSEGMENT;
+    ItemCells(si, id, AddCell);
+
+    if (si->numentries > 2 * si->numbuckets) {
+        Grow(si);
+    }
+}
+
+
+void SP_Remove(SpatialIndex *si, int id) {
+    if (id >= si->numids || !si->present[id]) return;
+
+    ItemCells(si, id, RemoveCell);
+    si->present[id] = 0;
+}
+
+
+void SP_Clear(SpatialIndex *si) {
+    for (int i = 0; i < si->numbuckets; i++) {
+        si->buckets[i].count = 0;
+    }
+
+    si->numentries = 0;
+    if (si->present) memset(si->present, 0, si->numids);
+}
+
+
+int SP_Query(SpatialIndex *si, Box box, int *ids, int maxids) {
+    // Items spanning several cells must be returned only once.
+    if (++si->query == 0) {
+        memset(si->stamp, 0, sizeof(uint32_t) * si->numids);
+        si->query = 1;
+    }
+
+    int x0 = CellCoord(si, box.left), x1 = CellCoord(si, box.right);
+    int y0 = CellCoord(si, box.top), y1 = CellCoord(si, box.bottom);
+
+    int n = 0;
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            SpatialBucket *b = GetBucket(si, cx, cy);
+
+            for (int i = 0; i < b->count; i++) {
+                SpatialEntry e = b->entries[i];
+                if (e.cx != cx || e.cy != cy) continue;
+                if (si->stamp[e.id] == si->query) continue;
+                si->stamp[e.id] = si->query;
+
+                Box o = si->boxes[e.id];
+                if (o.left > box.right || o.right < box.left ||
+                        o.top > box.bottom || o.bottom < box.top) continue;
+
+                if (n < maxids) ids[n] = e.id;
+                n++;
+            }
+        }
+    }
+
+    return n;
+}
+
+
+int SP_QueryAll(SpatialIndex *si, Box box, int *ids, int maxids) {
+    int x0 = CellCoord(si, box.left), x1 = CellCoord(si, box.right);
+    int y0 = CellCoord(si, box.top), y1 = CellCoord(si, box.bottom);
+
+    int n = 0;
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            SpatialBucket *b = GetBucket(si, cx, cy);
+
+            for (int i = 0; i < b->count; i++) {
+                SpatialEntry e = b->entries[i];
+                if (e.cx != cx || e.cy != cy) continue;
+
+                Box o = si->boxes[e.id];
+                if (o.left > box.right || o.right < box.left ||
+                        o.top > box.bottom || o.bottom < box.top) continue;
+
+                if (n < maxids) ids[n] = e.id;
+                n++;
+            }
+        }
+    }
+
+    return n;
+}
+
+
+Box SP_SegmentBox(Segment s) {
+    return (Box){
+        .top = MIN(s.start.y, s.end.y),
+        .bottom = MAX(s.start.y, s.end.y),
+        .left = MIN(s.start.x, s.end.x),
+        .right = MAX(s.start.x, s.end.x),
+    };
+}
@@ -0,0 +1,73 @@
+//------------------------------------------------------------------------------
+// Spatial index
+//
+// Keeps the bounding boxes of items, identified by integers, in a uniform grid
+// of square cells. Only the cells in use take memory: they're stored in a hash
+// table that grows with the number of items. Segments are only put in the
+// cells they cross, rather than every cell of their box.
+//------------------------------------------------------------------------------
+#ifndef _SPATIAL_
+#define _SPATIAL_
+
+#include <stdint.h>
+
+#include "geometry.h"
+
+typedef struct SpatialEntry {
+    int cx, cy;     // Cell
+    int id;
+} SpatialEntry;
+
+typedef struct SpatialBucket {
+    SpatialEntry *entries;
+    int count, capacity;
+} SpatialBucket;
+
+typedef struct SpatialIndex {
+    double cellsize;
+
+    SpatialBucket *buckets;
+    int numbuckets;     // Power of two
+    int numentries;
+
+    Box *boxes;         // Box of every id...
+    Segment *segments;  // ... and segment, for those inserted as one...
+    uint8_t *present;   // ... if it's in the index
+    uint32_t *stamp;    // Last query that returned each id
+    int numids;         // Capacity of the arrays above
+    uint32_t query;
+} SpatialIndex;
+
+
+// Initializes an empty index with cells of the given size.
+void SP_Init(SpatialIndex *si, double cellsize);
+
+// Frees everything but si itself.
+void SP_Free(SpatialIndex *si);
+
+// Adds item id, covering box. If id is already in the index, it's moved.
+void SP_Insert(SpatialIndex *si, int id, Box box);
+
+// Adds item id, the segment s, to the cells it crosses only. Queries find it
+// if their box overlaps one of those cells, and the segment's box.
+void SP_InsertSegment(SpatialIndex *si, int id, Segment s);
+
+// Removes item id.
+void SP_Remove(SpatialIndex *si, int id);
+
+// Removes every item.
+void SP_Clear(SpatialIndex *si);
+
+// Stores in ids at most maxids items whose box overlaps box.
+//
+// Returns the number of items found, which can be more than maxids.
+int SP_Query(SpatialIndex *si, Box box, int *ids, int maxids);
+
+// Like SP_Query(), but items spanning several cells are found once per cell.
+// It changes nothing, so several threads can query at once.
+int SP_QueryAll(SpatialIndex *si, Box box, int *ids, int maxids);
+
+// Returns the box of s.
+Box SP_SegmentBox(Segment s);
+
+#endif
@@ -1,44 +1,63 @@
 #include <stdlib.h>
 
+#include "arena.h"
 #include "buffer.h"
+#include "rle.h"
 #include "sprites.h"
 #include "system.h"
 
 
-SpriteSheet SS_LoadSpriteSheet(const char *path, int rows, int cols) {
-    Buffer *b = S_LoadImage(path);
+SpriteSheet SS_LoadSpriteSheet(const char *path, int rows, int cols, Arena *arena) {
+    return SS_FromAtlas(S_LoadImage(path, arena), rows, cols, arena);
+}
+
+
+SpriteSheet SS_FromAtlas(Buffer *atlas, int rows, int cols, Arena *arena) {
+    if (!atlas) return (SpriteSheet){ .arena = arena };
 
     SpriteSheet ss = {
+        .atlas = atlas,
         .rows = rows,
         .cols = cols,
-        .width =  b->width / cols,
-        .height = b->height / rows,
-        .sprites = malloc(sizeof(Buffer *) * rows * cols)
+        .width =  atlas->width / cols,
+        .height = atlas->height / rows,
+        .sprites = A_Alloc(arena, sizeof(Buffer) * rows * cols),
+        .compiled = A_Alloc(arena, sizeof(RLESprite *) * rows * cols),
+        .arena = arena,
     };
 
     for (int j = 0; j < rows; j++) {
         for (int i = 0; i < cols; i++) {
-            Buffer *sprite = B_GetSubBuffer(
-                    b, i * ss.width, j * ss.height, ss.width, ss.height
+            ss.sprites[j * cols + i] = B_View(
+                    atlas, i * ss.width, j * ss.height, ss.width, ss.height
                     );
 
-            ss.sprites[j * cols + i] = sprite;
+            ss.compiled[j * cols + i] = RL_Compile(&ss.sprites[j * cols + i], arena);
         }
     }
 
-    B_DeleteBuffer(b);
-
     return ss;
 }
 
 
 Buffer *SS_GetSprite(SpriteSheet ss, int x, int y) {
-    return ss.sprites[y * ss.cols + x];
+    return &ss.sprites[y * ss.cols + x];
+}
+
+
+RLESprite *SS_GetCompiledSprite(SpriteSheet ss, int x, int y) {
+    return ss.compiled[y * ss.cols + x];
 }
 
 
 void SS_DeleteSpriteSheet(SpriteSheet ss) {
+    if (ss.arena) return;
+
     for (int i = 0; i < ss.rows * ss.cols; i++) {
-        free(ss.sprites[i]);
+        RL_Delete(ss.compiled[i]);
     }
+
+    free(ss.compiled);
+    free(ss.sprites);
+    if (ss.atlas) B_DeleteBuffer(ss.atlas);
 }
@@ -1,20 +1,39 @@
 //------------------------------------------------------------------------------
 // Sprite sheets
+//
+// The whole image is kept as an atlas, and every sprite is a view into it.
+// Sprites are also compiled into RLESprites on load, for fast blitting.
 //------------------------------------------------------------------------------
 #ifndef _SPRITES_
 #define _SPRITES_
 
+#include "arena.h"
 #include "buffer.h"
+#include "rle.h"
 
 typedef struct SpriteSheet {
-    Buffer **sprites;
+    Buffer *atlas;
+    Buffer *sprites;    // rows * cols views into atlas
+    RLESprite **compiled;
     int rows, cols;
     int width, height;
+
+    Arena *arena;   // Where the sheet was allocated, NULL for the heap.
 } SpriteSheet;
 
 
-SpriteSheet SS_LoadSpriteSheet(const char *path, int rows, int cols);
+// Loads the image in path and splits it into rows * cols sprites. The sheet's
+// atlas is NULL, and it has no sprites, if the image can't be loaded.
+SpriteSheet SS_LoadSpriteSheet(const char *path, int rows, int cols, Arena *arena);
+
+// Splits atlas into rows * cols sprites. The sheet owns atlas from then on.
+// A NULL atlas gives an empty sheet.
+SpriteSheet SS_FromAtlas(Buffer *atlas, int rows, int cols, Arena *arena);
+
 Buffer *SS_GetSprite(SpriteSheet ss, int x, int y);
+RLESprite *SS_GetCompiledSprite(SpriteSheet ss, int x, int y);
+
+// Frees the atlas and the compiled sprites. Does nothing for sheets allocated from an arena.
 void SS_DeleteSpriteSheet(SpriteSheet ss);
 
 #endif
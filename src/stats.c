@@ -0,0 +1,20 @@
+#include "stats.h"
+
+const char *st_names[NUMSTATS] = {
+    [ST_COLUMNS] = "columns",
+    [ST_WALLTESTS] = "walltests",
+    [ST_WALLHITS] = "wallhits",
+    [ST_PIXELS] = "pixels",
+    [ST_TEXELS] = "texels",
+    [ST_COLLISIONTESTS] = "collisiontests",
+    [ST_COLLISIONS] = "collisions",
+};
+
+_Thread_local Stats st_frame;
+
+
+Stats ST_EndFrame() {
+    Stats s = st_frame;
+    st_frame = (Stats){{0}};
+    return s;
+}
@@ -0,0 +1,48 @@
+//------------------------------------------------------------------------------
+// Frame statistics
+//
+// Counts of the work done to draw a frame: rays cast, walls tested against
+// them, pixels written, texels read, and walls tested for collisions.
+//
+// Counting is compiled in only with -DSTATS (make STATS=1). Otherwise STAT()
+// is nothing, and costs nothing. Every thread counts on its own, and the
+// counts add up until the thread calls ST_EndFrame().
+//------------------------------------------------------------------------------
+#ifndef _STATS_
+#define _STATS_
+
+#include <stdint.h>
+
+typedef enum Stat {
+    ST_COLUMNS,         // Columns of the view cast
+    ST_WALLTESTS,       // Walls tested against rays
+    ST_WALLHITS,        // Rays that hit a wall
+    ST_PIXELS,          // Pixels written, more than once if overdrawn
+    ST_TEXELS,          // Texels read
+    ST_COLLISIONTESTS,  // Walls tested for collisions
+    ST_COLLISIONS,      // Checks that found one
+    NUMSTATS
+} Stat;
+
+typedef struct Stats {
+    uint64_t counts[NUMSTATS];
+} Stats;
+
+// Names of the stats, as used in reports.
+extern const char *st_names[NUMSTATS];
+
+// Counts of the calling thread since its last ST_EndFrame().
+extern _Thread_local Stats st_frame;
+
+#ifdef STATS
+#define STAT(stat, n) (st_frame.counts[stat] += (n))
+#else
+#define STAT(stat, n) ((void)0)
+#endif
+
+
+// Returns the counts of the calling thread since its last call, and starts
+// counting from 0.
+Stats ST_EndFrame();
+
+#endif
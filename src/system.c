@@ -4,10 +4,13 @@
 #include <SDL.h>
 #include <SDL_image.h>
 
+#include "arena.h"
 #include "geometry.h"
 #include "buffer.h"
+#include "cache.h"
 #include "system.h"
 #include "dbg.h"
+#include "pixops.h"
 
 static const char *vertexSource = "#version 330 core\n"
 "\n"
@@ -17,8 +20,10 @@ static const char *vertexSource = "#version 330 core\n"
 "out vec3 Color;\n"
 "out vec2 Texcoord;\n"
 "\n"
+"uniform vec2 scale;\n"
+"\n"
 "void main() {\n"
-"    Texcoord = texcoord;\n"
+"    Texcoord = texcoord * scale;\n"
 "    gl_Position = vec4(position, 0.0, 1.0);\n"
 "}";
 
@@ -37,6 +42,12 @@ static const char *fragmentSource = "#version 330 core\n"
 static SDL_Window *window;
 static SDL_GLContext glcontext;
 
+// Size of the texture the buffers are blitted to, and of the last buffer
+// blitted, which only covers part of it if it's smaller.
+static int texwidth, texheight;
+static int blitwidth, blitheight;
+static GLint scaleUniform;
+
 // Flags
 static int resizef;
 
@@ -68,7 +79,7 @@ int HandleResize(void *userdata, SDL_Event *ev) {
 
 void S_Init(const char *title, int width, int height) {
     SDL_Init(SDL_INIT_VIDEO);
-    IMG_Init(IMG_INIT_PNG);
+    S_InitImages();
 
     // Core-Profile OpenGL 3.3
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK,
@@ -121,6 +132,8 @@ void S_Init(const char *title, int width, int height) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
             GL_UNSIGNED_BYTE, NULL);
+    texwidth = blitwidth = width;
+    texheight = blitheight = height;
 
     // Vertex Array Object
     GLuint vao;
@@ -158,6 +171,9 @@ void S_Init(const char *title, int width, int height) {
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 
+    scaleUniform = glGetUniformLocation(shaderProgram, "scale");
+    glUniform2f(scaleUniform, 1, 1);
+
     // Vertex attributes
     GLint posAttrib = glGetAttribLocation(shaderProgram, "position");
     glEnableVertexAttribArray(posAttrib);
@@ -265,6 +281,7 @@ Tick S_GetTick() {
 uint32_t S_Blit(Buffer *buf) {
     uint32_t start = S_GetTime();
 
+    int resized = resizef;
     if (resizef) {
         resizef = 0;
 
@@ -274,14 +291,48 @@ uint32_t S_Blit(Buffer *buf) {
         glViewport(0, 0, winwidth, winheight);
     }
 
-    glTexSubImage2D(
-            GL_TEXTURE_2D,
-            0, 0,
-            0,
-            buf->width, buf->height,
-            GL_RGBA, GL_UNSIGNED_BYTE,
-            buf->pixels
-            );
+    // Smaller buffers go in the top-left corner of the texture, and only that
+    // part of it is stretched over the window.
+    if (buf->width != blitwidth || buf->height != blitheight) {
+        blitwidth = buf->width;
+        blitheight = buf->height;
+        glUniform2f(scaleUniform,
+                (float)blitwidth / texwidth, (float)blitheight / texheight);
+        resized = 1;
+    }
+
+    // Views have rows longer than their width.
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, buf->pitch);
+
+    if (!buf->dirty) {
+        glTexSubImage2D(
+                GL_TEXTURE_2D,
+                0, 0,
+                0,
+                buf->width, buf->height,
+                GL_RGBA, GL_UNSIGNED_BYTE,
+                buf->pixels
+                );
+    } else {
+        // Nothing changed: the screen is already up to date.
+        if (buf->dirty->count == 0 && !resized) {
+            return S_GetTime() - start;
+        }
+
+        for (int i = 0; i < buf->dirty->count; i++) {
+            Box r = buf->dirty->rects[i];
+            glTexSubImage2D(
+                    GL_TEXTURE_2D,
+                    0, r.left,
+                    r.top,
+                    r.right - r.left + 1, r.bottom - r.top + 1,
+                    GL_RGBA, GL_UNSIGNED_BYTE,
+                    &buf->pixels[(int)r.top * buf->pitch + (int)r.left]
+                    );
+        }
+
+        B_ClearDirty(buf);
+    }
 
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
@@ -302,59 +353,44 @@ Vector S_GetMousePos(Buffer *buf) {
 }
 
 
-// http://sdl.beuc.net/sdl.wiki/Pixel_Access
-uint32_t GetPixel(SDL_Surface *surface, int x, int y) {
-    int bpp = surface->format->BytesPerPixel;
-    // Here p is the address to the pixel we want to retrieve.
-    uint8_t *p = (uint8_t *)surface->pixels + y * surface->pitch + x * bpp;
-
-    switch (bpp) {
-        case 1:
-            return *p;
-            break;
-
-        case 2:
-            return *(uint16_t *)p;
-            break;
-
-        case 3:
-            if (SDL_BYTEORDER == SDL_BIG_ENDIAN) {
-                return p[0] << 16 | p[1] << 8 | p[2];
-            } else {
-                return p[0] | p[1] << 8 | p[2] << 16;
-            }
-            break;
-
-        case 4:
-            return *(uint32_t *)p;
-            break;
+void S_InitImages() {
+    IMG_Init(IMG_INIT_PNG);
 
-        default:
-            return 0;  // shouldn't happen, but avoids warnings.
-    }
+    PX_Init();
 }
 
 
-Buffer *S_LoadImage(const char *path) {
-    SDL_Surface *tex_surf = IMG_Load(path);
-    check(tex_surf,
-            "Error loading texture. IMG_GetError(): %s\n", IMG_GetError());
+Buffer *S_LoadImage(const char *path, Arena *arena) {
+    Buffer *cached = AC_Load(path, arena);
+    if (cached) return cached;
 
-    Buffer *t = B_CreateBuffer(tex_surf->w, tex_surf->h);
+    SDL_Surface *image = IMG_Load(path);
+    check(image,
+            "Error loading texture. IMG_GetError(): %s\n", IMG_GetError());
+    if (!image) return NULL;
 
-    for (int y = 0; y < tex_surf->h; y++) {
-        for (int x = 0; x < tex_surf->w; x++) {
-            uint32_t pixel = GetPixel(tex_surf, x, y);
+    // Let SDL deal with the pixel format of the file, and convert from a
+    // known one.
+    SDL_Surface *tex_surf = SDL_ConvertSurfaceFormat(image, SDL_PIXELFORMAT_ARGB8888, 0);
+    SDL_FreeSurface(image);
+    check(tex_surf, "Error converting texture %s: %s", path, SDL_GetError());
+    if (!tex_surf) return NULL;
 
-            uint8_t red, green, blue;
-            SDL_GetRGB(pixel, tex_surf->format, &red, &green, &blue);
+    Buffer *t = B_CreateBuffer(tex_surf->w, tex_surf->h, arena);
 
-            t->pixels[y * t->width + x] = BUILDRGB(red, green, blue);
-        }
+    SDL_LockSurface(tex_surf);
+    for (int y = 0; y < tex_surf->h; y++) {
+        PX_ConvertARGB(
+                &t->pixels[y * t->pitch],
+                (uint32_t *)((uint8_t *)tex_surf->pixels + y * tex_surf->pitch),
+                tex_surf->w);
     }
+    SDL_UnlockSurface(tex_surf);
 
     SDL_FreeSurface(tex_surf);
 
+    AC_Store(path, t);
+
     return t;
 }
 
@@ -7,8 +7,10 @@
 
 #include <stdint.h>
 
+#include "arena.h"
 #include "buffer.h"
 #include "geometry.h"
+#include "player.h"
 
 
 //------------------------------------------------------------------------------
@@ -31,6 +33,10 @@ void S_Quit();
 void S_Fullscreen(int flag);
 
 // Update the screen with the contents of buf. Returns the time it took in ms.
+//
+// If buf tracks its dirty areas, only those are uploaded, and its dirty list
+// is cleared. Buffers smaller than the size given to S_Init() are stretched
+// over the whole window.
 uint32_t S_Blit(Buffer *buf);
 
 
@@ -39,15 +45,6 @@ uint32_t S_Blit(Buffer *buf);
 // Input
 //------------------------------------------------------------------------------
 
-// A Tick contains all the input info needed to process one gametick.
-typedef struct Tick {
-    int forward;            // 1 forward, -1 backwards
-    int strafe;             // 1 right, -1 left
-    int turn;               // 1 clockwise, -1 anticlockwise
-    int relative_mouse_x;   // > 0 clockwise, < 0 anticlockwise
-} Tick;
-
-
 // Returns a vector with the position of the mouse in buffer coordinates.
 Vector S_GetMousePos(Buffer *buf);
 
@@ -62,8 +59,14 @@ Tick S_GetTick();
 // Image loading
 //------------------------------------------------------------------------------
 
-// Load the image given by path into a Buffer.
-Buffer *S_LoadImage(const char *path);
+// Prepares the image decoders. Must be called before S_LoadImage() is used
+// from several threads; S_Init() calls it too.
+void S_InitImages();
+
+// Load the image given by path into a Buffer allocated from arena.
+// Decoded images are cached, see cache.h. Returns NULL if it can't be loaded.
+// Safe to call from several threads at once after S_InitImages().
+Buffer *S_LoadImage(const char *path, Arena *arena);
 
 
 
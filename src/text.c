@@ -0,0 +1,142 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "buffer.h"
+#include "color.h"
+#include "defs.h"
+#include "draw.h"
+#include "rle.h"
+#include "sprites.h"
+#include "text.h"
+
+#define TEXTARENA (1 << 20)     // Memory for rendered lines before starting over
+#define TEXTPROBE 4             // Entries where a line can be cached
+
+
+// FNV-1a
+static uint64_t Hash(const char *text, int len) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (int i = 0; i < len; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+// Returns the line at (x,y) or, if it isn't cached, the entry to replace.
+static TextLine *GetLine(TextCache *tc, int x, int y) {
+    uint32_t h = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u;
+
+    TextLine *victim = NULL;
+    for (int i = 0; i < TEXTPROBE; i++) {
+        TextLine *l = &tc->lines[(h + i) % TEXTCACHE];
+        if (l->sprite && l->x == x && l->y == y) return l;
+
+        // Prefer empty entries, then the ones not drawn for longer.
+        if (!victim || !l->sprite || (victim->sprite && l->frame < victim->frame)) {
+            victim = l;
+        }
+    }
+
+    return victim;
+}
+
+
+// Renders text and compiles it into a RLESprite.
+static RLESprite *Render(TextCache *tc, const char *text, int len) {
+    int width = MAX(len, 1) * GLYPHWIDTH;
+    int height = tc->font.height;
+
+    if (!tc->canvas || tc->canvas->width < width) {
+        if (tc->canvas) B_DeleteBuffer(tc->canvas);
+        tc->canvas = B_CreateBuffer(width, height, NULL);
+    }
+
+    // When the arena fills up, forget every line and start over.
+    if (tc->arena.used > TEXTARENA) {
+        A_Reset(&tc->arena);
+        for (int i = 0; i < TEXTCACHE; i++) {
+            tc->lines[i].sprite = NULL;
+        }
+    }
+
+    Buffer canvas = B_View(tc->canvas, 0, 0, width, height);
+    B_ClearBuffer(&canvas, TRANSPARENT);
+    D_DrawString(&canvas, tc->font, 0, 0, text, len);
+
+    return RL_Compile(&canvas, &tc->arena);
+}
+
+
+void T_Init(TextCache *tc, SpriteSheet font, Arena *scratch) {
+    tc->font = font;
+    tc->frame = 0;
+    tc->scratch = scratch;
+    tc->canvas = NULL;
+
+    A_Init(&tc->arena, TEXTARENA);
+
+    for (int i = 0; i < TEXTCACHE; i++) {
+        tc->lines[i] = (TextLine){ .sprite = NULL };
+    }
+}
+
+
+void T_Free(TextCache *tc) {
+    A_Free(&tc->arena);
+    if (tc->canvas) B_DeleteBuffer(tc->canvas);
+}
+
+
+void T_NewFrame(TextCache *tc) {
+    tc->frame++;
+}
+
+
+void T_Draw(TextCache *tc, Buffer *b, int x, int y, const char *fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    int len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    if (len < 0) return;
+
+    char *s = A_Alloc(tc->scratch, len + 1);
+    if (!s) return;
+
+    va_start(args, fmt);
+    vsnprintf(s, len + 1, fmt, args);
+    va_end(args);
+
+    uint64_t hash = Hash(s, len);
+
+    TextLine *l = GetLine(tc, x, y);
+    if (!l->sprite || l->x != x || l->y != y || l->hash != hash ||
+            l->len != len || memcmp(l->text, s, len)) {
+        // Render may forget every line, including this one.
+        RLESprite *sprite = Render(tc, s, len);
+
+        char *copy = A_Alloc(&tc->arena, len);
+        if (!sprite || !copy) {
+            *l = (TextLine){ .sprite = NULL };
+            return;
+        }
+        memcpy(copy, s, len);
+
+        *l = (TextLine){
+            .x = x, .y = y,
+            .hash = hash, .text = copy, .len = len,
+            .sprite = sprite,
+        };
+    }
+
+    l->frame = tc->frame;
+    RL_Blit(b, l->sprite, x, y);
+}
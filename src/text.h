@@ -0,0 +1,54 @@
+//------------------------------------------------------------------------------
+// Cached text
+//
+// Each line of text is rendered once into a RLESprite, and drawn with a single
+// blit for as long as the same text is drawn at the same position. Like any
+// blit, it marks the line dirty in buffers that track it.
+//------------------------------------------------------------------------------
+#ifndef _TEXT_
+#define _TEXT_
+
+#include <stdint.h>
+
+#include "arena.h"
+#include "buffer.h"
+#include "geometry.h"
+#include "rle.h"
+#include "sprites.h"
+
+#define TEXTCACHE 256   // Lines of text cached
+
+typedef struct TextLine {
+    int x, y;           // Position
+    uint64_t hash;      // Hash of the text...
+    char *text;         // ... and the text itself, to tell apart lines
+    int len;            // with the same hash
+    RLESprite *sprite;  // NULL if the entry is empty
+    uint32_t frame;     // Last frame it was drawn
+} TextLine;
+
+typedef struct TextCache {
+    SpriteSheet font;
+    TextLine lines[TEXTCACHE];
+    uint32_t frame;
+
+    Arena arena;        // Rendered lines
+    Arena *scratch;     // Formatted text
+    Buffer *canvas;     // Where lines are rendered before compiling them
+} TextCache;
+
+
+// Initializes tc to draw text with font. Text is formatted in scratch, which
+// has to be reset every now and then, like every frame.
+void T_Init(TextCache *tc, SpriteSheet font, Arena *scratch);
+
+// Frees everything but tc itself.
+void T_Free(TextCache *tc);
+
+// Starts a new frame. The lines not drawn for longest are the first replaced.
+void T_NewFrame(TextCache *tc);
+
+// Draws formatted text at (x,y) of b.
+void T_Draw(TextCache *tc, Buffer *b, int x, int y, const char *fmt, ...);
+
+#endif
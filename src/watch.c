@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "dbg.h"
+#include "watch.h"
+
+
+// Splits path into its directory and file name.
+static void SplitPath(const char *path, char *dir, size_t size, const char **name) {
+    const char *slash = strrchr(path, '/');
+
+    if (!slash) {
+        snprintf(dir, size, ".");
+        *name = path;
+    } else if (slash == path) {
+        snprintf(dir, size, "/");
+        *name = slash + 1;
+    } else {
+        snprintf(dir, size, "%.*s", (int)(slash - path), path);
+        *name = slash + 1;
+    }
+}
+
+
+void FW_Init(FileWatch *fw) {
+    fw->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    check(fw->fd >= 0, "Can't watch files, changes won't be picked up");
+
+    fw->numpaths = 0;
+    fw->len = fw->pos = 0;
+}
+
+
+void FW_Quit(FileWatch *fw) {
+    if (fw->fd >= 0) close(fw->fd);
+
+    fw->fd = -1;
+    fw->numpaths = 0;
+}
+
+
+int FW_Add(FileWatch *fw, const char *path) {
+    if (fw->fd < 0 || fw->numpaths == MAXWATCHED) return -1;
+
+    char dir[256];
+    const char *name;
+    SplitPath(path, dir, sizeof(dir), &name);
+
+    // Adding the same directory twice returns the same watch.
+    int wd = inotify_add_watch(fw->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    check(wd >= 0, "Can't watch %s", dir);
+    if (wd < 0) return -1;
+
+    int id = fw->numpaths++;
+    snprintf(fw->paths[id], sizeof(fw->paths[id]), "%s", name);
+    fw->dirs[id] = wd;
+
+    return id;
+}
+
+
+int FW_Poll(FileWatch *fw) {
+    if (fw->fd < 0) return -1;
+
+    while (1) {
+        if (fw->pos >= fw->len) {
+            fw->len = read(fw->fd, fw->events, sizeof(fw->events));
+            fw->pos = 0;
+            if (fw->len <= 0) {
+                fw->len = 0;
+                return -1;
+            }
+        }
+
+        struct inotify_event *ev = (struct inotify_event *)&fw->events[fw->pos];
+        fw->pos += sizeof(struct inotify_event) + ev->len;
+
+        if (!ev->len) continue;
+
+        for (int id = 0; id < fw->numpaths; id++) {
+            if (fw->dirs[id] == ev->wd && !strcmp(fw->paths[id], ev->name)) {
+                return id;
+            }
+        }
+    }
+}
@@ -0,0 +1,39 @@
+//------------------------------------------------------------------------------
+// File watching
+//
+// Reports files that have been written to, using inotify. The directories of
+// the files are watched rather than the files themselves, so files replaced
+// by renaming another one over them are reported too.
+//------------------------------------------------------------------------------
+#ifndef _WATCH_
+#define _WATCH_
+
+#define MAXWATCHED 32
+
+typedef struct FileWatch {
+    int fd;                         // inotify instance, -1 if unavailable
+
+    char paths[MAXWATCHED][256];    // Watched files...
+    int dirs[MAXWATCHED];           // ... and the watch of their directory
+    int numpaths;
+
+    char events[4096] __attribute__((aligned(8)));  // Events not reported yet
+    int len, pos;
+} FileWatch;
+
+
+// Starts watching nothing.
+void FW_Init(FileWatch *fw);
+
+// Stops watching every file.
+void FW_Quit(FileWatch *fw);
+
+// Starts watching path. Returns an id for it, -1 if it can't be watched.
+int FW_Add(FileWatch *fw, const char *path);
+
+// Returns the id of a watched file that was written to since the last call,
+// -1 if there's none. Never blocks. The same file can be reported several
+// times for a single change.
+int FW_Poll(FileWatch *fw);
+
+#endif
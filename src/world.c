@@ -0,0 +1,475 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dbg.h"
+#include "defs.h"
+#include "geometry.h"
+#include "map.h"
+#include "world.h"
+
+#define WORLDMAGIC 0x444c5257   // "WRLD"
+
+
+// File layout:
+//
+//   uint32_t magic
+//   double tilesize
+//   Vector origin
+//   int cols, rows
+//   TileIndex index[cols * rows]      Row-major
+//   Segment walls[]                   Grouped by tile
+static long HeaderSize(int cols, int rows) {
+    return sizeof(uint32_t) + sizeof(double) + sizeof(Vector) + 2 * sizeof(int) +
+        (long)cols * rows * sizeof(TileIndex);
+}
+
+
+static Box TileBox(Vector origin, double tilesize, int tx, int ty) {
+    return (Box){
+        .top = origin.y + ty * tilesize,
+        .bottom = origin.y + (ty + 1) * tilesize,
+        .left = origin.x + tx * tilesize,
+        .right = origin.x + (tx + 1) * tilesize,
+    };
+}
+
+
+// Returns 1 if s goes through tile (tx, ty).
+static int Touches(Vector origin, double tilesize, Segment s, int tx, int ty) {
+    Segment clipped;
+    return G_ClipSegment(s, TileBox(origin, tilesize, tx, ty), &clipped);
+}
+
+
+// Stores in range the tiles covered by the bounding box of s, clamped to the
+// cols x rows grid.
+static void TileRange(Vector origin, double tilesize, int cols, int rows,
+        Segment s, int range[4]) {
+    range[0] = CLAMP((int)floor((MIN(s.start.x, s.end.x) - origin.x) / tilesize), 0, cols - 1);
+    range[1] = CLAMP((int)floor((MIN(s.start.y, s.end.y) - origin.y) / tilesize), 0, rows - 1);
+    range[2] = CLAMP((int)floor((MAX(s.start.x, s.end.x) - origin.x) / tilesize), 0, cols - 1);
+    range[3] = CLAMP((int)floor((MAX(s.start.y, s.end.y) - origin.y) / tilesize), 0, rows - 1);
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Building
+// -----------------------------------------------------------------------------
+
+int W_Build(Map *map, double tilesize, const char *path) {
+    if (map->numwalls == 0) return 0;
+
+    Vector min = map->walls[0].seg.start;
+    Vector max = min;
+    for (int i = 0; i < map->numwalls; i++) {
+        Segment s = map->walls[i].seg;
+        min.x = MIN(min.x, MIN(s.start.x, s.end.x));
+        min.y = MIN(min.y, MIN(s.start.y, s.end.y));
+        max.x = MAX(max.x, MAX(s.start.x, s.end.x));
+        max.y = MAX(max.y, MAX(s.start.y, s.end.y));
+    }
+
+    int cols = (max.x - min.x) / tilesize + 1;
+    int rows = (max.y - min.y) / tilesize + 1;
+
+    TileIndex *index = calloc(cols * rows, sizeof(TileIndex));
+    check_mem(index);
+
+    // Count the walls of every tile to know where each one starts, then put
+    // them in place: a counting sort of the walls by tile.
+    int range[4];
+    for (int i = 0; i < map->numwalls; i++) {
+        Segment s = map->walls[i].seg;
+        TileRange(min, tilesize, cols, rows, s, range);
+
+        for (int ty = range[1]; ty <= range[3]; ty++) {
+            for (int tx = range[0]; tx <= range[2]; tx++) {
+                if (Touches(min, tilesize, s, tx, ty)) {
+                    index[ty * cols + tx].numwalls++;
+                }
+            }
+        }
+    }
+
+    uint64_t offset = HeaderSize(cols, rows);
+    int *next = malloc(sizeof(int) * cols * rows);
+    check_mem(next);
+
+    int total = 0;
+    for (int i = 0; i < cols * rows; i++) {
+        index[i].offset = offset;
+        offset += index[i].numwalls * sizeof(Segment);
+        next[i] = total;
+        total += index[i].numwalls;
+    }
+
+    Segment *walls = malloc(sizeof(Segment) * MAX(total, 1));
+    check_mem(walls);
+
+    for (int i = 0; i < map->numwalls; i++) {
+        Segment s = map->walls[i].seg;
+        TileRange(min, tilesize, cols, rows, s, range);
+
+        for (int ty = range[1]; ty <= range[3]; ty++) {
+            for (int tx = range[0]; tx <= range[2]; tx++) {
+                if (Touches(min, tilesize, s, tx, ty)) {
+                    walls[next[ty * cols + tx]++] = s;
+                }
+            }
+        }
+    }
+
+    free(next);
+
+    FILE *f = fopen(path, "wb");
+    check(f, "Can't write world %s", path);
+    if (!f) {
+        free(walls);
+        free(index);
+        return 0;
+    }
+
+    uint32_t magic = WORLDMAGIC;
+    fwrite(&magic, sizeof(magic), 1, f);
+    fwrite(&tilesize, sizeof(tilesize), 1, f);
+    fwrite(&min, sizeof(min), 1, f);
+    fwrite(&cols, sizeof(cols), 1, f);
+    fwrite(&rows, sizeof(rows), 1, f);
+    fwrite(index, sizeof(TileIndex), cols * rows, f);
+    fwrite(walls, sizeof(Segment), total, f);
+
+    fclose(f);
+    free(walls);
+    free(index);
+
+    return 1;
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Streaming
+// -----------------------------------------------------------------------------
+
+// Returns how many tiles away from the center tile i is.
+static int TileDistance(World *w, int i) {
+    int tx = i % w->cols, ty = i / w->cols;
+    return MAX(abs(tx - w->cx), abs(ty - w->cy));
+}
+
+
+// Returns the slot holding tile i, -1 if it isn't resident.
+static int FindSlot(World *w, int i) {
+    for (int s = 0; s < w->numtiles; s++) {
+        if (w->tiles[s].index == i) return s;
+    }
+
+    return -1;
+}
+
+
+// Returns the closest tile to the center that should be loaded and isn't,
+// -1 if there's none.
+static int NextMissing(World *w) {
+    for (int d = 0; d <= w->radius; d++) {
+        for (int ty = w->cy - d; ty <= w->cy + d; ty++) {
+            for (int tx = w->cx - d; tx <= w->cx + d; tx++) {
+                // Just the ring d tiles away.
+                if (MAX(abs(tx - w->cx), abs(ty - w->cy)) != d) continue;
+                if (tx < 0 || tx >= w->cols || ty < 0 || ty >= w->rows) continue;
+
+                int i = ty * w->cols + tx;
+                if (w->index[i].numwalls && FindSlot(w, i) < 0) return i;
+            }
+        }
+    }
+
+    return -1;
+}
+
+
+// Frees the slots of the tiles more than radius + 1 tiles away. Keeping the
+// next ring too means going back and forth over a border doesn't reload tiles.
+static void Evict(World *w) {
+    for (int s = 0; s < w->numtiles; s++) {
+        Tile *t = &w->tiles[s];
+        if (t->index >= 0 && t->ready && TileDistance(w, t->index) > w->radius + 1) {
+            t->index = -1;
+            t->gen++;
+            w->changed = 1;
+        }
+    }
+}
+
+
+// Returns a free slot. There are slots for every tile radius + 1 tiles away
+// from the center, so after Evict() there's always one.
+static int FreeSlot(World *w) {
+    for (int s = 0; s < w->numtiles; s++) {
+        if (w->tiles[s].index < 0) return s;
+    }
+
+    return -1;
+}
+
+
+// Reads the walls of tile i into t.
+static void ReadTile(World *w, Tile *t, int i) {
+    TileIndex ti = w->index[i];
+
+    if (ti.numwalls > t->capacity) {
+        t->capacity = ti.numwalls;
+        t->walls = realloc(t->walls, sizeof(Wall) * t->capacity);
+        check_mem(t->walls);
+    }
+
+    Segment *segs = malloc(sizeof(Segment) * ti.numwalls);
+    check_mem(segs);
+
+    size_t size = sizeof(Segment) * ti.numwalls;
+    ssize_t n = pread(w->fd, segs, size, ti.offset);
+    check(n == (ssize_t)size, "Can't read tile %d", i);
+
+    t->numwalls = n == (ssize_t)size ? ti.numwalls : 0;
+    for (int j = 0; j < t->numwalls; j++) {
+        t->walls[j] = (Wall){ .seg = segs[j], .seen = 0 };
+    }
+
+    free(segs);
+}
+
+
+// Loads the tiles around the center as it moves.
+static void *Stream(void *arg) {
+    World *w = arg;
+
+    pthread_mutex_lock(&w->lock);
+
+    while (!w->quit) {
+        Evict(w);
+
+        int i = NextMissing(w);
+        if (i < 0) {
+            pthread_cond_broadcast(&w->idle);
+            pthread_cond_wait(&w->wake, &w->lock);
+            continue;
+        }
+
+        int s = FreeSlot(w);
+        Tile *t = &w->tiles[s];
+        t->index = i;
+        t->ready = 0;
+
+        // Nothing else touches a slot that isn't ready: read without holding
+        // the lock, so W_GetMap() never waits for the disk.
+        pthread_mutex_unlock(&w->lock);
+        ReadTile(w, t, i);
+        pthread_mutex_lock(&w->lock);
+
+        t->ready = 1;
+        w->changed = 1;
+    }
+
+    pthread_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+
+
+World *W_Open(const char *path, int radius, Vector center) {
+    FILE *f = fopen(path, "rb");
+    check(f, "Can't open world %s", path);
+    if (!f) return NULL;
+
+    World *w = calloc(1, sizeof(World));
+    check_mem(w);
+
+    uint32_t magic = 0;
+    fread(&magic, sizeof(magic), 1, f);
+    fread(&w->tilesize, sizeof(w->tilesize), 1, f);
+    fread(&w->origin, sizeof(w->origin), 1, f);
+    fread(&w->cols, sizeof(w->cols), 1, f);
+    fread(&w->rows, sizeof(w->rows), 1, f);
+
+    if (magic != WORLDMAGIC || w->cols <= 0 || w->rows <= 0) {
+        log_err("Not a world: %s", path);
+        fclose(f);
+        free(w);
+        return NULL;
+    }
+
+    w->index = malloc(sizeof(TileIndex) * w->cols * w->rows);
+    check_mem(w->index);
+    fread(w->index, sizeof(TileIndex), w->cols * w->rows, f);
+
+    w->fd = dup(fileno(f));
+    fclose(f);
+
+    w->radius = radius;
+    w->numtiles = (2 * radius + 3) * (2 * radius + 3);
+    w->tiles = calloc(w->numtiles, sizeof(Tile));
+    check_mem(w->tiles);
+    for (int s = 0; s < w->numtiles; s++) {
+        w->tiles[s].index = -1;
+    }
+
+    w->cx = floor((center.x - w->origin.x) / w->tilesize);
+    w->cy = floor((center.y - w->origin.y) / w->tilesize);
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->wake, NULL);
+    pthread_cond_init(&w->idle, NULL);
+    pthread_create(&w->thread, NULL, Stream, w);
+
+    W_Wait(w);
+
+    return w;
+}
+
+
+void W_Close(World *w) {
+    pthread_mutex_lock(&w->lock);
+    w->quit = 1;
+    pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+
+    pthread_join(w->thread, NULL);
+
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->wake);
+    pthread_cond_destroy(&w->idle);
+
+    for (int s = 0; s < w->numtiles; s++) {
+        free(w->tiles[s].walls);
+    }
+
+    close(w->fd);
+    free(w->tiles);
+    free(w->index);
+    free(w->map.walls);
+    free(w->sources);
+    free(w);
+}
+
+
+void W_SetCenter(World *w, Vector pos) {
+    int cx = floor((pos.x - w->origin.x) / w->tilesize);
+    int cy = floor((pos.y - w->origin.y) / w->tilesize);
+
+    if (cx == w->cx && cy == w->cy) return;
+
+    pthread_mutex_lock(&w->lock);
+    w->cx = cx;
+    w->cy = cy;
+    pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+}
+
+
+// Returns 1 if a tile is being read.
+static int Loading(World *w) {
+    for (int s = 0; s < w->numtiles; s++) {
+        if (w->tiles[s].index >= 0 && !w->tiles[s].ready) return 1;
+    }
+
+    return 0;
+}
+
+
+void W_Wait(World *w) {
+    pthread_mutex_lock(&w->lock);
+    while (NextMissing(w) >= 0 || Loading(w)) {
+        pthread_cond_signal(&w->wake);
+        pthread_cond_wait(&w->idle, &w->lock);
+    }
+    pthread_mutex_unlock(&w->lock);
+}
+
+
+
+// -----------------------------------------------------------------------------
+// Resident map
+// -----------------------------------------------------------------------------
+
+// Returns 1 if wall j of slot s is the copy of its wall the map should use:
+// the one in the first resident tile, in row-major order, that it touches.
+static int IsFirstCopy(World *w, int s, int j) {
+    Tile *t = &w->tiles[s];
+    Segment seg = t->walls[j].seg;
+
+    int range[4];
+    TileRange(w->origin, w->tilesize, w->cols, w->rows, seg, range);
+
+    for (int ty = range[1]; ty <= range[3]; ty++) {
+        for (int tx = range[0]; tx <= range[2]; tx++) {
+            int i = ty * w->cols + tx;
+            if (i == t->index) return 1;
+
+            int other = FindSlot(w, i);
+            if (other >= 0 && w->tiles[other].ready &&
+                    Touches(w->origin, w->tilesize, seg, tx, ty)) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+
+Map *W_GetMap(World *w) {
+    pthread_mutex_lock(&w->lock);
+
+    if (!w->changed) {
+        pthread_mutex_unlock(&w->lock);
+        return &w->map;
+    }
+
+    // Keep what has been seen on the automap, for the tiles still around.
+    for (int i = 0; i < w->map.numwalls; i++) {
+        WallSource src = w->sources[i];
+        Tile *t = &w->tiles[src.slot];
+        if (t->gen == src.gen && t->ready) {
+            t->walls[src.wall].seen = w->map.walls[i].seen;
+        }
+    }
+
+    int count = 0;
+    for (int s = 0; s < w->numtiles; s++) {
+        if (w->tiles[s].index >= 0 && w->tiles[s].ready) {
+            count += w->tiles[s].numwalls;
+        }
+    }
+
+    if (count > w->mapcapacity) {
+        w->mapcapacity = MAX(count, w->mapcapacity * 2);
+        w->map.walls = realloc(w->map.walls, sizeof(Wall) * w->mapcapacity);
+        w->sources = realloc(w->sources, sizeof(WallSource) * w->mapcapacity);
+        check_mem(w->map.walls && w->sources);
+    }
+
+    w->map.numwalls = 0;
+    w->map.arena = NULL;
+
+    for (int s = 0; s < w->numtiles; s++) {
+        Tile *t = &w->tiles[s];
+        if (t->index < 0 || !t->ready) continue;
+
+        for (int j = 0; j < t->numwalls; j++) {
+            if (!IsFirstCopy(w, s, j)) continue;
+
+            w->sources[w->map.numwalls] = (WallSource){ s, t->gen, j };
+            w->map.walls[w->map.numwalls++] = t->walls[j];
+        }
+    }
+
+    w->changed = 0;
+
+    pthread_mutex_unlock(&w->lock);
+
+    return &w->map;
+}
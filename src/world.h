@@ -0,0 +1,91 @@
+//------------------------------------------------------------------------------
+// Streamed worlds
+//
+// A world is a map too big to load at once. It's stored split into square
+// tiles, and a background thread keeps loaded only the tiles around a center
+// point, usually the player. Walls crossing tile borders are stored in every
+// tile they touch.
+//
+// The rest of the engine sees the resident tiles as a regular Map, rebuilt by
+// W_GetMap() when tiles come and go.
+//------------------------------------------------------------------------------
+#ifndef _WORLD_
+#define _WORLD_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "geometry.h"
+#include "map.h"
+
+typedef struct TileIndex {
+    uint64_t offset;    // Where the walls of the tile are in the file
+    uint32_t numwalls;
+} TileIndex;
+
+typedef struct Tile {
+    int index;          // Tile in the slot, -1 if the slot is free
+    int ready;          // 0 while the tile is being loaded
+    uint32_t gen;       // Changes every time the slot is reused
+
+    Wall *walls;
+    int numwalls;
+    int capacity;
+} Tile;
+
+// Where a wall of the resident map comes from.
+typedef struct WallSource {
+    int slot;
+    uint32_t gen;
+    int wall;
+} WallSource;
+
+typedef struct World {
+    int fd;
+    double tilesize;
+    Vector origin;      // World position of the top-left corner of tile 0
+    int cols, rows;
+    TileIndex *index;
+
+    int radius;         // Tiles loaded in every direction from the center
+    int cx, cy;         // Center tile
+
+    Tile *tiles;        // Slots for the resident tiles
+    int numtiles;
+    int changed;        // Whether tiles came or went since the last W_GetMap()
+
+    Map map;            // Walls of the resident tiles...
+    WallSource *sources;    // ... and where they come from
+    int mapcapacity;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;    // The center moved, or it's time to quit
+    pthread_cond_t idle;    // Every tile around the center is loaded
+    int quit;
+} World;
+
+
+// Splits map in tiles of the given size and writes it to path.
+// Returns 0 if the world can't be written, 1 otherwise.
+int W_Build(Map *map, double tilesize, const char *path);
+
+// Opens the world stored in path and loads the tiles up to radius tiles away
+// from center. Returns NULL if it can't be read.
+World *W_Open(const char *path, int radius, Vector center);
+
+// Stops streaming and frees w.
+void W_Close(World *w);
+
+// Moves the center of the area to keep loaded to pos. The tiles are loaded in
+// the background.
+void W_SetCenter(World *w, Vector pos);
+
+// Blocks until every tile around the center is loaded.
+void W_Wait(World *w);
+
+// Returns the walls of the resident tiles. The Map belongs to w and is only
+// valid until the next call.
+Map *W_GetMap(World *w);
+
+#endif
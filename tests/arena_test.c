@@ -0,0 +1,129 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minunit.h"
+
+#include "arena.h"
+
+#define BLOCKSIZE 1024
+#define THREADS 4
+#define ALLOCS 1000
+
+Arena shared;
+
+
+// Fills every allocation with its own number, to tell if any overlap.
+typedef struct Allocs {
+    uint32_t id;
+    uint32_t *p[ALLOCS];
+} Allocs;
+
+
+void *AllocMany(void *arg) {
+    Allocs *allocs = arg;
+    for (int i = 0; i < ALLOCS; i++) {
+        uint32_t *p = A_Alloc(&shared, 6 * sizeof(uint32_t));
+        for (int k = 0; k < 6; k++) p[k] = allocs->id * ALLOCS + i;
+        allocs->p[i] = p;
+    }
+    return NULL;
+}
+
+
+int test_alloc() {
+    Arena a;
+    A_Init(&a, BLOCKSIZE);
+
+    uint8_t *p = A_Alloc(&a, 1);
+    uint8_t *q = A_Alloc(&a, 100);
+    mu_assert(p && q, "Allocates");
+    mu_assert((uintptr_t)p % 16 == 0 && (uintptr_t)q % 16 == 0, "Aligns to 16 bytes");
+    mu_assert(q >= p + 16, "Doesn't overlap");
+    mu_assert(a.used == 16 + 112, "Counts the bytes used, aligned");
+
+    uint8_t *big = A_Alloc(&a, 4 * BLOCKSIZE);
+    mu_assert(big, "Allocates more than a block");
+    memset(big, 0, 4 * BLOCKSIZE);
+    mu_assert(a.highwater == a.used, "Follows the high-water mark");
+
+    void *m = A_Alloc(NULL, 10);
+    mu_assert(m, "Uses malloc without an arena");
+    free(m);
+
+    A_Free(&a);
+    mu_assert(!a.first && !a.used, "Frees everything");
+
+    return 0;
+}
+
+
+int test_reset() {
+    Arena a;
+    A_Init(&a, BLOCKSIZE);
+
+    for (int i = 0; i < 10; i++) {
+        A_Alloc(&a, 512);
+    }
+    size_t highwater = a.highwater;
+    mu_assert(a.first->next, "Grows block by block");
+
+    A_Reset(&a);
+    mu_assert(a.used == 0, "Resets the bytes used");
+    mu_assert(a.highwater == highwater, "Keeps the high-water mark");
+    mu_assert(!a.first->next && a.first->size >= highwater,
+            "Keeps a single block big enough for all of it");
+
+    ArenaBlock *block = a.first;
+    for (int i = 0; i < 10; i++) {
+        A_Alloc(&a, 512);
+    }
+    mu_assert(a.first == block && !block->next, "Doesn't grow the next time around");
+
+    A_Alloc(&a, 16);
+    mu_assert(a.highwater > highwater, "Raises the high-water mark");
+
+    A_Free(&a);
+    return 0;
+}
+
+
+int test_share() {
+    A_Init(&shared, BLOCKSIZE);
+    A_Share(&shared);
+
+    static Allocs allocs[THREADS];
+    pthread_t threads[THREADS];
+    for (int i = 0; i < THREADS; i++) {
+        allocs[i].id = i;
+        pthread_create(&threads[i], NULL, AllocMany, &allocs[i]);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    mu_assert(shared.used == THREADS * ALLOCS * 32, "Counts every allocation");
+
+    int intact = 1;
+    for (int i = 0; i < THREADS; i++) {
+        for (int j = 0; j < ALLOCS; j++) {
+            for (int k = 0; k < 6; k++) intact &= allocs[i].p[j][k] == i * ALLOCS + j;
+        }
+    }
+    mu_assert(intact, "Allocations from several threads don't overlap");
+
+    A_Free(&shared);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_alloc);
+    mu_run_test(test_reset);
+    mu_run_test(test_share);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
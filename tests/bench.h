@@ -0,0 +1,235 @@
+//------------------------------------------------------------------------------
+// Microbenchmarks
+//
+// bench_run() times a piece of code, in batches big enough to time reliably:
+// after a warmup, every batch is a sample, and the median and 99th percentile
+// of the time per operation over the samples are reported.
+//
+//   BENCH_MAIN(all_benches) runs all_benches(). With --json path, the results
+//   are also written to path, and with --profile path, the benches are
+//   profiled into path as folded stacks (see profile.h).
+//
+// bench_max_p99() sets a limit on the 99th percentile of the bench just run.
+// Going over it fails the run, after all the benches have reported.
+//
+// Randomized inputs come from bench_random(), which is seeded the same way
+// every run.
+//
+// Built with -DSTATS, the frame statistics counted by the code under test
+// (see stats.h) are also reported, per operation.
+//------------------------------------------------------------------------------
+#ifndef _bench_h
+#define _bench_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "profile.h"
+
+#ifdef STATS
+#include "stats.h"
+#endif
+
+#define BENCH_WARMUP 20         // Samples thrown away
+#define BENCH_SAMPLES 200       // Samples kept
+#define BENCH_SAMPLENS 20000    // Shortest sample, in ns
+#define BENCH_MAXRESULTS 64
+
+typedef struct BenchResult {
+    char name[64];
+    double median;      // ns per operation
+    double p99;
+    double opss;        // Operations per second, from the median
+    long ops;           // Operations timed
+#ifdef STATS
+    double stats[NUMSTATS];     // Counted per operation
+#endif
+} BenchResult;
+
+static BenchResult bench_results[BENCH_MAXRESULTS];
+static int bench_numresults;
+static int bench_failed;
+
+// Assign results here to keep the compiler from optimizing their code away.
+static volatile double bench_sink;
+
+// State of the benchmark running
+static long bench_batch;
+static int bench_sample;
+static double bench_start;
+static double bench_samples[BENCH_WARMUP + BENCH_SAMPLES];
+static const char *bench_name;
+static long bench_total;        // Operations run, calibration included
+
+static uint64_t bench_state = 0x9E3779B97F4A7C15ULL;
+
+
+static inline double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+// Returns a random number in [min, max), the same sequence every run.
+static inline double bench_random(double min, double max) {
+    // xorshift64*
+    bench_state ^= bench_state >> 12;
+    bench_state ^= bench_state << 25;
+    bench_state ^= bench_state >> 27;
+    uint64_t r = bench_state * 2685821657736338717ULL;
+
+    return min + (max - min) * (r >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+static inline int bench_compare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+static inline void bench_begin(const char *name) {
+    bench_name = name;
+    bench_batch = 1;
+    bench_sample = -1;
+    bench_total = 0;
+#ifdef STATS
+    ST_EndFrame();
+#endif
+}
+
+
+static inline void bench_report() {
+    double *samples = bench_samples + BENCH_WARMUP;
+    qsort(samples, BENCH_SAMPLES, sizeof(double), bench_compare);
+
+    BenchResult r = {
+        .median = samples[BENCH_SAMPLES / 2],
+        .p99 = samples[BENCH_SAMPLES * 99 / 100],
+        .ops = bench_batch * (BENCH_WARMUP + BENCH_SAMPLES),
+    };
+    r.opss = 1e9 / r.median;
+    snprintf(r.name, sizeof(r.name), "%s", bench_name);
+
+    printf("%-36s %12.2f ns/op %12.2f p99 %12.0f ops/s\n",
+            r.name, r.median, r.p99, r.opss);
+
+#ifdef STATS
+    Stats stats = ST_EndFrame();
+    for (int i = 0; i < NUMSTATS; i++) {
+        r.stats[i] = (double)stats.counts[i] / bench_total;
+        if (r.stats[i]) printf("%36s %12.2f %s/op\n", "", r.stats[i], st_names[i]);
+    }
+#endif
+
+    if (bench_numresults < BENCH_MAXRESULTS) {
+        bench_results[bench_numresults++] = r;
+    }
+}
+
+
+// Returns 1 while there are batches to run. The first ones find the batch
+// size.
+static inline int bench_next() {
+    double now = bench_now();
+    if (bench_sample != -1) bench_total += bench_batch;
+
+    if (bench_sample < 0) {
+        // Calibrating
+        if (bench_sample == -2 && now - bench_start < BENCH_SAMPLENS) {
+            bench_batch *= 2;
+        } else if (bench_sample == -2) {
+            bench_sample = 0;
+        } else {
+            bench_sample = -2;
+        }
+    } else {
+        bench_samples[bench_sample++] = (now - bench_start) / bench_batch;
+    }
+
+    if (bench_sample == BENCH_WARMUP + BENCH_SAMPLES) {
+        bench_report();
+        return 0;
+    }
+
+    bench_start = bench_now();
+    return 1;
+}
+
+
+// Times the code after name, one operation, which can use i to pick its
+// inputs. i counts the operations run, across batches, so batches of a single
+// slow operation still go through the inputs.
+#define bench_run(name, ...) do { \
+        bench_begin(name); \
+        while (bench_next()) { \
+            for (long i = bench_total; i < bench_total + bench_batch; i++) { \
+                __VA_ARGS__; \
+            } \
+        } \
+    } while (0)
+
+
+// Fails the run if the 99th percentile of the last bench is over maxns.
+static inline void bench_max_p99(double maxns) {
+    BenchResult *r = &bench_results[bench_numresults - 1];
+    if (r->p99 > maxns) {
+        printf("%-36s FAILED: p99 over %.0f ns\n", r->name, maxns);
+        bench_failed = 1;
+    }
+}
+
+
+static inline void bench_write_json(const char *path) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "Can't write %s\n", path);
+        return;
+    }
+
+    fprintf(f, "[\n");
+    for (int i = 0; i < bench_numresults; i++) {
+        BenchResult *r = &bench_results[i];
+        fprintf(f, "  {\"name\": \"%s\", \"median_ns\": %.3f, \"p99_ns\": %.3f, "
+                "\"ops_per_s\": %.1f, \"ops\": %ld",
+                r->name, r->median, r->p99, r->opss, r->ops);
+#ifdef STATS
+        fprintf(f, ", \"stats\": {");
+        for (int s = 0; s < NUMSTATS; s++) {
+            fprintf(f, "%s\"%s\": %.3f", s ? ", " : "", st_names[s], r->stats[s]);
+        }
+        fprintf(f, "}");
+#endif
+        fprintf(f, "}%s\n", i + 1 < bench_numresults ? "," : "");
+    }
+    fprintf(f, "]\n");
+
+    fclose(f);
+}
+
+
+#define BENCH_MAIN(benches) \
+    int main(int argc, char **argv) {\
+        const char *profile = NULL;\
+        for (int i = 1; i + 1 < argc; i++) {\
+            if (!strcmp(argv[i], "--profile")) profile = argv[i + 1];\
+        }\
+        printf("Running %s ...\n", argv[0]);\
+        if (profile) Pf_Start(PFHZ);\
+        benches();\
+        if (profile) {\
+            Pf_Stop();\
+            Pf_Write(profile);\
+        }\
+        for (int i = 1; i + 1 < argc; i++) {\
+            if (!strcmp(argv[i], "--json")) bench_write_json(argv[i + 1]);\
+        }\
+        printf("\n");\
+        return bench_failed;\
+    }
+
+#endif
@@ -0,0 +1,135 @@
+#include <stdint.h>
+
+#include "minunit.h"
+
+#include "buffer.h"
+#include "color.h"
+
+#define W 16
+#define H 12
+
+
+// Buffer whose pixel (x,y) is its own coordinates.
+static Buffer *Numbered() {
+    Buffer *b = B_CreateBuffer(W, H, NULL);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            B_SetPixel(b, x, y, y << 8 | x);
+        }
+    }
+    return b;
+}
+
+
+int test_views() {
+    Buffer *b = Numbered();
+    Buffer v = B_View(b, 3, 2, 5, 4);
+
+    mu_assert(v.width == 5 && v.height == 4 && v.pitch == W,
+            "Views keep the pitch of their parent");
+    mu_assert(B_GetPixel(&v, 0, 0) == (2 << 8 | 3) && B_GetPixel(&v, 4, 3) == (5 << 8 | 7),
+            "Reads through the pitch");
+
+    B_SetPixel(&v, 1, 1, RED);
+    mu_assert(B_GetPixel(b, 4, 3) == RED, "Writes to the parent's pixels");
+
+    Buffer inner = B_View(&v, 1, 1, 3, 2);
+    mu_assert(inner.parent == b && B_GetPixel(&inner, 0, 0) == RED,
+            "Views of views point into the same pixels");
+
+    B_ClearBuffer(&inner, GREEN);
+    mu_assert(B_GetPixel(b, 4, 3) == GREEN && B_GetPixel(b, 6, 4) == GREEN,
+            "Clears the view");
+    mu_assert(B_GetPixel(b, 3, 3) == (3 << 8 | 3) && B_GetPixel(b, 7, 3) == (3 << 8 | 7) &&
+            B_GetPixel(b, 4, 5) == (5 << 8 | 4), "Leaves what's around it");
+
+    B_DeleteBuffer(b);
+    return 0;
+}
+
+
+int test_blit_views() {
+    Buffer *src = Numbered();
+    Buffer *dest = B_CreateBuffer(W, H, NULL);
+    B_ClearBuffer(dest, BLACK);
+
+    // From a view to a view, both with a pitch wider than them.
+    Buffer from = B_View(src, 2, 1, 4, 3);
+    Buffer to = B_View(dest, 5, 5, 8, 6);
+    B_SetPixel(&from, 1, 1, TRANSPARENT);
+    B_BlitBuffer(&to, &from, 2, 1);
+
+    int copied = 1;
+    for (int y = 0; y < 3; y++) {
+        for (int x = 0; x < 4; x++) {
+            if (x == 1 && y == 1) continue;
+            copied &= B_GetPixel(dest, 7 + x, 6 + y) == ((1 + y) << 8 | (2 + x));
+        }
+    }
+    mu_assert(copied, "Copies the view row by row");
+    mu_assert(B_GetPixel(dest, 8, 7) == BLACK, "Skips transparent pixels");
+    mu_assert(B_GetPixel(dest, 6, 6) == BLACK && B_GetPixel(dest, 11, 6) == BLACK &&
+            B_GetPixel(dest, 7, 9) == BLACK, "Writes nothing around it");
+
+    B_DeleteBuffer(src);
+    B_DeleteBuffer(dest);
+    return 0;
+}
+
+
+int test_dirty() {
+    Buffer *b = B_CreateBuffer(100, 100, NULL);
+    B_TrackDirty(b);
+    mu_assert(b->dirty->count == 1 && b->dirty->rects[0].right == 99 &&
+            b->dirty->rects[0].bottom == 99, "Starts all dirty");
+
+    B_ClearDirty(b);
+    B_MarkDirty(b, (Box){ 10, 20, 10, 20 });
+    B_MarkDirty(b, (Box){ 50, 60, 50, 60 });
+    mu_assert(b->dirty->count == 2, "Keeps apart rectangles apart");
+
+    B_MarkDirty(b, (Box){ 21, 30, 15, 25 });
+    mu_assert(b->dirty->count == 2, "Merges touching rectangles");
+
+    // Bridges the two: everything becomes one.
+    B_MarkDirty(b, (Box){ 25, 55, 25, 55 });
+    Box r = b->dirty->rects[0];
+    mu_assert(b->dirty->count == 1 && r.top == 10 && r.left == 10 &&
+            r.bottom == 60 && r.right == 60, "Merges what the union touches too");
+
+    B_MarkDirty(b, (Box){ -10, 5, 95, 120 });
+    r = b->dirty->rects[b->dirty->count - 1];
+    mu_assert(r.top == 0 && r.right == 99, "Clips to the buffer");
+
+    B_MarkDirty(b, (Box){ 200, 210, 0, 10 });
+    mu_assert(b->dirty->count == 2, "Ignores what's outside");
+
+    B_ClearDirty(b);
+    for (int i = 0; i < MAXDIRTY + 1; i++) {
+        B_MarkDirty(b, (Box){ 3 * i, 3 * i, 3 * i, 3 * i });
+    }
+    r = b->dirty->rects[0];
+    mu_assert(b->dirty->count == 1 && r.top == 0 && r.bottom == 3 * MAXDIRTY,
+            "Merges everything when out of room");
+
+    B_ClearDirty(b);
+    Buffer v = B_View(b, 10, 10, 5, 5);
+    B_BlitBuffer(b, &v, 50, 50);
+    r = b->dirty->rects[0];
+    mu_assert(b->dirty->count == 1 && r.left == 50 && r.right == 54,
+            "Blits mark what they write");
+
+    B_DeleteBuffer(b);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_views);
+    mu_run_test(test_blit_views);
+    mu_run_test(test_dirty);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
@@ -0,0 +1,88 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minunit.h"
+
+#include "buffer.h"
+#include "cache.h"
+
+#define CACHEDIR "/tmp/cache_test"
+#define SOURCE "/tmp/cache_test.png"
+
+
+void WriteSource(const char *contents) {
+    FILE *f = fopen(SOURCE, "w");
+    fputs(contents, f);
+    fclose(f);
+}
+
+
+// Returns the number of cached images.
+int CachedImages() {
+    DIR *dir = opendir(CACHEDIR);
+    if (!dir) return 0;
+
+    int n = 0;
+    struct dirent *e;
+    while ((e = readdir(dir))) {
+        n += strstr(e->d_name, ".tex") != NULL;
+    }
+
+    closedir(dir);
+    return n;
+}
+
+
+int test_cache() {
+    AC_SetDir(CACHEDIR);
+    WriteSource("not really a png");
+
+    mu_assert(!AC_Load(SOURCE, NULL), "Nothing cached yet");
+
+    Buffer *b = B_CreateBuffer(4, 3, NULL);
+    for (int i = 0; i < 12; i++) b->pixels[i] = i * 1000;
+    AC_Store(SOURCE, b);
+
+    Buffer *cached = AC_Load(SOURCE, NULL);
+    mu_assert(cached, "Cached image found");
+    mu_assert(cached->width == 4 && cached->height == 3, "Same size");
+    mu_assert(cached->pixels[11] == 11000, "Same pixels");
+    mu_assert(cached->map && (uintptr_t)cached->pixels % 64 == 0,
+            "Pixels are read in place, aligned");
+
+    cached->pixels[11] = 0;
+    B_DeleteBuffer(cached);
+    cached = AC_Load(SOURCE, NULL);
+    mu_assert(cached->pixels[11] == 11000, "Drawing on them leaves the cache alone");
+    B_DeleteBuffer(cached);
+
+    WriteSource("a different png");
+    mu_assert(!AC_Load(SOURCE, NULL), "Changed sources aren't cached");
+
+    // Left by an older version.
+    FILE *f = fopen(CACHEDIR "/0123456789abcdef.tex", "w");
+    fclose(f);
+
+    mu_assert(CachedImages() == 2, "Old images still there");
+    AC_Store(SOURCE, b);
+    cached = AC_Load(SOURCE, NULL);
+    mu_assert(cached, "Changed source cached");
+    B_DeleteBuffer(cached);
+    mu_assert(CachedImages() == 1, "Images of older contents removed");
+
+    B_DeleteBuffer(b);
+    remove(SOURCE);
+    system("rm -rf " CACHEDIR);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_cache);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
@@ -0,0 +1,91 @@
+// Times collision detection against a vertex, against every wall of maps of
+// growing sizes, and whole moves with their responses.
+#include <stdlib.h>
+
+#include "bench.h"
+
+#include "collision.h"
+#include "defs.h"
+#include "geometry.h"
+#include "map.h"
+
+int CheckPoint(Vector p, Mobile mob, double *distance, double *t0);
+
+static const int sizes[] = { 16, 256, 4096 };
+#define NUMSIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+#define MOBS 1024           // Power of two
+#define WORLD 1000          // Inputs are within [0, WORLD)
+
+
+static Map *RandomMap(int numwalls) {
+    Map *map = calloc(1, sizeof(Map));
+    map->walls = calloc(numwalls, sizeof(Wall));
+    map->numwalls = numwalls;
+
+    for (int i = 0; i < numwalls; i++) {
+        Vector start = { bench_random(0, WORLD), bench_random(0, WORLD) };
+        Vector offset = { bench_random(-60, 60), bench_random(-60, 60) };
+        map->walls[i].seg = (Segment){ start, G_Sum(start, offset) };
+    }
+
+    return map;
+}
+
+
+// Players all over, moving at full speed in any direction.
+static Mobile *RandomMobs() {
+    Mobile *mobs = malloc(sizeof(Mobile) * MOBS);
+
+    for (int i = 0; i < MOBS; i++) {
+        Vector forward = G_Rotate((Vector){1, 0}, bench_random(0, 2 * PI));
+        mobs[i] = (Mobile){
+            .pos = { bench_random(0, WORLD), bench_random(0, WORLD) },
+            .vel = G_Scale(6, forward),
+            .forward = forward,
+            .radius = 8,
+        };
+    }
+
+    return mobs;
+}
+
+
+void all_benches() {
+    char name[64];
+    Mobile *mobs = RandomMobs();
+    int mask = MOBS - 1;
+
+    // Points right in the way, most of the time
+    Vector *points = malloc(sizeof(Vector) * MOBS);
+    for (int i = 0; i < MOBS; i++) {
+        points[i] = G_Sum(mobs[i].pos, G_Scale(bench_random(8, 16), mobs[i].forward));
+    }
+
+    bench_run("CheckPoint", {
+        double d, t;
+        bench_sink = CheckPoint(points[i & mask], mobs[i & mask], &d, &t);
+    });
+
+    for (int s = 0; s < NUMSIZES; s++) {
+        Map *map = RandomMap(sizes[s]);
+
+        snprintf(name, sizeof(name), "Co_CheckCollision/%d", sizes[s]);
+        bench_run(name, {
+            Collision c;
+            bench_sink = Co_CheckCollision(map, mobs[i & mask], &c);
+        });
+
+        snprintf(name, sizeof(name), "Co_Move/%d", sizes[s]);
+        bench_run(name, {
+            bench_sink = Co_Move(map, mobs[i & mask]).pos.x;
+        });
+
+        M_Delete(map);
+    }
+
+    free(points);
+    free(mobs);
+}
+
+BENCH_MAIN(all_benches);
@@ -0,0 +1,252 @@
+// Property tests for collision handling: moves mobiles around random maps and
+// checks that, whatever the walls and velocities,
+//
+//   - no position or velocity is ever NaN or infinite,
+//   - a mobile never ends a step of a move overlapping a wall,
+//   - its center never crosses a wall on the way.
+//
+// Every case is decoded from a string of bytes, so built with -DFUZZING this
+// is also a libFuzzer target (see make fuzz). Otherwise it runs CASES random
+// cases, reports the worst number of steps, and checks that few moves run out
+// of the CO_MAXSTEPS steps with velocity left, stopping short of where they'd
+// slide to.
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minunit.h"
+
+#include "collision.h"
+#include "defs.h"
+#include "geometry.h"
+#include "map.h"
+
+#define MAXWALLS 16
+#define MAXMOVES 32
+#define TOLERANCE EPSILON   // How far into a wall a mobile can end up
+#define CASES 50000
+#define CASESIZE 128        // Bytes in a random case
+#define MAXCUTSHORT 0.025   // Fraction of the moves allowed to run out of
+                            // steps, about 2% now
+
+// A case under test, as decoded
+typedef struct Case {
+    Wall walls[MAXWALLS];
+    Map map;
+    Mobile mob;
+} Case;
+
+// Reads bytes of a case, and zeros once they run out.
+typedef struct Reader {
+    const uint8_t *data;
+    size_t size;
+} Reader;
+
+// Worst cases seen
+int worststeps;
+double worstdepth;
+
+// Moves run, and how many of them ran out of steps before stopping
+long moves;
+long cutshort;
+
+// The last move tried
+Mobile moving;
+
+
+static uint8_t Byte(Reader *r) {
+    if (!r->size) return 0;
+    r->size--;
+    return *r->data++;
+}
+
+
+// Coordinates are in [-64, 64), on a grid of half units, so walls often
+// share vertices and line up exactly, as they do in maps.
+static double Coord(Reader *r) {
+    return (int8_t)Byte(r) * 0.5;
+}
+
+
+// Sometimes off the grid, to get all angles.
+static double Fraction(Reader *r) {
+    return Byte(r) / 256.0;
+}
+
+
+// Returns how far mob is into the walls of map, at most. Negative if it's
+// clear of them.
+static double Depth(Map *map, Mobile mob) {
+    double depth = -DBL_MAX;
+    for (int i = 0; i < map->numwalls; i++) {
+        double d = mob.radius - G_SegmentPointDistance(map->walls[i].seg, mob.pos);
+        depth = MAX(depth, d);
+    }
+    return depth;
+}
+
+
+// Returns 0 if the case can't be decoded into a valid start: one with the
+// mobile clear of every wall.
+static int Decode(Reader *r, Case *c) {
+    int numwalls = 1 + Byte(r) % MAXWALLS;
+    Vector last = {0, 0};
+
+    for (int i = 0; i < numwalls; i++) {
+        uint8_t flags = Byte(r);
+        Segment s;
+
+        // Continuing the last wall, as rooms and corners do
+        s.start = flags & 1 && i ? last : (Vector){Coord(r), Coord(r)};
+        s.end = (Vector){Coord(r), Coord(r)};
+        if (flags & 2) {
+            s.end.x += Fraction(r);
+            s.end.y += Fraction(r);
+        }
+
+        if (VEQ(s.start, s.end)) return 0;
+
+        c->walls[i] = (Wall){ .seg = s };
+        last = s.end;
+    }
+
+    c->map = (Map){ .walls = c->walls, .numwalls = numwalls };
+
+    c->mob = (Mobile){
+        .pos = {Coord(r) + Fraction(r), Coord(r) + Fraction(r)},
+        .forward = {1, 0},
+        .radius = 1 + Byte(r) % 16,
+    };
+
+    return Depth(&c->map, c->mob) < 0;
+}
+
+
+// Moves the mobile of the case with the velocities that follow in r, as if
+// keys were held, and returns an error message if anything went wrong.
+static const char *Run(Reader *r, Case *c) {
+    Mobile mob = c->mob;
+
+    for (int m = 0; m < MAXMOVES && r->size; m++) {
+        // Up to 32 units a tick, twice the biggest radius
+        mob.vel = (Vector){Coord(r) / 2 + Fraction(r), Coord(r) / 2 + Fraction(r)};
+
+        Trace trace;
+        moving = mob;
+        Mobile moved = Co_MoveTraced(&c->map, mob, &trace);
+        mob.pos = moved.pos;
+        worststeps = MAX(worststeps, trace.steps);
+
+        // Out of steps with velocity left, which Co_MoveTraced would have
+        // kept sliding with
+        moves++;
+        if (trace.steps == CO_MAXSTEPS && !ISZERO(G_Length(moved.vel)) &&
+                G_Dot(mob.vel, moved.vel) >= 0) {
+            cutshort++;
+        }
+
+        for (int k = 1; k <= trace.steps; k++) {
+            Vector p = trace.pos[k];
+            if (!isfinite(p.x) || !isfinite(p.y)) {
+                return "Position isn't finite";
+            }
+
+            double depth = Depth(&c->map, (Mobile){ .pos = p, .radius = mob.radius });
+            worstdepth = MAX(worstdepth, depth);
+            if (depth > TOLERANCE) {
+                return "Ended a step overlapping a wall";
+            }
+
+            Segment path = { trace.pos[k - 1], p };
+            for (int i = 0; i < c->map.numwalls; i++) {
+                if (G_SegmentSegmentIntersection(path, c->walls[i].seg, NULL)) {
+                    return "Went through a wall";
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+// Returns an error message if the case in data breaks any property, NULL
+// otherwise.
+static const char *CheckCase(const uint8_t *data, size_t size) {
+    Reader r = { data, size };
+    Case c;
+
+    if (!Decode(&r, &c)) return NULL;
+
+    return Run(&r, &c);
+}
+
+
+#ifdef FUZZING
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    const char *error = CheckCase(data, size);
+    if (error) {
+        fprintf(stderr, "%s\n", error);
+        abort();
+    }
+    return 0;
+}
+
+#else
+
+// Prints a failing case, so it can be turned into a regression test.
+static void PrintCase(const uint8_t *data, size_t size) {
+    Reader r = { data, size };
+    Case c;
+    Decode(&r, &c);
+
+    printf("\tMobile at (%g, %g), radius %g, in:\n", c.mob.pos.x, c.mob.pos.y,
+            c.mob.radius);
+    for (int i = 0; i < c.map.numwalls; i++) {
+        Segment s = c.walls[i].seg;
+        printf("\t\t(%g, %g) - (%g, %g)\n", s.start.x, s.start.y, s.end.x, s.end.y);
+    }
+    printf("\tFailed moving from (%.17g, %.17g) at (%.17g, %.17g)\n",
+            moving.pos.x, moving.pos.y, moving.vel.x, moving.vel.y);
+}
+
+
+int test_random_cases() {
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    uint8_t data[CASESIZE];
+
+    for (int n = 0; n < CASES; n++) {
+        for (int i = 0; i < CASESIZE; i++) {
+            // xorshift64*
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            data[i] = (state * 2685821657736338717ULL) >> 56;
+        }
+
+        const char *error = CheckCase(data, CASESIZE);
+        if (error) PrintCase(data, CASESIZE);
+        mu_assert(!error, "Case %d: %s", n, error);
+    }
+
+    printf("\tWorst case: %d steps, %g into a wall\n", worststeps, worstdepth);
+    printf("\t%ld of %ld moves cut short\n", cutshort, moves);
+    mu_assert(cutshort <= MAXCUTSHORT * moves, "%ld of %ld moves ran out of steps",
+            cutshort, moves);
+
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_random_cases);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
+
+#endif
@@ -1,3 +1,4 @@
+#include <math.h>
 #include <stdlib.h>
 
 #include "minunit.h"
@@ -23,6 +24,21 @@ int test_check_point() {
     mu_assert(EQ(distance, 2), "Gets the distance right");
     mu_assert(EQ(t0, 0.5), "Gets the time right");
 
+    // Moving past it, away from it and sideways while touching it
+    mob.vel = (Vector){0, 2};
+    mu_assert(!CheckPoint(point, mob, NULL, NULL), "Misses what it passes by");
+    mob.vel = (Vector){-2, 0};
+    mu_assert(!CheckPoint(point, mob, NULL, NULL), "Misses what it leaves behind");
+    mob.pos = (Vector){1, 0};
+    mob.vel = (Vector){0, 2};
+    mu_assert(!CheckPoint(point, mob, NULL, NULL), "Slides past what it touches");
+
+    // Glancing off it
+    mob.pos = (Vector){0, 0.5};
+    mob.vel = (Vector){4, 0};
+    mu_assert(CheckPoint(point, mob, NULL, &t0), "Detects a glancing collision");
+    mu_assert(EQ(t0, (2 - sqrt(0.75)) / 4), "Gets the glancing time right");
+
     return 0;
 }
 
@@ -0,0 +1,103 @@
+#include <stdio.h>
+
+#include "minunit.h"
+
+#include "config.h"
+#include "player.h"
+
+#define CONFIG "/tmp/config_test.cfg"
+
+
+int test_load() {
+    FILE *f = fopen(CONFIG, "w");
+    fprintf(f, "# Comment\n\n  fov = 90  \nwidth=320\nbogus = 1\nfar = lots\n");
+    fclose(f);
+
+    double fov = 75, far = 300;
+    int width = 640;
+    CfVar vars[] = {
+        { "fov", CF_DOUBLE, &fov, 1, 179 },
+        { "far", CF_DOUBLE, &far, 1, 1000 },
+        { "width", CF_INT, &width, 16, 4096 },
+    };
+
+    mu_assert(Cf_Load(CONFIG, vars, 3), "Config read");
+    mu_assert(fov == 90, "Doubles set");
+    mu_assert(width == 320, "Ints set");
+    mu_assert(far == 300, "Bad values skipped");
+
+    mu_assert(!Cf_Load("/tmp/no_such_config.cfg", vars, 3), "Missing config");
+
+    remove(CONFIG);
+    return 0;
+}
+
+
+int test_ranges() {
+    FILE *f = fopen(CONFIG, "w");
+    fprintf(f, "tickrate = 0\nwidth = -320\nfov = 180\nfar = inf\nnear = nan\n"
+            "height = 2.5\nradius = 4\nspeed = 1000\n");
+    fclose(f);
+
+    int tickrate = 60, width = 640, height = 400;
+    double fov = 75, far = 300, near = 1, radius = 8, speed = 6;
+    CfVar vars[] = {
+        { "tickrate", CF_INT, &tickrate, 1, 1000 },
+        { "width", CF_INT, &width, 16, 4096 },
+        { "height", CF_INT, &height, 16, 4096 },
+        { "fov", CF_DOUBLE, &fov, 1, 179 },
+        { "far", CF_DOUBLE, &far, 1, 1000 },
+        { "near", CF_DOUBLE, &near, 0.01, 100 },
+        { "radius", CF_DOUBLE, &radius, 0.5, 256 },
+        { "speed", CF_DOUBLE, &speed, 0, 1000 },
+    };
+
+    mu_assert(Cf_Load(CONFIG, vars, sizeof(vars) / sizeof(vars[0])), "Config read");
+    mu_assert(tickrate == 60 && width == 640 && fov == 75,
+            "Values out of range skipped");
+    mu_assert(far == 300 && near == 1, "Infinities and NaNs skipped");
+    mu_assert(height == 400, "Fractions skipped for ints");
+    mu_assert(radius == 4 && speed == 1000, "Values in range set, limits included");
+
+    remove(CONFIG);
+    return 0;
+}
+
+
+int test_settings() {
+    FILE *f = fopen(CONFIG, "w");
+    fprintf(f, "width = 320\nfov = 90\ntickrate = 30\nspeed = 3\nradius = 4\n");
+    fclose(f);
+
+    Movement m = p_defaultmovement;
+    double radius = p_defaultradius;
+    int tickrate = 60;
+    mu_assert(P_LoadSettings(CONFIG, &m, &radius, &tickrate), "Settings read");
+    mu_assert(tickrate == 30 && m.speed == 3 && radius == 4, "Player settings set");
+    mu_assert(m.accel == p_defaultmovement.accel, "Other settings kept");
+
+    // The engine binds the rest itself.
+    CfVar vars[P_NUMSETTINGS];
+    int numvars = P_SettingsTable(vars, NULL, NULL, NULL);
+    int width = 640;
+    double fov = 75;
+    mu_assert(Cf_Bind(vars, numvars, "width", &width), "width in the table");
+    mu_assert(Cf_Bind(vars, numvars, "fov", &fov), "fov in the table");
+    mu_assert(!Cf_Bind(vars, numvars, "bogus", &fov), "No bogus setting");
+    mu_assert(Cf_Load(CONFIG, vars, numvars), "Settings read");
+    mu_assert(width == 320 && fov == 90, "Bound settings set");
+
+    remove(CONFIG);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_load);
+    mu_run_test(test_ranges);
+    mu_run_test(test_settings);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
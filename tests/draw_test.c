@@ -0,0 +1,59 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "minunit.h"
+
+#include "buffer.h"
+#include "color.h"
+#include "draw.h"
+#include "geometry.h"
+
+#define W 64
+#define H 48
+
+
+// Segments drawn in pieces, as the editor does a dirty area at a time, must
+// end up as if drawn whole.
+int test_segment_in() {
+    Buffer *whole = B_CreateBuffer(W, H, NULL);
+    Buffer *pieces = B_CreateBuffer(W, H, NULL);
+
+    Segment segments[] = {
+        { {1.5, 2.25}, {62.75, 40.5} },
+        { {60, 3}, {4.5, 45} },
+        { {-20, 10}, {90, 30} },
+        { {10, 47}, {11, -5} },
+    };
+    Box areas[] = {
+        { 0, 20, 0, 30 },
+        { 0, 20, 31, 63 },
+        { 21, 47, 0, 17 },
+        { 21, 47, 18, 63 },
+    };
+
+    for (int i = 0; i < 4; i++) {
+        B_ClearBuffer(whole, BLACK);
+        B_ClearBuffer(pieces, BLACK);
+
+        D_DrawSegment(whole, segments[i], WHITE);
+        for (int j = 0; j < 4; j++) {
+            D_DrawSegmentIn(pieces, segments[i], areas[j], WHITE);
+        }
+
+        mu_assert(!memcmp(whole->pixels, pieces->pixels, sizeof(uint32_t) * W * H),
+                "Segment %d drawn in pieces is the same", i);
+    }
+
+    B_DeleteBuffer(whole);
+    B_DeleteBuffer(pieces);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_segment_in);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
@@ -0,0 +1,74 @@
+// Times the geometry primitives under the renderer, the collisions and the
+// map view, over random inputs of growing sizes.
+#include <stdlib.h>
+
+#include "bench.h"
+
+#include "defs.h"
+#include "geometry.h"
+
+static const int sizes[] = { 16, 4096, 262144 };
+#define NUMSIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+#define WORLD 1000          // Inputs are within [0, WORLD)
+
+
+static Vector RandomPoint() {
+    return (Vector){ bench_random(0, WORLD), bench_random(0, WORLD) };
+}
+
+
+static Segment RandomSegment() {
+    Vector start = RandomPoint();
+    Vector offset = { bench_random(-100, 100), bench_random(-100, 100) };
+    return (Segment){ start, G_Sum(start, offset) };
+}
+
+
+void all_benches() {
+    Box box = { 200, 800, 200, 800 };
+    char name[64];
+
+    for (int s = 0; s < NUMSIZES; s++) {
+        int n = sizes[s];
+        int mask = n - 1;
+
+        Segment *segs = malloc(sizeof(Segment) * n);
+        Line *rays = malloc(sizeof(Line) * n);
+        Vector *points = malloc(sizeof(Vector) * n);
+
+        for (int i = 0; i < n; i++) {
+            segs[i] = RandomSegment();
+            rays[i] = (Line){
+                RandomPoint(),
+                G_Rotate((Vector){1, 0}, bench_random(0, 2 * PI))
+            };
+            points[i] = RandomPoint();
+        }
+
+        snprintf(name, sizeof(name), "G_SegmentRayIntersection/%d", n);
+        bench_run(name, {
+            Vector hit;
+            bench_sink = G_SegmentRayIntersection(segs[i & mask],
+                    rays[(i * 7) & mask], &hit);
+        });
+
+        snprintf(name, sizeof(name), "G_ClipSegment/%d", n);
+        bench_run(name, {
+            Segment out;
+            bench_sink = G_ClipSegment(segs[i & mask], box, &out);
+        });
+
+        snprintf(name, sizeof(name), "G_SegmentPointDistance/%d", n);
+        bench_run(name, {
+            bench_sink = G_SegmentPointDistance(segs[i & mask],
+                    points[(i * 7) & mask]);
+        });
+
+        free(segs);
+        free(rays);
+        free(points);
+    }
+}
+
+BENCH_MAIN(all_benches);
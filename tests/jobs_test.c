@@ -0,0 +1,42 @@
+#include <stdint.h>
+
+#include "minunit.h"
+
+#include "jobs.h"
+
+#define NUMJOBS 64
+
+
+void *Square(void *arg) {
+    intptr_t n = (intptr_t)arg;
+    return (void *)(n * n);
+}
+
+
+int test_jobs() {
+    JobPool pool;
+    J_Init(&pool, 4);
+
+    Job jobs[NUMJOBS];
+    for (intptr_t i = 0; i < NUMJOBS; i++) {
+        J_Submit(&pool, &jobs[i], "square", Square, (void *)i);
+    }
+
+    // Out of order on purpose.
+    for (int i = NUMJOBS - 1; i >= 0; i--) {
+        mu_assert((intptr_t)J_Wait(&jobs[i]) == i * i, "Every job returns its result");
+        mu_assert(jobs[i].took >= 0 && jobs[i].waited >= 0, "Jobs are timed");
+    }
+
+    J_Quit(&pool);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_jobs);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
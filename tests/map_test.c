@@ -0,0 +1,112 @@
+#include <stdio.h>
+
+#include "minunit.h"
+
+#include "defs.h"
+#include "geometry.h"
+#include "map.h"
+
+#define MAP "/tmp/map_test.map"
+
+
+int test_journal() {
+    FILE *f = fopen(MAP, "w");
+    fprintf(f, "0 0 10 0\n10 0 10 10\n");
+    fclose(f);
+
+    Edit edits[] = {
+        { .type = EDIT_ADD, .seg = { {10, 10}, {0, 10} } },
+        { .type = EDIT_DELETE, .seg = { {0, 0}, {10, 0} } },
+        { .type = EDIT_MOVE, .seg = { {10, 0}, {10, 10} }, .to = { {20, 0}, {20, 10} } },
+    };
+    mu_assert(M_AppendJournal(MAP, edits, 3), "Journal written");
+    mu_assert(M_JournalLength(MAP) == 3, "Journal has every edit");
+
+    Map *m = M_Load(MAP, NULL);
+    mu_assert(m->numwalls == 2, "Journal replayed");
+    mu_assert(SEGEQ(m->walls[0].seg, edits[0].seg), "Added wall replaces deleted one");
+    mu_assert(SEGEQ(m->walls[1].seg, edits[2].to), "Wall moved");
+
+    M_Save(m, MAP);
+    mu_assert(M_JournalLength(MAP) == 0, "Saving removes the journal");
+
+    Map *saved = M_Load(MAP, NULL);
+    mu_assert(M_Hash(saved) == M_Hash(m), "Saved map is the same");
+
+    // The hash kept from saving must be the one of the file.
+    mu_assert(M_AppendJournal(MAP, edits, 1), "Journal written");
+    mu_assert(M_JournalLength(MAP) == 1, "Journal of the saved snapshot used");
+
+    // So must the one kept from reading it, once it's changed.
+    f = fopen(MAP, "r+");
+    fputc('9', f);
+    fclose(f);
+    mu_assert(M_JournalLength(MAP) == 0, "Snapshot rewritten in place noticed");
+    remove(MAP ".journal");
+
+    // A snapshot written after the journal makes it stale.
+    mu_assert(M_AppendJournal(MAP, edits, 1), "Journal written");
+    mu_assert(M_JournalLength(MAP) == 1, "Journal of the changed snapshot used");
+    f = fopen(MAP, "a");
+    fprintf(f, "5 5 6 6\n");
+    fclose(f);
+    mu_assert(M_JournalLength(MAP) == 0, "Stale journal ignored");
+
+    M_Delete(m);
+    M_Delete(saved);
+    remove(MAP);
+    remove(MAP ".journal");
+    return 0;
+}
+
+
+int test_missing() {
+    remove(MAP);
+    mu_assert(!M_Load(MAP, NULL), "Missing maps aren't loaded");
+
+    // A journal left behind by a map that's gone.
+    FILE *f = fopen(MAP ".journal", "w");
+    fprintf(f, "base 0\nA 0 0 10 0\n");
+    fclose(f);
+    mu_assert(!M_Load(MAP, NULL), "Nor their journals");
+
+    remove(MAP ".journal");
+    return 0;
+}
+
+
+int test_diff() {
+    Wall wa[] = {
+        { .seg = { {0, 0}, {10, 0} } },
+        { .seg = { {10, 0}, {10, 10} } },
+        { .seg = { {10, 10}, {0, 10} } },
+    };
+    Wall wb[] = {
+        { .seg = { {10, 10}, {0, 10} } },
+        { .seg = { {0, 0}, {10, 0} } },
+        { .seg = { {20, 0}, {20, 10} } },
+    };
+    Map a = { wa, 3, NULL };
+    Map b = { wb, 3, NULL };
+
+    int from[3];
+    Box changed;
+    mu_assert(M_Diff(&a, &b, from, &changed) == 2, "One wall moved");
+    mu_assert(from[0] == 2 && from[1] == 0 && from[2] == -1, "Walls matched");
+    mu_assert(changed.left == 10 && changed.right == 20 &&
+            changed.top == 0 && changed.bottom == 10, "Changes located");
+
+    mu_assert(M_Diff(&a, &a, from, &changed) == 0, "No changes");
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_journal);
+    mu_run_test(test_missing);
+    mu_run_test(test_diff);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
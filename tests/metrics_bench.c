@@ -0,0 +1,33 @@
+// Times writing metrics, which has to be cheap enough to do anywhere.
+#include "bench.h"
+
+#include "metrics.h"
+
+
+void all_benches() {
+    Metrics ms;
+    Mt_Init(&ms);
+
+    Metric *c = Mt_Counter(&ms, "bench_total", "Counter");
+    Metric *g = Mt_Gauge(&ms, "bench_gauge", "Gauge", 1);
+    Metric *h = Mt_Histogram(&ms, "bench_seconds", "Histogram", 1e-6);
+
+    bench_run("Mt_Add", Mt_Add(c, 1));
+    bench_run("Mt_Set", Mt_Set(g, i));
+    bench_run("Mt_Observe", Mt_Observe(h, i & 0xffff));
+
+    static MtRing ring;
+    uint32_t values[MTFIELDS] = { 1, 2, 3, 4 };
+    bench_run("Mt_Push", {
+        values[0] = i;
+        Mt_Push(&ring, values);
+    });
+
+    uint32_t latest[100][MTFIELDS];
+    bench_run("Mt_Latest/100", bench_sink = Mt_Latest(&ring, latest, 100));
+
+    bench_sink = Mt_Value(c) + Mt_Count(h);
+    Mt_Free(&ms);
+}
+
+BENCH_MAIN(all_benches);
@@ -0,0 +1,250 @@
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "minunit.h"
+
+#include "metrics.h"
+
+#define PORT (MTPORT + 1)
+#define THREADS 8
+#define ADDS 100000
+
+Metrics metrics;
+MtRing ring;
+_Atomic int pushing;
+
+
+void *AddMany(void *arg) {
+    Metric *m = arg;
+    for (int i = 0; i < ADDS; i++) {
+        Mt_Add(m, 1);
+    }
+    return NULL;
+}
+
+
+// Pushes samples whose values are all the same, so torn ones show.
+void *PushMany(void *arg) {
+    for (uint32_t i = 0; pushing; i++) {
+        uint32_t values[MTFIELDS] = { i, i, i, i };
+        Mt_Push(&ring, values);
+    }
+    return NULL;
+}
+
+
+// Returns what Mt_Write writes, to be freed.
+char *Written(Metrics *ms) {
+    char *text;
+    size_t len;
+    FILE *f = open_memstream(&text, &len);
+    Mt_Write(ms, f);
+    fclose(f);
+    return text;
+}
+
+
+int test_counters() {
+    Mt_Init(&metrics);
+    Metric *c = Mt_Counter(&metrics, "test_adds_total", "Adds");
+
+    pthread_t threads[THREADS];
+    for (int i = 0; i < THREADS; i++) {
+        pthread_create(&threads[i], NULL, AddMany, c);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    mu_assert(Mt_Value(c) == THREADS * ADDS, "No add is lost");
+    mu_assert(Mt_Find(&metrics, "test_adds_total") == c, "Finds metrics by name");
+
+    Metric *g = Mt_Gauge(&metrics, "test_level_bytes", "Level", 1024);
+    Mt_Set(g, 3);
+    Mt_Set(g, 2);
+    mu_assert(Mt_Value(g) == 2, "Gauges keep the last value");
+
+    char *text = Written(&metrics);
+    mu_assert(strstr(text, "# TYPE test_adds_total counter\ntest_adds_total 800000\n"),
+            "Writes counters");
+    mu_assert(strstr(text, "test_level_bytes 2048\n"), "Writes gauges in their unit");
+    free(text);
+
+    Mt_Free(&metrics);
+    return 0;
+}
+
+
+int test_histograms() {
+    Mt_Init(&metrics);
+    Metric *h = Mt_Histogram(&metrics, "test_tick_seconds", "Ticks", 0.001);
+
+    uint64_t values[] = { 0, 1, 2, 3, 4, 5, 100, 1 << 20 };
+    for (int i = 0; i < 8; i++) {
+        Mt_Observe(h, values[i]);
+    }
+
+    mu_assert(Mt_Count(h) == 8, "Counts the values");
+    mu_assert(Mt_Value(h) == 115 + (1 << 20), "Adds up the values");
+
+    char *text = Written(&metrics);
+    mu_assert(strstr(text, "test_tick_seconds_bucket{le=\"0.001\"} 2\n"),
+            "Counts what's under the first bound");
+    mu_assert(strstr(text, "test_tick_seconds_bucket{le=\"0.002\"} 3\n") &&
+            strstr(text, "test_tick_seconds_bucket{le=\"0.004\"} 5\n") &&
+            strstr(text, "test_tick_seconds_bucket{le=\"0.128\"} 7\n"),
+            "Buckets are cumulative");
+    mu_assert(strstr(text, "test_tick_seconds_bucket{le=\"16.384\"} 7\n") &&
+            strstr(text, "test_tick_seconds_bucket{le=\"+Inf\"} 8\n"),
+            "Counts what's over the last bound");
+    mu_assert(strstr(text, "test_tick_seconds_count 8\n"), "Writes the count");
+    free(text);
+
+    Mt_Free(&metrics);
+    return 0;
+}
+
+
+int test_ring() {
+    uint32_t latest[MTRINGLEN][MTFIELDS];
+
+    mu_assert(Mt_Latest(&ring, latest, MTRINGLEN) == 0, "Starts empty");
+
+    for (uint32_t i = 0; i < 200; i++) {
+        uint32_t values[MTFIELDS] = { i, i, i, i };
+        Mt_Push(&ring, values);
+    }
+
+    mu_assert(Mt_Latest(&ring, latest, 10) == 10, "Copies as many as asked");
+    mu_assert(latest[0][0] == 199 && latest[9][0] == 190, "The latest first");
+    mu_assert(Mt_Latest(&ring, latest, 1000) == MTRINGLEN, "Keeps MTRINGLEN");
+
+    // Reading while several threads write
+    pushing = 1;
+    pthread_t threads[THREADS / 2];
+    for (int i = 0; i < THREADS / 2; i++) {
+        pthread_create(&threads[i], NULL, PushMany, NULL);
+    }
+
+    int torn = 0, read = 0;
+    for (int n = 0; n < 10000; n++) {
+        int copied = Mt_Latest(&ring, latest, MTRINGLEN);
+        for (int i = 0; i < copied; i++) {
+            torn += latest[i][0] != latest[i][MTFIELDS - 1];
+        }
+        read += copied;
+    }
+
+    pushing = 0;
+    for (int i = 0; i < THREADS / 2; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    mu_assert(read > 0, "Reads while writing");
+    mu_assert(!torn, "Never reads half written samples");
+
+    return 0;
+}
+
+
+int test_endpoint() {
+    Mt_Init(&metrics);
+    Metric *c = Mt_Counter(&metrics, "test_requests_total", "Requests");
+    Mt_Add(c, 42);
+
+    mu_assert(Mt_Serve(&metrics, PORT), "Serves");
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    mu_assert(!connect(sock, (struct sockaddr *)&addr, sizeof(addr)),
+            "Takes connections");
+
+    const char *request = "GET /metrics HTTP/1.0\r\n\r\n";
+    send(sock, request, strlen(request), 0);
+
+    char response[4096];
+    int len = 0, n;
+    while ((n = recv(sock, response + len, sizeof(response) - 1 - len, 0)) > 0) {
+        len += n;
+    }
+    response[len] = '\0';
+    close(sock);
+
+    mu_assert(!strncmp(response, "HTTP/1.0 200 OK\r\n", 17), "Answers");
+    mu_assert(strstr(response, "\r\n\r\n# HELP test_requests_total Requests\n"),
+            "Sends the metrics");
+    mu_assert(strstr(response, "test_requests_total 42\n"), "Sends their values");
+
+    Mt_Free(&metrics);
+    return 0;
+}
+
+
+// Clients that hang up before the answer is sent mustn't kill the server.
+int test_hangup() {
+    // An answer too long to be sent at once.
+    static char names[MTMAX][32];
+    Mt_Init(&metrics);
+    for (int i = 0; i < MTMAX; i++) {
+        snprintf(names[i], sizeof(names[i]), "test_latency_%d", i);
+        Mt_Histogram(&metrics, names[i], "Latency", 1);
+    }
+
+    mu_assert(Mt_Serve(&metrics, PORT + 1), "Serves");
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(PORT + 1),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    const char *request = "GET /metrics HTTP/1.0\r\n\r\n";
+
+    for (int i = 0; i < 20; i++) {
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+        send(sock, request, strlen(request), 0);
+
+        // Read a little of the answer, then reset the connection.
+        char some[64];
+        recv(sock, some, sizeof(some), 0);
+        struct linger reset = { .l_onoff = 1, .l_linger = 0 };
+        setsockopt(sock, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        close(sock);
+    }
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    mu_assert(!connect(sock, (struct sockaddr *)&addr, sizeof(addr)),
+            "Still takes connections");
+    send(sock, request, strlen(request), 0);
+
+    char response[64];
+    int n = recv(sock, response, sizeof(response) - 1, MSG_WAITALL);
+    close(sock);
+    mu_assert(n > 17 && !strncmp(response, "HTTP/1.0 200 OK\r\n", 17), "Still answers");
+
+    Mt_Free(&metrics);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_counters);
+    mu_run_test(test_histograms);
+    mu_run_test(test_ring);
+    mu_run_test(test_endpoint);
+    mu_run_test(test_hangup);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
@@ -31,6 +31,7 @@
         printf("Running %s ...\n", argv[0]);\
         tests();\
         printf("%d Tests, %d failures.\n\n", ntests, failures);\
+        return failures != 0;\
     }
 
 static int ntests;
@@ -0,0 +1,100 @@
+// Times path queries across a big arena full of pillars, both new ones, which
+// search, and repeated ones, which come from the cache. New ones must take
+// under a millisecond, even the slowest.
+#include <stdlib.h>
+
+#include "bench.h"
+
+#include "defs.h"
+#include "geometry.h"
+#include "map.h"
+#include "nav.h"
+
+#define WORLD 1024          // Side of the arena
+#define PILLARS 16          // Per side of the arena
+#define PILLAR 24           // Biggest pillar side
+#define RADIUS 8
+#define CELLSIZE 4          // 256x256 cells
+#define QUERIES 4096        // Power of two
+#define REPEATED 64         // Queries the cached case cycles through
+#define MAXNEW 1e6          // Slowest new query allowed, in ns
+
+
+static void AddWall(Map *map, double x0, double y0, double x1, double y1) {
+    map->walls[map->numwalls++].seg = (Segment){ {x0, y0}, {x1, y1} };
+}
+
+
+static void AddBox(Map *map, double left, double top, double right, double bottom) {
+    AddWall(map, left, top, right, top);
+    AddWall(map, right, top, right, bottom);
+    AddWall(map, right, bottom, left, bottom);
+    AddWall(map, left, bottom, left, top);
+}
+
+
+static Map *PillarMap() {
+    Map *map = calloc(1, sizeof(Map));
+    map->walls = calloc(4 * (PILLARS * PILLARS + 1), sizeof(Wall));
+
+    AddBox(map, 0, 0, WORLD, WORLD);
+
+    double gap = (double)WORLD / PILLARS;
+    for (int i = 0; i < PILLARS * PILLARS; i++) {
+        double left = (i % PILLARS) * gap + bench_random(RADIUS, gap - PILLAR);
+        double top = (i / PILLARS) * gap + bench_random(RADIUS, gap - PILLAR);
+        double side = bench_random(PILLAR / 2, PILLAR);
+        AddBox(map, left, top, left + side, top + side);
+    }
+
+    return map;
+}
+
+
+static Vector RandomWalkable(NavGrid *nav) {
+    Vector p;
+    do {
+        p = (Vector){ bench_random(0, WORLD), bench_random(0, WORLD) };
+    } while (!N_IsWalkable(nav, p));
+    return p;
+}
+
+
+void all_benches() {
+    Map *map = PillarMap();
+    NavGrid *nav = N_Build(map, RADIUS, CELLSIZE, NULL);
+
+    Vector *from = malloc(sizeof(Vector) * QUERIES);
+    Vector *to = malloc(sizeof(Vector) * QUERIES);
+    for (int i = 0; i < QUERIES; i++) {
+        from[i] = RandomWalkable(nav);
+        to[i] = RandomWalkable(nav);
+    }
+
+    Vector points[256];
+    int mask = QUERIES - 1;
+
+    // Dropping the cache every time, for every query to search. That takes
+    // about a microsecond of it.
+    bench_run("N_FindPath/new", {
+        N_Invalidate(nav);
+        bench_sink = N_FindPath(nav, from[i & mask], to[i & mask], points, 256);
+    });
+    bench_max_p99(MAXNEW);
+
+    // Cached before timing, for the first time through not to search.
+    for (int q = 0; q < REPEATED; q++) {
+        N_FindPath(nav, from[q], to[q], points, 256);
+    }
+    bench_run("N_FindPath/cached", {
+        int q = i % REPEATED;
+        bench_sink = N_FindPath(nav, from[q], to[q], points, 256);
+    });
+
+    free(from);
+    free(to);
+    N_Delete(nav);
+    M_Delete(map);
+}
+
+BENCH_MAIN(all_benches);
@@ -0,0 +1,138 @@
+#include <stdlib.h>
+
+#include "minunit.h"
+
+#include "defs.h"
+#include "geometry.h"
+#include "map.h"
+#include "nav.h"
+
+// A 100x100 room split by a wall with a gap at the bottom.
+//
+//  +-----+-----+
+//  |     |     |
+//  |  A  |  B  |
+//  |     |     |
+//  |           |
+//  +-----------+
+Map *CreateRoom() {
+    Map *m = malloc(sizeof(Map));
+    m->arena = NULL;
+    m->numwalls = 5;
+    m->walls = malloc(sizeof(Wall) * m->numwalls);
+
+    m->walls[0] = (Wall){ .seg = { {0, 0}, {100, 0} } };
+    m->walls[1] = (Wall){ .seg = { {100, 0}, {100, 100} } };
+    m->walls[2] = (Wall){ .seg = { {100, 100}, {0, 100} } };
+    m->walls[3] = (Wall){ .seg = { {0, 100}, {0, 0} } };
+    m->walls[4] = (Wall){ .seg = { {50, 0}, {50, 70} } };
+
+    return m;
+}
+
+
+int test_walkable() {
+    Map *m = CreateRoom();
+    NavGrid *nav = N_Build(m, 4, 2, NULL);
+
+    mu_assert(N_IsWalkable(nav, (Vector){25, 25}), "Open space is walkable");
+    mu_assert(!N_IsWalkable(nav, (Vector){50, 25}), "Walls are not walkable");
+    mu_assert(!N_IsWalkable(nav, (Vector){52, 25}), "Walls are inflated");
+    mu_assert(N_IsWalkable(nav, (Vector){50, 85}), "The gap is walkable");
+
+    N_Delete(nav);
+    M_Delete(m);
+    return 0;
+}
+
+
+int test_find_path() {
+    Map *m = CreateRoom();
+    NavGrid *nav = N_Build(m, 4, 2, NULL);
+
+    Vector a = {25, 25};
+    Vector b = {75, 25};
+    Vector points[64];
+
+    int n = N_FindPath(nav, a, b, points, 64);
+    mu_assert(n > 1, "Goes around the wall");
+    mu_assert(VEQ(points[n - 1], b), "Ends at the goal");
+
+    int below = 0;
+    for (int i = 0; i < n; i++) {
+        if (points[i].y > 70) below = 1;
+    }
+    mu_assert(below, "Goes through the gap");
+
+    Vector cached[64];
+    mu_assert(N_FindPath(nav, a, b, cached, 64) == n, "Cached path is the same");
+
+    n = N_FindPath(nav, a, (Vector){25, 60}, points, 64);
+    mu_assert(n == 1, "Straight paths have a single waypoint");
+
+    N_Delete(nav);
+    M_Delete(m);
+    return 0;
+}
+
+
+int test_update_region() {
+    Map *m = CreateRoom();
+    NavGrid *nav = N_Build(m, 4, 2, NULL);
+
+    // Close the gap.
+    m->walls[4].seg.end.y = 100;
+    N_UpdateRegion(nav, m, (Box){ 0, 100, 40, 60 });
+
+    Vector points[64];
+    mu_assert(N_FindPath(nav, (Vector){25, 25}, (Vector){75, 25}, points, 64) == 0,
+            "No path once the gap is closed");
+
+    // And open it again.
+    m->walls[4].seg.end.y = 70;
+    N_UpdateRegion(nav, m, (Box){ 0, 100, 40, 60 });
+    mu_assert(N_FindPath(nav, (Vector){25, 25}, (Vector){75, 25}, points, 64) > 1,
+            "Path once the gap is open again");
+
+    N_Delete(nav);
+    M_Delete(m);
+    return 0;
+}
+
+
+int test_copy() {
+    Map *m = CreateRoom();
+    NavGrid *nav = N_Build(m, 4, 2, NULL);
+
+    Vector points[64];
+    N_FindPath(nav, (Vector){25, 25}, (Vector){75, 25}, points, 64);
+
+    // Update the copy the way a reload does, leaving the grid in use alone.
+    NavGrid *copy = N_Copy(nav, NULL);
+    m->walls[4].seg.end.y = 100;
+    N_UpdateRegion(copy, m, (Box){ 0, 100, 40, 60 });
+
+    mu_assert(N_FindPath(nav, (Vector){25, 25}, (Vector){75, 25}, points, 64) > 0,
+            "The original still has the gap");
+    mu_assert(N_FindPath(copy, (Vector){25, 25}, (Vector){75, 25}, points, 64) == 0,
+            "The copy was updated, without the original's cached path");
+    mu_assert(copy->maphash == M_Hash(m) && nav->maphash != copy->maphash,
+            "Only the copy matches the new map");
+
+    N_Delete(copy);
+    N_Delete(nav);
+    M_Delete(m);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_walkable);
+    mu_run_test(test_find_path);
+    mu_run_test(test_update_region);
+    mu_run_test(test_copy);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
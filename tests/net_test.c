@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "minunit.h"
+
+#include "map.h"
+#include "net.h"
+#include "player.h"
+
+#define PORT (NETPORT + 1)
+
+
+static int SameMobile(Mobile a, Mobile b) {
+    return a.pos.x == b.pos.x && a.pos.y == b.pos.y &&
+        a.vel.x == b.vel.x && a.vel.y == b.vel.y &&
+        a.forward.x == b.forward.x && a.forward.y == b.forward.y &&
+        a.radius == b.radius;
+}
+
+
+int test_delta() {
+    static NetState a, b, c;
+    static uint8_t buf[NETMAXPACKET];
+
+    for (int i = 0; i < 3; i++) {
+        a.present[i] = 1;
+        a.mobs[i] = Nt_Quantize((Mobile){
+            .pos = {i * 10.1, i * 20.3},
+            .forward = {1, 0},
+            .radius = 8,
+        });
+    }
+
+    int full = Nt_WriteDelta(buf, sizeof(buf), NULL, &a);
+    mu_assert(full > 0, "Full snapshot written");
+    mu_assert(Nt_ReadDelta(buf, full, NULL, &c) == full, "Full snapshot read");
+    for (int i = 0; i < MAXPEERS; i++) {
+        mu_assert(c.present[i] == a.present[i], "Same players");
+        if (a.present[i]) mu_assert(SameMobile(c.mobs[i], a.mobs[i]), "Same state");
+    }
+
+    b = a;
+    b.mobs[1].pos.x += 1;
+    b.present[2] = 0;
+
+    int delta = Nt_WriteDelta(buf, sizeof(buf), &a, &b);
+    mu_assert(delta > 0 && delta < full / 2, "Only changes written");
+    mu_assert(Nt_ReadDelta(buf, delta, &a, &c) == delta, "Delta read");
+    mu_assert(SameMobile(c.mobs[1], b.mobs[1]), "Changes applied");
+    mu_assert(SameMobile(c.mobs[0], a.mobs[0]), "The rest kept");
+    mu_assert(!c.present[2], "Players leave");
+
+    mu_assert(Nt_ReadDelta(buf, delta - 1, &a, &c) < 0, "Truncation caught");
+    mu_assert(Nt_WriteDelta(buf, 4, NULL, &a) < 0, "Overflow caught");
+
+    return 0;
+}
+
+
+int test_prediction() {
+    Map map = {
+        .numwalls = 1,
+        .walls = malloc(sizeof(Wall))
+    };
+    map.walls[0] = (Wall){ .seg = { .start = {60, -100}, .end = {60, 100} } };
+
+    Movement m = { .speed = 6, .accel = 1.5, .friction = 0.2, .turnspeed = 0.1 };
+    Mobile spawn = { .forward = {1, 0}, .radius = 8 };
+
+    NetServer *s = Nt_Listen(PORT, &map, &m, spawn);
+    mu_assert(s, "Server started");
+    NetClient *c = Nt_Connect("127.0.0.1", PORT);
+    mu_assert(c, "Client started");
+
+    Mobile predicted = spawn;
+    for (int i = 0; i < 60; i++) {
+        Nt_SendInput(c, (Tick){ .forward = 1, .turn = i % 20 == 0 });
+        Nt_Predict(c, &map, &m, &predicted);
+
+        // The server lags a few steps behind.
+        if (i % 3 == 0) {
+            usleep(1000);
+            Nt_Receive(s);
+            Nt_SendSnapshots(s);
+            usleep(1000);
+        }
+
+        Nt_ReceiveSnapshots(c);
+        Nt_Predict(c, &map, &m, &predicted);
+    }
+
+    mu_assert(s->numpeers == 1, "Client joined");
+    mu_assert(c->id == 0 && c->latest, "Snapshots received");
+    mu_assert(c->applied < c->seq, "Inputs predicted");
+    mu_assert(c->lastpredicted == c->seq, "Every input predicted");
+    mu_assert(c->mispredictions == 0, "Predictions right");
+
+    usleep(1000);
+    Nt_Receive(s);
+    mu_assert(SameMobile(predicted, s->mobs[0]), "Server agrees");
+    mu_assert(predicted.pos.x < 60 - 8, "Walls stop players");
+
+    Nt_Disconnect(c);
+    usleep(1000);
+    Nt_Receive(s);
+    mu_assert(s->numpeers == 0, "Client left");
+
+    Nt_CloseServer(s);
+    free(map.walls);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_delta);
+    mu_run_test(test_prediction);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
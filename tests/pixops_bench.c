@@ -0,0 +1,66 @@
+// Compares the SIMD versions of the pixel operations against the scalar ones.
+//
+// Checks that every version gives the same result, and times each one over
+// a whole 640x400 frame.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "color.h"
+#include "pixops.h"
+
+#define PIXELS (640 * 400)
+
+static const char *levels[] = { "scalar", "sse2", "avx2" };
+
+static uint32_t src[PIXELS], dst[PIXELS];
+static uint32_t expected[PIXELS];
+
+
+static void Fill() { PX_Fill(dst, 0x123456, PIXELS); }
+static void Copy() { PX_Copy(dst, src, PIXELS); }
+static void CopyKey() { PX_CopyKey(dst, src, PIXELS, TRANSPARENT); }
+static void Scale() { PX_Scale(dst, src, PIXELS, 0.6); }
+static void ConvertARGB() { PX_ConvertARGB(dst, src, PIXELS); }
+
+
+// Runs op at every level, checking the result against the scalar one. Stops
+// everything if they differ.
+static void Bench(const char *name, void (*op)()) {
+    char fullname[64];
+
+    for (PXLevel l = PX_SCALAR; l <= PX_BestLevel(); l++) {
+        PX_UseLevel(l);
+
+        memset(dst, 0, sizeof(dst));
+        op();
+
+        if (l == PX_SCALAR) {
+            memcpy(expected, dst, sizeof(dst));
+        } else if (memcmp(expected, dst, sizeof(dst))) {
+            printf("%s/%s differs from scalar!\n", name, levels[l]);
+            exit(1);
+        }
+
+        snprintf(fullname, sizeof(fullname), "%s/%s", name, levels[l]);
+        bench_run(fullname, op());
+    }
+}
+
+
+void all_benches() {
+    for (int i = 0; i < PIXELS; i++) {
+        src[i] = bench_random(0, 8) >= 1 ? (uint32_t)bench_random(0, 4294967296.0)
+            : TRANSPARENT;
+    }
+
+    Bench("PX_Fill", Fill);
+    Bench("PX_Copy", Copy);
+    Bench("PX_CopyKey", CopyKey);
+    Bench("PX_Scale", Scale);
+    Bench("PX_ConvertARGB", ConvertARGB);
+}
+
+BENCH_MAIN(all_benches);
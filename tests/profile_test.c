@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "minunit.h"
+
+#include "profile.h"
+
+#define PATH "/tmp/profile_test.folded"
+#define SPINMS 300
+
+volatile double sink;
+
+
+// Not static, for the profile to name it, and never inlined, for it to be in
+// the stacks at all.
+__attribute__((noinline)) void Spin(double ms) {
+    clock_t end = clock() + ms * CLOCKS_PER_SEC / 1000;
+    while (clock() < end) {
+        for (int i = 0; i < 1000; i++) sink += i * 0.5;
+    }
+}
+
+
+int test_profile() {
+    mu_assert(Pf_Start(PFHZ), "Starts");
+    Spin(SPINMS);
+    Pf_Stop();
+
+    long n = Pf_Samples();
+    // At least at 100 Hz, the slowest kernel tick rate.
+    mu_assert(n > 100 * SPINMS / 1000 / 2, "Samples while running");
+
+    Spin(SPINMS / 10);
+    mu_assert(Pf_Samples() == n, "Stops");
+
+    mu_assert(Pf_Write(PATH), "Writes");
+
+    FILE *f = fopen(PATH, "r");
+    mu_assert(f, "Creates the file");
+
+    char line[4096];
+    long total = 0, spinning = 0;
+    int wellformed = 1;
+    while (fgets(line, sizeof(line), f)) {
+        char *space = strrchr(line, ' ');
+        if (!space || atol(space + 1) <= 0) wellformed = 0;
+        if (!space) continue;
+
+        long count = atol(space + 1);
+        total += count;
+        if (strstr(line, ";main;all_tests;test_profile;Spin")) spinning += count;
+    }
+    fclose(f);
+    remove(PATH);
+
+    mu_assert(wellformed, "Writes stacks and counts");
+    mu_assert(total == n, "Writes every sample");
+    mu_assert(spinning > n * 9 / 10, "Names the functions, outermost first");
+
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_profile);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
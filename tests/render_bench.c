@@ -0,0 +1,71 @@
+// Times drawing the first person view with textures whose sizes are powers
+// of two, which take the specialised path, and with textures whose sizes
+// aren't.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+#include "buffer.h"
+#include "defs.h"
+#include "geometry.h"
+#include "map.h"
+#include "render.h"
+
+#define WIDTH 640
+#define HEIGHT 400
+
+
+static Buffer *Checkers(int size) {
+    Buffer *b = B_CreateBuffer(size, size, NULL);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            B_SetPixel(b, x, y, ((x / 8) ^ (y / 8)) & 1 ? 0x808080 : 0x404040);
+        }
+    }
+    return b;
+}
+
+
+// A square room, 400 units a side.
+static Map *Room() {
+    static Wall walls[] = {
+        { .seg = { {0, 0}, {400, 0} } },
+        { .seg = { {400, 0}, {400, 400} } },
+        { .seg = { {400, 400}, {0, 400} } },
+        { .seg = { {0, 400}, {0, 0} } },
+    };
+    static Map m = { walls, 4, NULL };
+    return &m;
+}
+
+
+static void Bench(const char *name, int texsize) {
+    Renderer r;
+    R_Init(&r, DEG2RAD(75), 1, 300, 64);
+    r.walltex = r.flortex = r.ceiltex = Checkers(texsize);
+
+    Buffer *b = B_CreateBuffer(WIDTH, HEIGHT, NULL);
+    Vector pos = { 200, 200 };
+    Vector forward = G_Normalize((Vector){ 1, 1 });
+
+    char label[64];
+    snprintf(label, sizeof(label), "R_DrawView/%s/%dx%d", name, texsize, texsize);
+    bench_run(label, {
+        forward = G_Rotate(forward, 0.01);
+        R_DrawView(&r, b, Room(), pos, forward);
+        bench_sink = b->pixels[i % (WIDTH * HEIGHT)];
+    });
+
+    B_DeleteBuffer(r.walltex);
+    B_DeleteBuffer(b);
+    R_Free(&r);
+}
+
+
+void all_benches() {
+    Bench("pow2", 64);
+    Bench("generic", 60);
+}
+
+BENCH_MAIN(all_benches);
@@ -0,0 +1,294 @@
+// Renders fixed views of fixture maps and compares them with the reference
+// images in tests/golden. A reference that's missing or can't be read fails
+// its view. With UPDATE_GOLDEN set in the environment, every view is written
+// as the new reference instead.
+//
+// When a view doesn't match, what was drawn and the difference are written
+// next to the reference, as <name>.out.ppm and <name>.diff.ppm.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "minunit.h"
+
+#include "buffer.h"
+#include "color.h"
+#include "defs.h"
+#include "geometry.h"
+#include "map.h"
+#include "render.h"
+
+#define GOLDEN "tests/golden"
+#define WIDTH 128
+#define HEIGHT 80
+#define TOLERANCE 8         // Per channel
+#define MAXBAD 0.005        // Fraction of the pixels allowed out of tolerance
+
+
+//------------------------------------------------------------------------------
+// Fixtures
+//------------------------------------------------------------------------------
+
+// Rows of bricks.
+static Buffer *Bricks(int size) {
+    Buffer *b = B_CreateBuffer(size, size, NULL);
+    for (int y = 0; y < size; y++) {
+        int offset = (y / 8) & 1 ? 8 : 0;
+        for (int x = 0; x < size; x++) {
+            int mortar = y % 8 == 0 || (x + offset) % 16 == 0;
+            B_SetPixel(b, x, y, mortar ? BUILDRGB(90, 90, 80) :
+                    BUILDRGB(140 + (x * 7 + y * 3) % 40, 50, 40));
+        }
+    }
+    return b;
+}
+
+
+static Buffer *Checkers(int size) {
+    Buffer *b = B_CreateBuffer(size, size, NULL);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            B_SetPixel(b, x, y, ((x / 8) ^ (y / 8)) & 1 ?
+                    BUILDRGB(128, 128, 128) : BUILDRGB(40, 60, 40));
+        }
+    }
+    return b;
+}
+
+
+static Buffer *Gradient(int size) {
+    Buffer *b = B_CreateBuffer(size, size, NULL);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            B_SetPixel(b, x, y, BUILDRGB(x * 255 / size, y * 255 / size, 160));
+        }
+    }
+    return b;
+}
+
+
+// A square room, 400 units a side, with a square pillar in the middle.
+static Map *Room() {
+    static Wall walls[] = {
+        { .seg = { {0, 0}, {400, 0} } },
+        { .seg = { {400, 0}, {400, 400} } },
+        { .seg = { {400, 400}, {0, 400} } },
+        { .seg = { {0, 400}, {0, 0} } },
+        { .seg = { {180, 180}, {220, 180} } },
+        { .seg = { {220, 180}, {220, 220} } },
+        { .seg = { {220, 220}, {180, 220} } },
+        { .seg = { {180, 220}, {180, 180} } },
+    };
+    static Map m = { walls, 8, NULL };
+    return &m;
+}
+
+
+// A long corridor that zigzags, with walls at odd angles.
+static Map *Corridor() {
+    static Wall walls[] = {
+        { .seg = { {0, 0}, {300, 40} } },
+        { .seg = { {300, 40}, {600, -20} } },
+        { .seg = { {600, -20}, {1200, 60} } },
+        { .seg = { {0, 100}, {300, 140} } },
+        { .seg = { {300, 140}, {600, 80} } },
+        { .seg = { {600, 80}, {1200, 160} } },
+        { .seg = { {0, 0}, {0, 100} } },
+    };
+    static Map m = { walls, 7, NULL };
+    return &m;
+}
+
+
+typedef struct View {
+    const char *name;
+    Map *(*map)();
+    Vector pos;
+    double angle;       // Of forward, in degrees
+    int texsize;        // Powers of two take another path
+    int interlaced;
+} View;
+
+static const View views[] = {
+    { "room_corner",   Room,     {40, 40},   45,  64, 0 },
+    { "room_pillar",   Room,     {100, 300}, -30, 64, 0 },
+    { "room_close",    Room,     {200, 160}, 90,  64, 0 },
+    { "room_generic",  Room,     {40, 40},   45,  60, 0 },
+    { "room_interlaced", Room,   {100, 300}, -30, 64, 1 },
+    { "corridor_far",  Corridor, {20, 50},   0,   64, 0 },
+};
+#define NUMVIEWS (sizeof(views) / sizeof(views[0]))
+
+
+static Buffer *Draw(const View *v) {
+    Renderer r;
+    R_Init(&r, DEG2RAD(75), 1, 300, 64);
+    r.walltex = Bricks(v->texsize);
+    r.flortex = Checkers(v->texsize);
+    r.ceiltex = Gradient(v->texsize);
+    r.interlaced = v->interlaced;
+
+    Buffer *b = B_CreateBuffer(WIDTH, HEIGHT, NULL);
+    Vector forward = G_Rotate((Vector){1, 0}, DEG2RAD(v->angle));
+    R_DrawView(&r, b, v->map(), v->pos, forward);
+
+    B_DeleteBuffer(r.walltex);
+    B_DeleteBuffer(r.flortex);
+    B_DeleteBuffer(r.ceiltex);
+    R_Free(&r);
+
+    return b;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Images
+//------------------------------------------------------------------------------
+
+static void WritePPM(Buffer *b, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return;
+
+    fprintf(f, "P6\n%d %d\n255\n", b->width, b->height);
+    for (int y = 0; y < b->height; y++) {
+        for (int x = 0; x < b->width; x++) {
+            uint32_t c = b->pixels[y * b->pitch + x];
+            fputc(GETR(c), f);
+            fputc(GETG(c), f);
+            fputc(GETB(c), f);
+        }
+    }
+
+    fclose(f);
+}
+
+
+// Returns NULL if path can't be read, or it ends before the last pixel.
+static Buffer *ReadPPM(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    int width, height, max;
+    if (fscanf(f, "P6 %d %d %d", &width, &height, &max) != 3 || max != 255 ||
+            width <= 0 || height <= 0 || width * height > WIDTH * HEIGHT * 16) {
+        fclose(f);
+        return NULL;
+    }
+    fgetc(f);
+
+    Buffer *b = B_CreateBuffer(width, height, NULL);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int r = fgetc(f), g = fgetc(f), bl = fgetc(f);
+            if (bl == EOF) {
+                B_DeleteBuffer(b);
+                fclose(f);
+                return NULL;
+            }
+            B_SetPixel(b, x, y, BUILDRGB(r, g, bl));
+        }
+    }
+
+    fclose(f);
+    return b;
+}
+
+
+// Returns how many pixels of a and b differ by more than TOLERANCE in any
+// channel, and draws how much they differ in diff.
+static int Compare(Buffer *a, Buffer *b, Buffer *diff) {
+    int bad = 0;
+
+    for (int y = 0; y < a->height; y++) {
+        for (int x = 0; x < a->width; x++) {
+            uint32_t ca = a->pixels[y * a->pitch + x];
+            uint32_t cb = b->pixels[y * b->pitch + x];
+
+            int d = MAX(abs((int)GETR(ca) - (int)GETR(cb)),
+                    MAX(abs((int)GETG(ca) - (int)GETG(cb)),
+                        abs((int)GETB(ca) - (int)GETB(cb))));
+
+            if (d > TOLERANCE) bad++;
+
+            // Dimmed reference, with the differences in red
+            uint32_t c = C_ScaleColor(ca, 0.25);
+            if (d > TOLERANCE) c = BUILDRGB(MIN(255, 64 + d), 0, 0);
+            B_SetPixel(diff, x, y, c);
+        }
+    }
+
+    return bad;
+}
+
+
+
+//------------------------------------------------------------------------------
+// Tests
+//------------------------------------------------------------------------------
+
+int test_golden() {
+    int update = getenv("UPDATE_GOLDEN") != NULL;
+    int failed = 0;
+
+    for (int i = 0; i < NUMVIEWS; i++) {
+        const View *v = &views[i];
+        char path[256];
+        snprintf(path, sizeof(path), GOLDEN "/%s.ppm", v->name);
+
+        Buffer *drawn = Draw(v);
+
+        if (update) {
+            printf("\tWriting reference %s\n", path);
+            WritePPM(drawn, path);
+            B_DeleteBuffer(drawn);
+            continue;
+        }
+
+        Buffer *golden = ReadPPM(path);
+        if (!golden) {
+            printf("\t%s: can't read reference %s, missing or truncated\n",
+                    v->name, path);
+            B_DeleteBuffer(drawn);
+            failed++;
+            continue;
+        }
+
+        if (golden->width != WIDTH || golden->height != HEIGHT) {
+            printf("\t%s: reference is %dx%d\n", v->name, golden->width,
+                    golden->height);
+            failed++;
+        } else {
+            Buffer *diff = B_CreateBuffer(WIDTH, HEIGHT, NULL);
+            int bad = Compare(golden, drawn, diff);
+
+            if (bad > MAXBAD * WIDTH * HEIGHT) {
+                printf("\t%s: %d pixels differ, see %s/%s.{out,diff}.ppm\n",
+                        v->name, bad, GOLDEN, v->name);
+
+                snprintf(path, sizeof(path), GOLDEN "/%s.out.ppm", v->name);
+                WritePPM(drawn, path);
+                snprintf(path, sizeof(path), GOLDEN "/%s.diff.ppm", v->name);
+                WritePPM(diff, path);
+                failed++;
+            }
+
+            B_DeleteBuffer(diff);
+        }
+
+        B_DeleteBuffer(golden);
+        B_DeleteBuffer(drawn);
+    }
+
+    mu_assert(!failed, "%d views don't match their reference", failed);
+
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_golden);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
@@ -0,0 +1,61 @@
+#include <stdio.h>
+
+#include "minunit.h"
+
+#include "replay.h"
+
+#define REPLAY "/tmp/replay_test.replay"
+
+
+int test_roundtrip() {
+    Mobile start = {
+        .pos = {25, 25},
+        .forward = {1, 0},
+        .radius = 8,
+    };
+
+    Movement movement = { .speed = 3, .accel = 0.5, .friction = 0.8,
+        .turnspeed = 0.1, .sensitivity = 0.002 };
+
+    Replay rp;
+    mu_assert(RP_StartRecording(&rp, REPLAY, 0x1234, start, movement, 60), "Recording");
+    for (int i = 0; i < 100; i++) {
+        RP_Record(&rp, (Tick){ .forward = i & 1, .turn = -1, .relative_mouse_x = i });
+    }
+    RP_Close(&rp);
+
+    mu_assert(RP_StartPlaying(&rp, REPLAY), "Playing");
+    mu_assert(rp.maphash == 0x1234, "Map hash kept");
+    mu_assert(rp.tickrate == 60, "Tick rate kept");
+    mu_assert(rp.start.pos.x == 25 && rp.start.radius == 8, "Start state kept");
+    mu_assert(rp.movement.speed == 3 && rp.movement.friction == 0.8 &&
+            rp.movement.sensitivity == 0.002, "Movement kept");
+
+    Tick t;
+    int ok = 1;
+    while (RP_Play(&rp, &t)) {
+        int i = rp.numticks - 1;
+        ok &= t.forward == (i & 1) && t.turn == -1 && t.strafe == 0 &&
+            t.relative_mouse_x == i;
+    }
+    mu_assert(ok, "Ticks kept");
+    mu_assert(rp.numticks == 100, "Every tick played");
+    RP_Close(&rp);
+
+    FILE *f = fopen(REPLAY, "w");
+    fputs("not a replay", f);
+    fclose(f);
+    mu_assert(!RP_StartPlaying(&rp, REPLAY), "Other files rejected");
+
+    remove(REPLAY);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_roundtrip);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
@@ -0,0 +1,89 @@
+#include <stdint.h>
+
+#include "minunit.h"
+
+#include "buffer.h"
+#include "color.h"
+#include "rle.h"
+
+#define SW 6    // Sprite size
+#define SH 4
+#define DW 10   // Destination size, a view in a buffer 2 pixels bigger all round
+#define DH 8
+
+// Where the sprite is blitted: inside, past every edge, and all the way out.
+static const int positions[][2] = {
+    {2, 2}, {-3, -2}, {7, 6}, {-5, 5}, {8, -3}, {-6, 0}, {DW, DH}, {-100, 3},
+};
+#define NUMPOSITIONS (sizeof(positions) / sizeof(positions[0]))
+
+
+// Opaque pixels numbered by their position, with a hole and a transparent
+// column to split the spans.
+static uint32_t SpritePixel(int x, int y) {
+    if (x == 2 || (x == 4 && y == 1)) return TRANSPARENT;
+    return 0x100000 | y << 8 | x;
+}
+
+
+// Returns the number of pixels of the frame around the view, or inside it,
+// that aren't what they should be after blitting at (x,y).
+static int Wrong(Buffer *all, int x, int y) {
+    int wrong = 0;
+
+    for (int j = 0; j < DH + 4; j++) {
+        for (int i = 0; i < DW + 4; i++) {
+            int sx = i - 2 - x, sy = j - 2 - y;
+            int inview = i >= 2 && i < DW + 2 && j >= 2 && j < DH + 2;
+            int insprite = sx >= 0 && sx < SW && sy >= 0 && sy < SH;
+
+            uint32_t expected = inview ? BLACK : WHITE;
+            if (inview && insprite && SpritePixel(sx, sy) != TRANSPARENT) {
+                expected = SpritePixel(sx, sy);
+            }
+
+            wrong += B_GetPixel(all, i, j) != expected;
+        }
+    }
+
+    return wrong;
+}
+
+
+int test_clipping() {
+    Buffer *pixels = B_CreateBuffer(SW, SH, NULL);
+    for (int y = 0; y < SH; y++) {
+        for (int x = 0; x < SW; x++) {
+            B_SetPixel(pixels, x, y, SpritePixel(x, y));
+        }
+    }
+    RLESprite *s = RL_Compile(pixels, NULL);
+
+    Buffer *all = B_CreateBuffer(DW + 4, DH + 4, NULL);
+    Buffer dest = B_View(all, 2, 2, DW, DH);
+
+    for (int i = 0; i < NUMPOSITIONS; i++) {
+        int x = positions[i][0], y = positions[i][1];
+
+        B_ClearBuffer(all, WHITE);
+        B_ClearBuffer(&dest, BLACK);
+        RL_Blit(&dest, s, x, y);
+
+        mu_assert(!Wrong(all, x, y), "Blits the visible part at (%d, %d), and only it",
+                x, y);
+    }
+
+    RL_Delete(s);
+    B_DeleteBuffer(pixels);
+    B_DeleteBuffer(all);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_clipping);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
@@ -0,0 +1,59 @@
+#include <stdlib.h>
+
+#include "minunit.h"
+
+#include "jobs.h"
+#include "map.h"
+#include "sim.h"
+
+
+int test_parallel() {
+    Map map = {
+        .numwalls = 1,
+        .walls = malloc(sizeof(Wall))
+    };
+    map.walls[0] = (Wall){ .seg = { .start = {60, -100}, .end = {60, 100} } };
+
+    Movement m = { .speed = 6, .accel = 1.5, .friction = 0.2, .turnspeed = 0.1 };
+    Mobile spawn = { .forward = {1, 0}, .radius = 8 };
+
+    JobPool pool;
+    J_Init(&pool, 4);
+
+    Sim serial, parallel;
+    Sm_Init(&serial, &map, &m, 500, spawn, NULL, NULL);
+    Sm_Init(&parallel, &map, &m, 500, spawn, &pool, NULL);
+    mu_assert(parallel.numchunks > 1, "Steps split");
+
+    for (int step = 0; step < 50; step++) {
+        for (int i = 0; i < 500; i++) {
+            Tick t = { .forward = 1, .turn = (i + step) % 3 - 1 };
+            serial.ticks[i] = parallel.ticks[i] = t;
+        }
+        Sm_Step(&serial);
+        Sm_Step(&parallel);
+    }
+
+    mu_assert(serial.steps == 50, "Steps counted");
+    mu_assert(Sm_Hash(&serial) == Sm_Hash(&parallel), "Same result in parallel");
+    mu_assert(serial.mobs[0].pos.x > 0, "Players moved");
+
+    int through = 0;
+    for (int i = 0; i < 500; i++) through |= serial.mobs[i].pos.x > 60;
+    mu_assert(!through, "Walls stop players");
+
+    Sm_Free(&serial);
+    Sm_Free(&parallel);
+    J_Quit(&pool);
+    free(map.walls);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_parallel);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
@@ -0,0 +1,101 @@
+#include "minunit.h"
+
+#include "defs.h"
+#include "geometry.h"
+#include "spatial.h"
+
+
+int test_query() {
+    SpatialIndex si;
+    SP_Init(&si, 10);
+
+    SP_Insert(&si, 0, SP_SegmentBox((Segment){ {0, 0}, {100, 0} }));
+    SP_Insert(&si, 1, SP_SegmentBox((Segment){ {50, 50}, {60, 60} }));
+
+    int ids[4];
+    mu_assert(SP_Query(&si, (Box){ -5, 5, 40, 45 }, ids, 4) == 1,
+            "Finds items spanning several cells once");
+    mu_assert(ids[0] == 0, "Finds the right item");
+
+    mu_assert(SP_Query(&si, (Box){ 20, 30, 20, 30 }, ids, 4) == 0,
+            "Doesn't find items far away");
+
+    mu_assert(SP_Query(&si, (Box){ -100, 100, -100, 100 }, ids, 1) == 2,
+            "Counts the items that don't fit");
+
+    SP_Free(&si);
+    return 0;
+}
+
+
+int test_remove() {
+    SpatialIndex si;
+    SP_Init(&si, 10);
+
+    // Enough items to make the table grow.
+    for (int i = 0; i < 1000; i++) {
+        SP_Insert(&si, i, (Box){ i, i + 1, i, i + 1 });
+    }
+
+    for (int i = 0; i < 1000; i += 2) {
+        SP_Remove(&si, i);
+    }
+
+    int ids[4];
+    mu_assert(SP_Query(&si, (Box){ 500, 500.5, 500, 500.5 }, ids, 4) == 1,
+            "Removed items aren't found");
+    mu_assert(ids[0] == 499, "Other items are still there");
+
+    SP_Insert(&si, 499, (Box){ -10, -5, -10, -5 });
+    mu_assert(SP_Query(&si, (Box){ 499, 500, 499, 500 }, ids, 4) == 0,
+            "Inserting again moves the item");
+    mu_assert(SP_Query(&si, (Box){ -8, -7, -8, -7 }, ids, 4) == 1,
+            "Inserting again moves the item");
+
+    SP_Free(&si);
+    return 0;
+}
+
+
+int test_segments() {
+    SpatialIndex si;
+    SP_Init(&si, 10);
+
+    // The second goes through the corner at (0,0), and so takes the cells
+    // on both sides of it too.
+    SP_InsertSegment(&si, 0, (Segment){ {2, 5}, {98, 45} });
+    SP_InsertSegment(&si, 1, (Segment){ {-15, -5}, {15, 5} });
+    mu_assert(si.numentries == 14 + 6, "Only uses the cells segments cross");
+
+    int ids[4];
+    mu_assert(SP_Query(&si, (Box){ 22, 28, 52, 58 }, ids, 4) == 1 && ids[0] == 0,
+            "Finds segments in the cells they cross");
+    mu_assert(SP_Query(&si, (Box){ 12, 18, 72, 78 }, ids, 4) == 0,
+            "Doesn't find them in the rest of their box");
+    mu_assert(SP_Query(&si, (Box){ -8, -2, 2, 8 }, ids, 4) == 1 &&
+            SP_Query(&si, (Box){ 2, 8, -8, -2 }, ids, 4) == 1,
+            "Finds them beside corners they go through");
+
+    SP_InsertSegment(&si, 0, (Segment){ {95, 5}, {5, 5} });
+    mu_assert(si.numentries == 10 + 6, "Moves segments");
+    mu_assert(SP_Query(&si, (Box){ 22, 28, 52, 58 }, ids, 4) == 0,
+            "Forgets where they were");
+
+    SP_Remove(&si, 0);
+    SP_Remove(&si, 1);
+    mu_assert(si.numentries == 0, "Removes every cell");
+
+    SP_Free(&si);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_query);
+    mu_run_test(test_segments);
+    mu_run_test(test_remove);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
@@ -0,0 +1,132 @@
+#include <stdint.h>
+
+#include "minunit.h"
+
+#include "arena.h"
+#include "buffer.h"
+#include "color.h"
+#include "draw.h"
+#include "sprites.h"
+#include "text.h"
+
+#define GLYPHHEIGHT 4
+
+
+// A font of 16x16 glyphs, every one a block of its own color, with a
+// transparent column on the right.
+static SpriteSheet Font() {
+    Buffer *atlas = B_CreateBuffer(16 * GLYPHWIDTH, 16 * GLYPHHEIGHT, NULL);
+
+    for (int y = 0; y < atlas->height; y++) {
+        for (int x = 0; x < atlas->width; x++) {
+            int c = (y / GLYPHHEIGHT) * 16 + x / GLYPHWIDTH;
+            int blank = x % GLYPHWIDTH == GLYPHWIDTH - 1;
+            B_SetPixel(atlas, x, y, blank ? TRANSPARENT : 0x010000 | c);
+        }
+    }
+
+    return SS_FromAtlas(atlas, 16, 16, NULL);
+}
+
+
+// Returns 1 if text is drawn at (x,y) of b.
+static int Shows(Buffer *b, int x, int y, const char *text) {
+    for (int i = 0; text[i]; i++) {
+        uint32_t c = B_GetPixel(b, x + i * GLYPHWIDTH, y + GLYPHHEIGHT - 1);
+        if (c != (0x010000 | (unsigned char)text[i])) return 0;
+    }
+    return 1;
+}
+
+
+int test_cache() {
+    SpriteSheet font = Font();
+    Arena scratch;
+    A_Init(&scratch, 1024);
+
+    TextCache tc;
+    T_Init(&tc, font, &scratch);
+
+    Buffer *b = B_CreateBuffer(200, 40, NULL);
+    B_ClearBuffer(b, BLACK);
+
+    T_NewFrame(&tc);
+    T_Draw(&tc, b, 10, 5, "fps %d", 60);
+    mu_assert(Shows(b, 10, 5, "fps 60"), "Draws the formatted text");
+    mu_assert(B_GetPixel(b, 10 + GLYPHWIDTH - 1, 5) == BLACK, "Leaves transparent pixels");
+    mu_assert(scratch.used > 0, "Formats in the scratch arena");
+
+    size_t rendered = tc.arena.used;
+    A_Reset(&scratch);
+    B_ClearBuffer(b, BLACK);
+
+    T_NewFrame(&tc);
+    T_Draw(&tc, b, 10, 5, "fps %d", 60);
+    mu_assert(Shows(b, 10, 5, "fps 60"), "Draws cached text");
+    mu_assert(tc.arena.used == rendered, "Renders the same line only once");
+
+    T_Draw(&tc, b, 10, 5, "fps %d", 59);
+    mu_assert(Shows(b, 10, 5, "fps 59"), "Draws new text at the same position");
+    mu_assert(tc.arena.used > rendered, "Renders text that changed");
+
+    T_Draw(&tc, b, 10, 20, "fps %d", 60);
+    mu_assert(Shows(b, 10, 20, "fps 60"), "Caches lines by position");
+
+    // Same hash, different text: the cache has to tell them apart by the text.
+    TextLine *l = NULL;
+    for (int i = 0; i < TEXTCACHE; i++) {
+        if (tc.lines[i].sprite && tc.lines[i].x == 10 && tc.lines[i].y == 5) {
+            l = &tc.lines[i];
+        }
+    }
+    mu_assert(l, "Keeps the line");
+    l->text[4] = '8';
+    T_Draw(&tc, b, 10, 5, "fps %d", 59);
+    mu_assert(l->len == 6 && l->text[4] == '5', "Compares the text, not only its hash");
+
+    T_Free(&tc);
+    A_Free(&scratch);
+    B_DeleteBuffer(b);
+    SS_DeleteSpriteSheet(font);
+    return 0;
+}
+
+
+int test_dirty() {
+    SpriteSheet font = Font();
+    Arena scratch;
+    A_Init(&scratch, 1024);
+
+    TextCache tc;
+    T_Init(&tc, font, &scratch);
+
+    Buffer *b = B_CreateBuffer(200, 40, NULL);
+    B_TrackDirty(b);
+    B_ClearDirty(b);
+
+    T_NewFrame(&tc);
+    T_Draw(&tc, b, 10, 5, "abc");
+    T_NewFrame(&tc);
+    T_Draw(&tc, b, 10, 5, "abc");
+
+    mu_assert(b->dirty->count == 1, "Marks what it draws");
+    Box r = b->dirty->rects[0];
+    mu_assert(r.left == 10 && r.right == 10 + 3 * GLYPHWIDTH - 1 &&
+            r.top == 5 && r.bottom == 5 + GLYPHHEIGHT - 1, "Marks the line drawn");
+
+    T_Free(&tc);
+    A_Free(&scratch);
+    B_DeleteBuffer(b);
+    SS_DeleteSpriteSheet(font);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_cache);
+    mu_run_test(test_dirty);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "minunit.h"
+
+#include "defs.h"
+#include "geometry.h"
+#include "map.h"
+#include "world.h"
+
+#define WORLD "/tmp/world_test.world"
+#define ROOMS 8     // Rooms per side
+#define ROOMSIZE 100
+
+
+// A grid of ROOMS x ROOMS square rooms. Every room owns its top and left
+// walls, so no wall is repeated.
+Map *CreateRooms() {
+    Map *m = malloc(sizeof(Map));
+    m->arena = NULL;
+    m->numwalls = 0;
+    m->walls = malloc(sizeof(Wall) * 2 * ROOMS * ROOMS);
+
+    for (int y = 0; y < ROOMS; y++) {
+        for (int x = 0; x < ROOMS; x++) {
+            Vector corner = { x * ROOMSIZE, y * ROOMSIZE };
+            m->walls[m->numwalls++] = (Wall){
+                .seg = { corner, { corner.x + ROOMSIZE, corner.y } } };
+            m->walls[m->numwalls++] = (Wall){
+                .seg = { corner, { corner.x, corner.y + ROOMSIZE } } };
+        }
+    }
+
+    return m;
+}
+
+
+int test_stream() {
+    Map *m = CreateRooms();
+    mu_assert(W_Build(m, 2 * ROOMSIZE, WORLD), "World written");
+
+    // Every tile holds 2x2 rooms, with walls on the borders in both tiles.
+    World *w = W_Open(WORLD, 0, (Vector){ 50, 50 });
+    mu_assert(w, "World opened");
+
+    Map *resident = W_GetMap(w);
+    mu_assert(resident->numwalls > 0, "Center tile loaded");
+    mu_assert(resident->numwalls < m->numwalls, "Far tiles not loaded");
+
+    W_SetCenter(w, (Vector){ 750, 750 });
+    W_Wait(w);
+    resident = W_GetMap(w);
+
+    int near = 0;
+    for (int i = 0; i < resident->numwalls; i++) {
+        Segment s = resident->walls[i].seg;
+        if (MAX(s.start.x, s.end.x) >= 600 && MAX(s.start.y, s.end.y) >= 600) {
+            near++;
+        }
+    }
+    mu_assert(near == resident->numwalls, "Moving loads and evicts tiles");
+
+    W_Close(w);
+
+    w = W_Open(WORLD, ROOMS, (Vector){ 50, 50 });
+    mu_assert(W_GetMap(w)->numwalls == m->numwalls,
+            "Walls in several tiles appear once");
+
+    W_Close(w);
+    M_Delete(m);
+    remove(WORLD);
+    return 0;
+}
+
+
+int all_tests() {
+    mu_run_test(test_stream);
+
+    return 0;
+}
+
+RUN_TESTS(all_tests);